@@ -71,6 +71,10 @@ public:
         storeWithNonUniformLayout(videoPath, savedName, metadataIdentifier, labelToTileAround, force);
     }
 
+    void pythonStoreWithWorkloadLayout(const std::string &videoPath, const std::string &savedName, const std::string &metadataIdentifier, boost::python::list labels, boost::python::list queryCounts) {
+        storeWithWorkloadLayout(videoPath, savedName, metadataIdentifier, extract<std::string>(labels), extract<unsigned int>(queryCounts));
+    }
+
     SelectionResults pythonSelect(const std::string &video,
                                        const std::string &label,
                                        unsigned int firstFrameInclusive,
@@ -153,6 +157,40 @@ public:
         return activateRegretBasedTilingForVideo(video, metadataIdentifier, threshold);
     }
 
+    void pythonStartBackgroundRetiling() {
+        startBackgroundRetiling();
+    }
+
+    void pythonStartBackgroundRetiling(double encodeTimeFraction) {
+        startBackgroundRetiling(encodeTimeFraction);
+    }
+
+    void pythonStartBackgroundRetiling(double encodeTimeFraction, unsigned int maxConcurrentRetiles) {
+        startBackgroundRetiling(encodeTimeFraction, maxConcurrentRetiles);
+    }
+
+    void pythonCalibrateCostModel(boost::python::list videoPaths) {
+        calibrateCostModel(extract<std::string>(videoPaths));
+    }
+
+    // Returns (directories retired, directories deleted, bytes reclaimed, directories pending deletion).
+    boost::python::tuple pythonCollectGarbage(const std::string &video) {
+        auto result = collectGarbage(video);
+        return boost::python::make_tuple(result.numberOfDirectoriesRetired, result.numberOfDirectoriesDeleted,
+                result.numberOfBytesReclaimed, result.numberOfDirectoriesPending);
+    }
+
+    // Returns a list of (tile version, GOP, tile, number of reads, number of bytes) tuples.
+    boost::python::list pythonTileAccessStatistics(const std::string &video) {
+        boost::python::list accesses;
+        for (const auto &accessAndCounts : tileAccessStatistics(video)) {
+            auto &access = accessAndCounts.first;
+            accesses.append(boost::python::make_tuple(access.tileVersion, access.gop, access.tile,
+                    accessAndCounts.second.numberOfReads, accessAndCounts.second.numberOfBytes));
+        }
+        return accesses;
+    }
+
 };
 
 PythonTASM *tasmFromWH(const std::string &whDBPath) {
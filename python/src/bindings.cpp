@@ -25,6 +25,9 @@ void (tasm::python::PythonTASM::*storeDoNotForceNonUniformLayout)(const std::str
 void (tasm::python::PythonTASM::*activateRegretBasedTilingWithoutMetadataIdentifier)(const std::string&) = &tasm::python::PythonTASM::pythonActivateRegretBasedTilingForVideo;
 void (tasm::python::PythonTASM::*activateRegretBasedTilingWithMetadataIdentifier)(const std::string&, const std::string&) = &tasm::python::PythonTASM::pythonActivateRegretBasedTilingForVideo;
 void (tasm::python::PythonTASM::*activateRegretBasedTilingWithThreshold)(const std::string&, const std::string&, double) = &tasm::python::PythonTASM::pythonActivateRegretBasedTilingForVideo;
+void (tasm::python::PythonTASM::*startBackgroundRetilingWithDefaultBudget)() = &tasm::python::PythonTASM::pythonStartBackgroundRetiling;
+void (tasm::python::PythonTASM::*startBackgroundRetilingWithEncodeTimeFraction)(double) = &tasm::python::PythonTASM::pythonStartBackgroundRetiling;
+void (tasm::python::PythonTASM::*startBackgroundRetilingWithBudget)(double, unsigned int) = &tasm::python::PythonTASM::pythonStartBackgroundRetiling;
 
 BOOST_PYTHON_MODULE(_tasm) {
     using namespace boost::python;
@@ -69,6 +72,7 @@ BOOST_PYTHON_MODULE(_tasm) {
         .def("store_with_uniform_layout", &tasm::python::PythonTASM::storeWithUniformLayout)
         .def("store_with_nonuniform_layout", storeForceNonUniformLayout)
         .def("store_with_nonuniform_layout", storeDoNotForceNonUniformLayout)
+        .def("store_with_workload_layout", &tasm::python::PythonTASM::pythonStoreWithWorkloadLayout)
         .def("select", selectRange)
         .def("select", selectEqual)
         .def("select", selectAll)
@@ -83,7 +87,21 @@ BOOST_PYTHON_MODULE(_tasm) {
         .def("activate_regret_based_tiling", activateRegretBasedTilingWithoutMetadataIdentifier)
         .def("activate_regret_based_tiling", activateRegretBasedTilingWithThreshold)
         .def("deactivate_regret_based_tiling", &tasm::python::PythonTASM::deactivateRegretBasedTilingForVideo)
-        .def("retile_based_on_regret", &tasm::python::PythonTASM::retileVideoBasedOnRegret);
+        .def("retile_based_on_regret", &tasm::python::PythonTASM::retileVideoBasedOnRegret)
+        .def("compact_tiled_video", &tasm::python::PythonTASM::compactTiledVideo)
+        .def("collect_garbage", &tasm::python::PythonTASM::pythonCollectGarbage)
+        .def("pack_tiled_video", &tasm::python::PythonTASM::packTiledVideo)
+        .def("unpack_tiled_video", &tasm::python::PythonTASM::unpackTiledVideo)
+        .def("calibrate_cost_model", &tasm::python::PythonTASM::pythonCalibrateCostModel)
+        .def("set_layout_stability_tolerance", &tasm::python::PythonTASM::setLayoutStabilityTolerance)
+        .def("disable_layout_stability", &tasm::python::PythonTASM::disableLayoutStability)
+        .def("set_gop_length", &tasm::python::PythonTASM::setGOPLength)
+        .def("recommend_gop_length", &tasm::python::PythonTASM::recommendGOPLength)
+        .def("start_background_retiling", startBackgroundRetilingWithDefaultBudget)
+        .def("start_background_retiling", startBackgroundRetilingWithEncodeTimeFraction)
+        .def("start_background_retiling", startBackgroundRetilingWithBudget)
+        .def("stop_background_retiling", &tasm::python::PythonTASM::stopBackgroundRetiling)
+        .def("tile_access_statistics", &tasm::python::PythonTASM::pythonTileAccessStatistics);
 
     class_<tasm::python::Query>("Query", init<std::string, std::string, unsigned int, unsigned int>())
         .def(init<std::string, std::string>())
@@ -110,6 +128,8 @@ BOOST_PYTHON_MODULE(_tasm) {
     class_<tasm::CostElements>("CostElements", init<unsigned int, unsigned int>())
         .def_readonly("num_pixels", &tasm::CostElements::numPixels)
         .def_readonly("num_tiles", &tasm::CostElements::numTiles)
+        .def_readonly("num_bytes", &tasm::CostElements::numBytes)
+        .def_readonly("num_files", &tasm::CostElements::numFiles)
         .def(self_ns::str(self_ns::self))
         .def(self_ns::repr(self_ns::self));
 
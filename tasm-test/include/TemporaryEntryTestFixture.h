@@ -0,0 +1,44 @@
+#ifndef TASM_TEMPORARYENTRYTESTFIXTURE_H
+#define TASM_TEMPORARYENTRYTESTFIXTURE_H
+
+#include "Files.h"
+#include <gtest/gtest.h>
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <vector>
+
+// Gives tests their own directories under the temporary directory, which are removed when the test finishes.
+class TemporaryEntryTestFixture : public testing::Test {
+public:
+    TemporaryEntryTestFixture() {}
+
+protected:
+    void TearDown() override {
+        for (const auto &path : paths_)
+            std::experimental::filesystem::remove_all(path);
+    }
+
+    // An empty directory, replacing anything left at its path by an earlier run.
+    std::experimental::filesystem::path temporaryDirectory(const std::string &name) {
+        auto path = std::experimental::filesystem::temp_directory_path() / name;
+        std::experimental::filesystem::remove_all(path);
+        std::experimental::filesystem::create_directories(path);
+        paths_.push_back(path);
+        return path;
+    }
+
+    // An entry with an empty tile manifest, whose next tile version is nextTileVersion.
+    std::experimental::filesystem::path temporaryEntry(const std::string &name, unsigned int nextTileVersion = 0) {
+        auto path = temporaryDirectory(name);
+        std::ofstream(tasm::TileFiles::tileManifestFilename(path));
+        if (nextTileVersion)
+            std::ofstream(tasm::TileFiles::tileVersionFilename(path)) << nextTileVersion;
+        return path;
+    }
+
+private:
+    std::vector<std::experimental::filesystem::path> paths_;
+};
+
+#endif //TASM_TEMPORARYENTRYTESTFIXTURE_H
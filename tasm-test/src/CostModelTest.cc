@@ -0,0 +1,114 @@
+#include "CostModel.h"
+#include <gtest/gtest.h>
+
+#include "CostFeedback.h"
+#include "TemporaryEntryTestFixture.h"
+#include "Video.h"
+#include <cassert>
+
+using namespace tasm;
+
+class CostModelTestFixture : public TemporaryEntryTestFixture {};
+
+TEST_F(CostModelTestFixture, testSaveAndLoadCostModel) {
+    CostModel model({2e-06, 0.25, 4e-06, 1.5, 0.7, 1e-09, 0.01});
+    auto path = temporaryDirectory("cost-model-test") / "cost-model.bin";
+    model.save(path);
+
+    CostModel loaded;
+    assert(loaded.load(path));
+    auto coefficients = loaded.coefficients();
+    assert(coefficients.pixelCostWeight == 2e-06);
+    assert(coefficients.tileCostWeight == 0.25);
+    assert(coefficients.encodePixelCoefficient == 4e-06);
+    assert(coefficients.encodePixelIntercept == 1.5);
+    assert(coefficients.pixelThreshold == 0.7);
+    assert(coefficients.byteCostWeight == 1e-09);
+    assert(coefficients.fileCostWeight == 0.01);
+    std::experimental::filesystem::remove(path);
+
+    assert(!loaded.load(path));
+    assert(loaded.pixelThreshold() == 0.7);
+}
+
+TEST_F(CostModelTestFixture, testCostIncludesBytesRead) {
+    CostModel model({1e-06, 0.1, 0, 0, 0.8, 1e-08, 0.5});
+    CostElements costs(1000000, 10, 2000000, 4);
+    assert(std::abs(model.estimateCostToDecode(costs) - 2.0) < 1e-9);
+    assert(std::abs(model.estimateCostToRead(costs) - 2.02) < 1e-9);
+    assert(std::abs(model.estimateCost(costs) - 4.02) < 1e-9);
+    assert(model.usesByteCosts());
+    assert(!CostModel().usesByteCosts());
+}
+
+TEST_F(CostModelTestFixture, testOnlineFitTracksMeasuredCosts) {
+    auto costModel = std::make_shared<CostModel>();
+    OnlineCostModelFitter fitter(costModel);
+
+    double pixelWeight = 4e-06;
+    double tileWeight = 0.05;
+    for (auto i = 0u; i < 200; ++i) {
+        unsigned long long numPixels = 1000000ull * (1 + i % 7);
+        unsigned long long numTiles = 10 + (i * 13) % 50;
+        fitter.addObservation({CostElements(numPixels, numTiles), 0, pixelWeight * numPixels + tileWeight * numTiles});
+    }
+
+    auto coefficients = costModel->coefficients();
+    assert(std::abs(coefficients.pixelCostWeight - pixelWeight) / pixelWeight < 0.01);
+    assert(std::abs(coefficients.tileCostWeight - tileWeight) / tileWeight < 0.01);
+}
+
+TEST_F(CostModelTestFixture, testCostFeedbackThrottlesSaves) {
+    auto directory = temporaryDirectory("cost-feedback-test");
+    auto costModelPath = directory / "cost-model.bin";
+
+    {
+        CostFeedback feedback(std::make_shared<CostModel>(), costModelPath, std::chrono::hours(1));
+        feedback.recordExecution(directory, {CostElements(1000000, 10, 1000000, 2), 0.1, 0.5});
+        feedback.recordExecution(directory, {CostElements(2000000, 20, 2000000, 4), 0.2, 1.0});
+        assert(!std::experimental::filesystem::exists(costModelPath));
+        assert(QueryStatisticsStore(directory).load().size() == 2);
+
+        feedback.flush();
+        assert(std::experimental::filesystem::exists(costModelPath));
+        std::experimental::filesystem::remove(costModelPath);
+        feedback.flush();
+        assert(!std::experimental::filesystem::exists(costModelPath));
+
+        feedback.recordExecution(directory, {CostElements(1000000, 10, 1000000, 2), 0.1, 0.5});
+    }
+    // Destroying the feedback saves what was fit since the last save.
+    assert(std::experimental::filesystem::exists(costModelPath));
+}
+
+TEST_F(CostModelTestFixture, testQueryStatisticsStoreIsBounded) {
+    auto directory = temporaryDirectory("query-statistics-test");
+
+    QueryStatisticsStore store(directory, 10);
+    for (auto i = 1u; i <= 100; ++i)
+        store.record({CostElements(i, 1, i, 1), 0.1, 0.2});
+
+    // The file is compacted to the most recent records, so it never holds much more than twice the cap.
+    auto records = store.load(1000);
+    assert(records.size() >= 10 && records.size() <= 25);
+    assert(records.back().costs.numPixels == 100);
+    assert(store.load(5).front().costs.numPixels == 96);
+}
+
+TEST_F(CostModelTestFixture, testRecommendGOPLength) {
+    auto coefficients = CostModel::DefaultCoefficients;
+    coefficients.byteCostWeight = 1e-5;
+    CostModel costModel(coefficients);
+
+    unsigned int numberOfFrames = 30 * 60 * 10;
+    auto bytesPerInterframe = 100000;
+    auto forPointQueries = costModel.recommendGOPLength(QueryMix{1000, 0, 0}, 1920, 1080, numberOfFrames, bytesPerInterframe);
+    auto forScans = costModel.recommendGOPLength(QueryMix{0, 1000, 3000}, 1920, 1080, numberOfFrames, bytesPerInterframe);
+    assert(forPointQueries >= 1);
+    assert(forPointQueries < forScans);
+    assert(forScans <= CostModel::MaxRecommendedGOPLength);
+
+    auto entryPath = temporaryDirectory("gop-length-test");
+    TiledEntry("gop-length-test", entryPath).setGOPLength(forPointQueries);
+    assert(TiledEntry("gop-length-test", entryPath).gopLength() == forPointQueries);
+}
@@ -0,0 +1,67 @@
+#include "LayoutCache.h"
+#include <gtest/gtest.h>
+
+#include "SemanticDataManager.h"
+#include "SemanticIndex.h"
+#include "SemanticSelection.h"
+#include "TemporaryEntryTestFixture.h"
+#include <cassert>
+
+using namespace tasm;
+
+class LayoutCacheTestFixture : public TemporaryEntryTestFixture {};
+
+TEST_F(LayoutCacheTestFixture, testLayoutCacheIsReusedAcrossProviders) {
+    std::string video("layout-cache");
+    unsigned int gopLength = 30;
+    auto cacheDirectory = temporaryDirectory("layout-cache-test");
+
+    auto semanticIndex = SemanticIndexFactory::create(SemanticIndex::IndexType::XY, cacheDirectory / "labels.db");
+    for (auto i = 0u; i < gopLength; ++i)
+        semanticIndex->addMetadata(video, "car", i, 512, 320, 1024, 640);
+    auto tiledLayout = CachedTileConfigurationProvider::fineGrainedLayoutProvider(gopLength,
+            std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>("car")),
+            1920, 1080, cacheDirectory)->tileLayoutForFrame(0);
+    assert(tiledLayout->numberOfTiles() > 1);
+
+    // A later cache for the same index gets the saved layout without looking at the metadata.
+    auto cacheForIndex = [&](const SemanticIndex &index) {
+        return std::make_unique<PersistentLayoutCache>(cacheDirectory, index.identity(), video, SingleMetadataSelection("car"), 1920, 1080, gopLength);
+    };
+    assert(*cacheForIndex(*semanticIndex)->layoutForGOP(0) == *tiledLayout);
+
+    // Layouts computed from a different index are never served, and in-memory indexes aren't cached at all.
+    auto emptyIndex = SemanticIndexFactory::createInMemory();
+    assert(!cacheForIndex(*emptyIndex)->layoutForGOP(0));
+    assert(CachedTileConfigurationProvider::fineGrainedLayoutProvider(gopLength,
+            std::make_shared<SemanticDataManager>(emptyIndex, video, std::make_shared<SingleMetadataSelection>("car")),
+            1920, 1080, cacheDirectory)->tileLayoutForFrame(0)->numberOfTiles() == 1);
+
+    PersistentLayoutCache::invalidate(video, cacheDirectory);
+    assert(!cacheForIndex(*semanticIndex)->layoutForGOP(0));
+
+    // A cache that was open across the invalidation doesn't write its layouts back.
+    {
+        auto openCache = cacheForIndex(*semanticIndex);
+        openCache->addLayoutForGOP(1, tiledLayout);
+        PersistentLayoutCache::invalidate(video, cacheDirectory);
+        openCache->addLayoutForGOP(2, tiledLayout);
+    }
+    assert(!cacheForIndex(*semanticIndex)->layoutForGOP(1));
+
+    // A file that can't be read is a miss, and is replaced by the next save.
+    std::experimental::filesystem::path cachePath;
+    {
+        auto cache = cacheForIndex(*semanticIndex);
+        cache->addLayoutForGOP(3, tiledLayout);
+        cache->save();
+        cachePath = cache->path();
+    }
+    std::ofstream(cachePath, std::ios::trunc) << "not a layout cache";
+    {
+        auto cache = cacheForIndex(*semanticIndex);
+        assert(!cache->layoutForGOP(3));
+        cache->addLayoutForGOP(3, tiledLayout);
+    }
+    assert(*cacheForIndex(*semanticIndex)->layoutForGOP(3) == *tiledLayout);
+}
@@ -0,0 +1,47 @@
+#include "MP4Reader.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+
+using namespace tasm;
+
+class MP4ReaderTestFixture : public testing::Test {
+public:
+    MP4ReaderTestFixture() {}
+};
+
+TEST_F(MP4ReaderTestFixture, testMP4ReaderReadsGOPsAsAnnexB) {
+    MP4Reader reader("/home/maureen/red102k.mp4");
+    assert(reader.keyframeNumbers().size() > 1);
+    auto lastSampleInGOP = MP4Reader::frameNumberToSampleNumber(reader.keyframeNumbers()[1] - 1);
+    auto gop = reader.dataForSamples(1, lastSampleInGOP);
+
+    // The GOP starts with the track's parameter sets, and every NAL unit is preceded by a start code.
+    assert(gop->size() > 5);
+    assert(!(*gop)[0] && !(*gop)[1] && !(*gop)[2] && (*gop)[3] == 1);
+    assert((((*gop)[4] >> 1) & 0x3f) == 32);
+
+    // Reading the samples one at a time gives the same bytes as reading the whole range at once.
+    std::vector<char> samples;
+    for (auto sample = 1u; sample <= lastSampleInGOP; ++sample) {
+        auto data = reader.dataForSamples(sample, sample);
+        samples.insert(samples.end(), data->begin(), data->end());
+    }
+    assert(samples == *gop);
+
+    // The samples are the same as those gpac extracts.
+    auto file = gf_isom_open("/home/maureen/red102k.mp4", GF_ISOM_OPEN_READ, nullptr);
+    assert(gf_isom_set_nalu_extract_mode(file, 1, GF_ISOM_NALU_EXTRACT_INBAND_PS_FLAG | GF_ISOM_NALU_EXTRACT_ANNEXB_FLAG) == GF_OK);
+    std::vector<char> extractedSamples;
+    for (auto sampleNumber = 1u; sampleNumber <= lastSampleInGOP; ++sampleNumber) {
+        GF_ISOSample *sample = gf_isom_get_sample(file, 1, sampleNumber, NULL);
+        extractedSamples.insert(extractedSamples.end(), sample->data, sample->data + sample->dataLength);
+        gf_isom_sample_del(&sample);
+    }
+    gf_isom_close(file);
+    assert(extractedSamples == *gop);
+
+    // Another reader of the same file shares the sample table and reads the same bytes.
+    MP4Reader otherReader("/home/maureen/red102k.mp4");
+    assert(*otherReader.dataForSamples(1, lastSampleInGOP) == *gop);
+}
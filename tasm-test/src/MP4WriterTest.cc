@@ -0,0 +1,37 @@
+#include "MP4Writer.h"
+#include <gtest/gtest.h>
+
+#include "MP4Reader.h"
+#include "TemporaryEntryTestFixture.h"
+#include "VideoConfiguration.h"
+#include <cassert>
+
+using namespace tasm;
+
+class MP4WriterTestFixture : public TemporaryEntryTestFixture {};
+
+TEST_F(MP4WriterTestFixture, testMP4WriterMuxesAnnexBStream) {
+    MP4Reader reader("/home/maureen/red102k.mp4");
+    auto data = reader.dataForSamples(1, reader.numberOfSamples());
+    auto configuration = video::GetConfiguration("/home/maureen/red102k.mp4");
+
+    // Write the stream in chunks that split NAL units and start codes.
+    auto output = temporaryDirectory("mp4-writer-test") / "stream.mp4";
+    {
+        MP4Writer writer(output, configuration->frameRate);
+        for (auto offset = 0u; offset < data->size(); offset += 1001)
+            writer.write(data->data() + offset, std::min<size_t>(1001, data->size() - offset));
+        writer.close();
+        assert(writer.numberOfSamples() == reader.numberOfSamples());
+    }
+
+    auto writtenConfiguration = video::GetConfiguration(output);
+    assert(writtenConfiguration->displayWidth == configuration->displayWidth);
+    assert(writtenConfiguration->displayHeight == configuration->displayHeight);
+    assert(writtenConfiguration->frameRate == configuration->frameRate);
+
+    MP4Reader writtenReader(output);
+    assert(writtenReader.numberOfSamples() == reader.numberOfSamples());
+    assert(writtenReader.keyframeNumbers() == reader.keyframeNumbers());
+    writtenReader.closeFile();
+}
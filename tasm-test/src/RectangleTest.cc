@@ -0,0 +1,31 @@
+#include "Rectangle.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cassert>
+
+using namespace tasm;
+
+class RectangleTestFixture : public testing::Test {
+public:
+    RectangleTestFixture() {}
+};
+
+TEST_F(RectangleTestFixture, testRectangleMergerMergesUntilNothingOverlaps) {
+    // The first two overlap. Their bounding rectangle then overlaps the third, which overlapped neither of them.
+    std::vector<Rectangle> rectangles{
+            {0, 0, 0, 100, 100},
+            {1, 80, 80, 100, 100},
+            {2, 150, 0, 50, 50},
+            {3, 500, 500, 10, 10}};
+    auto merged = RectangleMerger::mergeRectangles(rectangles);
+    assert(merged.size() == 2);
+    assert(merged[0] == Rectangle(0, 0, 0, 200, 180));
+    assert(merged[1] == rectangles[3]);
+
+    RectangleMerger incremental(std::vector<Rectangle>{});
+    for (const auto &rectangle : rectangles)
+        incremental.addRectangle(rectangle);
+    assert(incremental.rectangles().size() == 2);
+    assert(std::find(incremental.rectangles().begin(), incremental.rectangles().end(), merged[0]) != incremental.rectangles().end());
+}
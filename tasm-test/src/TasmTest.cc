@@ -72,6 +72,17 @@ TEST_F(TasmTestFixture, testTileBird) {
     std::experimental::filesystem::remove_all(tasm::files::PathForVideo("birdsincage-forced"));
 }
 
+TEST_F(TasmTestFixture, testWorkloadLayoutRejectsMismatchedQueryCounts) {
+    tasm::TASM tasm(SemanticIndex::IndexType::InMemory);
+    auto didThrow = false;
+    try {
+        tasm.storeWithWorkloadLayout("missing.mp4", "missing", "missing", {"car", "pedestrian"}, {1});
+    } catch (const std::invalid_argument&) {
+        didThrow = true;
+    }
+    assert(didThrow);
+}
+
 TEST_F(TasmTestFixture, testTileElFuente1) {
     tasm::TASM tasm(SemanticIndex::IndexType::InMemory);
     tasm.storeWithNonUniformLayout("/home/maureen/NFLX_dataset/ElFuente1_hevc.mp4", "elfuente1-not-forced", "elfuente1", "person", false);
@@ -0,0 +1,54 @@
+#include "TileAccessStatistics.h"
+#include <gtest/gtest.h>
+
+#include "TemporaryEntryTestFixture.h"
+#include <cassert>
+#include <thread>
+
+using namespace tasm;
+
+class TileAccessStatisticsTestFixture : public TemporaryEntryTestFixture {};
+
+TEST_F(TileAccessStatisticsTestFixture, testTileAccessStatistics) {
+    auto entryPath = temporaryDirectory("tile-access-test");
+
+    unsigned int gopLength = 30;
+    {
+        TileAccessStatistics statistics(entryPath, gopLength, std::chrono::seconds(3600));
+        statistics.recordRead(1, 2, 0, 100);
+        statistics.recordRead(1, 2, 15, 50);
+        statistics.recordRead(1, 3, gopLength, 10);
+
+        // Counts that have not been flushed are still reported, but not saved.
+        assert(statistics.accesses().size() == 2);
+        assert(TileAccessStatistics::load(entryPath).empty());
+        statistics.flush();
+    }
+
+    // Saved counts are added to by later statistics for the same entry.
+    {
+        TileAccessStatistics statistics(entryPath, gopLength);
+        statistics.recordRead(1, 2, gopLength - 1, 25);
+    }
+    auto accesses = TileAccessStatistics::load(entryPath);
+    assert(accesses.size() == 2);
+    auto &counts = accesses.at({1, 0, 2});
+    assert(counts.numberOfReads == 3);
+    assert(counts.numberOfBytes == 175);
+    assert(accesses.at({1, 1, 3}).numberOfReads == 1);
+
+    // Statistics that flush concurrently, as those of several processes can, don't lose each other's counts.
+    std::vector<std::thread> threads;
+    for (auto i = 0u; i < 4; ++i) {
+        threads.emplace_back([&]() {
+            TileAccessStatistics statistics(entryPath, gopLength, std::chrono::seconds(0));
+            for (auto j = 0u; j < 50; ++j) {
+                statistics.recordRead(1, 3, gopLength, 1);
+                statistics.flushIfDue();
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    assert(TileAccessStatistics::load(entryPath).at({1, 1, 3}).numberOfReads == 201);
+}
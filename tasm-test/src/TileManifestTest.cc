@@ -0,0 +1,64 @@
+#include "TileManifest.h"
+#include <gtest/gtest.h>
+
+#include "Files.h"
+#include "TemporaryEntryTestFixture.h"
+#include "Video.h"
+#include <cassert>
+#include <thread>
+
+using namespace tasm;
+
+class TileManifestTestFixture : public TemporaryEntryTestFixture {};
+
+TEST_F(TileManifestTestFixture, testTileManifestReplaysCommitsAndRemovals) {
+    auto entryPath = temporaryEntry("tile-manifest-test");
+
+    TileLayout untiled(1, 1, {1920}, {1080});
+    TileLayout tiled(2, 1, {960, 960}, {1080});
+    TileManifest manifest(entryPath);
+    manifest.recordCommit(0, 29, 0, untiled);
+    manifest.recordCommit(30, 59, 1, untiled);
+    manifest.recordCommit(0, 59, 2, tiled);
+    manifest.recordRemoval(0);
+
+    auto directories = manifest.load();
+    assert(directories);
+    assert(directories->size() == 2);
+    assert(directories->at(0).tileVersion == 1);
+    assert(directories->at(1).firstFrame == 0 && directories->at(1).lastFrame == 59);
+    assert(directories->at(1).layout == tiled);
+
+    // A record that was cut off by a crash makes the manifest untrustworthy.
+    std::ofstream(TileFiles::tileManifestFilename(entryPath), std::ios::app) << "commit 60 89";
+    assert(!manifest.load());
+}
+
+TEST_F(TileManifestTestFixture, testConcurrentCommitsArePublishedAtomically) {
+    auto entryPath = temporaryEntry("atomic-commit-test");
+
+    std::vector<std::thread> writers;
+    for (auto i = 0u; i < 4; ++i) {
+        writers.emplace_back([&] {
+            TiledEntry entry("atomic-commit-test", entryPath);
+            for (auto j = 0u; j < 25; ++j) {
+                auto version = entry.reserveTileVersion();
+                TileManifest(entryPath).recordCommit(version, version, version, TileLayout(1, 1, {1920}, {1080}));
+            }
+        });
+    }
+
+    // Readers only see whole records, so they never find the manifest unreadable while commits are being published.
+    TileManifest manifest(entryPath);
+    for (auto i = 0u; i < 100; ++i)
+        assert(manifest.load());
+    for (auto &writer : writers)
+        writer.join();
+
+    // Every transaction reserved its own version.
+    auto snapshot = manifest.snapshot();
+    assert(snapshot.directories.size() == 100);
+    assert(snapshot.directories.back().tileVersion == 99);
+    assert(snapshot.size == std::experimental::filesystem::file_size(manifest.path()));
+    assert(TiledEntry("atomic-commit-test", entryPath).tile_version() == 100);
+}
@@ -0,0 +1,42 @@
+#include "TilePack.h"
+#include <gtest/gtest.h>
+
+#include "MP4Reader.h"
+#include "TiledVideoManager.h"
+#include "VideoManager.h"
+#include <cassert>
+
+using namespace tasm;
+
+class TilePackTestFixture : public testing::Test {
+public:
+    TilePackTestFixture() {}
+};
+
+TEST_F(TilePackTestFixture, testPackedTilesReadLikeMP4s) {
+    VideoManager manager;
+    // The directory the video is first stored into is never packed, so store it twice.
+    manager.storeWithUniformLayout("/home/maureen/red102k.mp4", "red10-packed", 2, 2);
+    manager.storeWithUniformLayout("/home/maureen/red102k.mp4", "red10-packed", 2, 2);
+
+    TiledVideoManager tiledVideoManager(std::make_shared<TiledEntry>("red10-packed"));
+    auto tilePath = tiledVideoManager.locationForFrame(0).directory->tilePaths.at(1);
+    MP4Reader reader(tilePath);
+    auto data = reader.dataForSamples(1, reader.numberOfSamples());
+    auto keyframeNumbers = reader.keyframeNumbers();
+    reader.closeFile();
+
+    assert(manager.packTiledVideo("red10-packed") == 1);
+    assert(!std::experimental::filesystem::exists(tilePath));
+    assert(std::experimental::filesystem::exists(TileFiles::tilePackFilename(tilePath.parent_path())));
+
+    // Packed samples are the same bytes MP4Reader extracted from the tile's mp4.
+    MP4Reader packedReader(tilePath);
+    assert(packedReader.keyframeNumbers() == keyframeNumbers);
+    assert(*packedReader.dataForSamples(1, packedReader.numberOfSamples()) == *data);
+
+    assert(manager.unpackTiledVideo("red10-packed") == 1);
+    assert(std::experimental::filesystem::exists(tilePath));
+    assert(!std::experimental::filesystem::exists(TileFiles::tilePackFilename(tilePath.parent_path())));
+    assert(MP4Reader(tilePath).numberOfSamples() == packedReader.numberOfSamples());
+}
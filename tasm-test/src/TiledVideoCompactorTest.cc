@@ -0,0 +1,44 @@
+#include "TiledVideoCompactor.h"
+#include <gtest/gtest.h>
+
+#include "TemporaryEntryTestFixture.h"
+#include "TileManifest.h"
+#include "Transaction.h"
+#include "Video.h"
+#include <atomic>
+#include <cassert>
+#include <thread>
+
+using namespace tasm;
+
+class TiledVideoCompactorTestFixture : public TemporaryEntryTestFixture {};
+
+TEST_F(TiledVideoCompactorTestFixture, testCompactionSkipsOriginalDirectory) {
+    auto entryPath = temporaryEntry("compaction-test", 2);
+
+    // The original directory and the one after it have the same layout, but merging them would delete the original.
+    TileManifest manifest(entryPath);
+    for (auto version = 0u; version < 2; ++version) {
+        auto directory = TileFiles::directoryForTilesInFrames(entryPath, 30 * version, 30 * version + 29, version);
+        std::experimental::filesystem::create_directory(directory);
+        manifest.recordCommit(30 * version, 30 * version + 29, version, TileLayout(1, 1, {1920}, {1080}));
+    }
+    assert(!TiledVideoCompactor("compaction-test", entryPath).compact());
+    assert(manifest.load()->size() == 2);
+
+    // Compaction waits for transactions that are still writing.
+    std::atomic<bool> hasCompacted(false);
+    std::thread compaction;
+    {
+        TileCrackingTransaction transaction(std::make_shared<TiledEntry>("compaction-test", entryPath), TileLayout(1, 1, {1920}, {1080}), 30, 60);
+        compaction = std::thread([&] {
+            TiledVideoCompactor("compaction-test", entryPath).compact();
+            hasCompacted = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        assert(!hasCompacted);
+        transaction.abort();
+    }
+    compaction.join();
+    assert(hasCompacted);
+}
@@ -0,0 +1,94 @@
+#include "TiledVideoGarbageCollector.h"
+#include <gtest/gtest.h>
+
+#include "FileLock.h"
+#include "TemporaryEntryTestFixture.h"
+#include "TileAccessStatistics.h"
+#include "TileManifest.h"
+#include "TileReaderLease.h"
+#include <cassert>
+
+using namespace tasm;
+
+class TiledVideoGarbageCollectorTestFixture : public TemporaryEntryTestFixture {};
+
+TEST_F(TiledVideoGarbageCollectorTestFixture, testGarbageCollectionWaitsForReaders) {
+    auto entryPath = temporaryEntry("garbage-collection-test", 4);
+
+    TileManifest manifest(entryPath);
+    auto commit = [&](unsigned int firstFrame, unsigned int lastFrame, unsigned int version) {
+        auto directory = TileFiles::directoryForTilesInFrames(entryPath, firstFrame, lastFrame, version);
+        std::experimental::filesystem::create_directory(directory);
+        std::ofstream(TileFiles::tileMetadataFilename(directory)) << "metadata";
+        std::ofstream(TileFiles::tileFilename(directory, 0)) << std::string(100, 'x');
+        manifest.recordCommit(firstFrame, lastFrame, version, TileLayout(1, 1, {1920}, {1080}));
+    };
+    commit(0, 89, 0);
+    commit(0, 29, 1);
+    commit(30, 59, 2);
+    commit(0, 59, 3);
+    {
+        TileAccessStatistics statistics(entryPath, 30);
+        statistics.recordRead(1, 0, 0, 100);
+        statistics.recordRead(3, 0, 0, 100);
+    }
+
+    TiledVideoGarbageCollector garbageCollector("garbage-collection-test", entryPath);
+    {
+        TileReaderLease lease(entryPath);
+        auto result = garbageCollector.collect();
+        assert(result.numberOfDirectoriesRetired == 2);
+        assert(!result.numberOfDirectoriesDeleted);
+        assert(result.numberOfDirectoriesPending == 2);
+        assert(manifest.load()->size() == 2);
+        assert(std::experimental::filesystem::exists(TileFiles::directoryForTilesInFrames(entryPath, 0, 29, 1)));
+    }
+
+    auto result = garbageCollector.deleteRemovedDirectories();
+    assert(result.numberOfDirectoriesDeleted == 2);
+    assert(result.numberOfBytesReclaimed == 2 * (100 + std::string("metadata").size()));
+    assert(!std::experimental::filesystem::exists(TileFiles::directoryForTilesInFrames(entryPath, 0, 29, 1)));
+    assert(std::experimental::filesystem::exists(TileFiles::directoryForTilesInFrames(entryPath, 0, 89, 0)));
+    assert(!garbageCollector.collect().numberOfDirectoriesRetired);
+
+    // Only the statistics of the versions that are still stored are kept.
+    auto accesses = TileAccessStatistics::load(entryPath);
+    assert(accesses.size() == 1);
+    assert(accesses.begin()->first.tileVersion == 3);
+}
+
+TEST_F(TiledVideoGarbageCollectorTestFixture, testGarbageCollectionReclaimsAbandonedDirectories) {
+    auto entryPath = temporaryEntry("abandoned-directories-test", 4);
+
+    TileManifest manifest(entryPath);
+    auto original = TileFiles::directoryForTilesInFrames(entryPath, 0, 89, 0);
+    std::experimental::filesystem::create_directory(original);
+    std::ofstream(TileFiles::tileMetadataFilename(original)) << "metadata";
+    manifest.recordCommit(0, 89, 0, TileLayout(1, 1, {1920}, {1080}));
+
+    // Neither directory has metadata. One transaction is still writing, and the other one is gone.
+    auto live = TileFiles::pendingDirectoryForTiles(entryPath, 0, 1);
+    auto abandoned = TileFiles::directoryForTilesInFrames(entryPath, 30, 59, 2);
+    for (const auto &directory : {live, abandoned}) {
+        std::experimental::filesystem::create_directory(directory);
+        std::ofstream(TileFiles::tileFilename(directory, 0)) << std::string(100, 'x');
+    }
+    FileLock liveTransaction(TileFiles::transactionLockFilename(live), FileLock::Mode::Exclusive);
+    std::ofstream(TileFiles::transactionLockFilename(abandoned));
+
+    TiledVideoGarbageCollector garbageCollector("abandoned-directories-test", entryPath);
+    auto result = garbageCollector.collect();
+    assert(result.numberOfDirectoriesDeleted == 1);
+    assert(!std::experimental::filesystem::exists(abandoned));
+    assert(std::experimental::filesystem::exists(live));
+    assert(std::experimental::filesystem::exists(original));
+
+    // A directory whose transaction hasn't locked it yet is kept while any transaction holds the writers lock.
+    std::experimental::filesystem::create_directory(abandoned);
+    {
+        FileLock writersLock(TileFiles::tileWritersLockFilename(entryPath), FileLock::Mode::Shared);
+        assert(!garbageCollector.collect().numberOfDirectoriesDeleted);
+    }
+    assert(garbageCollector.collect().numberOfDirectoriesDeleted == 1);
+    assert(std::experimental::filesystem::exists(live));
+}
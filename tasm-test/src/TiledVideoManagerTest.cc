@@ -0,0 +1,66 @@
+#include "TiledVideoManager.h"
+#include <gtest/gtest.h>
+
+#include "TemporaryEntryTestFixture.h"
+#include "TileLocationProvider.h"
+#include "TileManifest.h"
+#include <cassert>
+
+using namespace tasm;
+
+class TiledVideoManagerTestFixture : public TemporaryEntryTestFixture {};
+
+TEST_F(TiledVideoManagerTestFixture, testTiledVideoManagerNoticesNewCommits) {
+    auto entryPath = temporaryEntry("tiled-video-manager-test");
+
+    TileManifest manifest(entryPath);
+    manifest.recordCommit(0, 59, 0, TileLayout(1, 1, {1920}, {1080}));
+    TiledVideoManager tiledVideoManager(std::make_shared<TiledEntry>("tiled-video-manager-test", entryPath));
+    assert(tiledVideoManager.isCurrent());
+    assert(tiledVideoManager.tileLayoutIdForFrame(30) == 0);
+
+    manifest.recordCommit(30, 59, 1, TileLayout(2, 1, {960, 960}, {1080}));
+    assert(!tiledVideoManager.isCurrent());
+    assert(TiledVideoManager(tiledVideoManager.entry()).tileLayoutForId(1)->numberOfTiles() == 2);
+}
+
+TEST_F(TiledVideoManagerTestFixture, testLatestIntervalIndexResolvesMostRecentLayouts) {
+    using Segment = LatestIntervalIndex<unsigned int>::Segment;
+    LatestIntervalIndex<unsigned int> index({
+        IntervalEntry<unsigned int>(0, 59, 0),
+        IntervalEntry<unsigned int>(30, 59, 2),
+        IntervalEntry<unsigned int>(10, 39, 1),
+        IntervalEntry<unsigned int>(90, 119, 3),
+        IntervalEntry<unsigned int>(100, 109, 3),
+    });
+    assert(index.segments() == std::vector<Segment>({{0, 9, 0}, {10, 29, 1}, {30, 59, 2}, {90, 119, 3}}));
+
+    int id;
+    assert(index.idForPoint(9, id) && id == 0);
+    assert(index.idForPoint(29, id) && id == 1);
+    assert(index.idForPoint(30, id) && id == 2);
+    assert(!index.idForPoint(60, id));
+    assert(!index.idForPoint(120, id));
+
+    assert(index.segmentsInRange(5, 35) == std::vector<Segment>({{5, 9, 0}, {10, 29, 1}, {30, 34, 2}}));
+    assert(index.segmentsInRange(50, 100) == std::vector<Segment>({{50, 59, 2}, {90, 99, 3}}));
+    assert(index.segmentsInRange(60, 90).empty());
+}
+
+TEST_F(TiledVideoManagerTestFixture, testTileLocationsAreResolvedPerGOP) {
+    auto entryPath = temporaryEntry("tile-locations-test");
+
+    TileManifest manifest(entryPath);
+    manifest.recordCommit(0, 89, 0, TileLayout(1, 1, {1920}, {1080}));
+    manifest.recordCommit(30, 59, 1, TileLayout(2, 1, {960, 960}, {1080}));
+    auto tiledVideoManager = std::make_shared<TiledVideoManager>(std::make_shared<TiledEntry>("tile-locations-test", entryPath));
+    assert(tiledVideoManager->locationForFrame(29).lastFrameInDirectory == 29);
+    assert(tiledVideoManager->locationForFrame(30).directory->id == 1);
+    assert(tiledVideoManager->locationForFrame(75).lastFrameInDirectory == 89);
+
+    SingleTileLocationProvider locationProvider(tiledVideoManager);
+    assert(locationProvider.tileLayoutForFrame(45)->numberOfTiles() == 2);
+    assert(locationProvider.locationOfTileForFrame(1, 45) == TileFiles::tileFilename(TileFiles::directoryForTilesInFrames(entryPath, 30, 59, 1), 1));
+    assert(&locationProvider.locationOfTileForFrame(0, 0) == &locationProvider.locationOfTileForFrame(0, 20));
+    assert(locationProvider.lastFrameInSameTileFile(60) == 89);
+}
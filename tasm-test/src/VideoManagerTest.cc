@@ -1,9 +1,20 @@
 #include "VideoManager.h"
 #include <gtest/gtest.h>
 
+#include "Files.h"
+#include "LayoutCache.h"
+#include "SemanticDataManager.h"
 #include "SemanticIndex.h"
+#include "SemanticSelection.h"
+#include "SmartTileConfigurationProvider.h"
+#include "StabilizedTileConfigurationProvider.h"
+#include "TileLayoutPlanner.h"
+#include "TiledVideoManager.h"
 #include "Video.h"
+#include "VideoConfiguration.h"
 #include <cassert>
+#include <fstream>
+#include <thread>
 
 using namespace tasm;
 
@@ -71,3 +82,432 @@ TEST_F(VideoManagerTestFixture, testAccumulateRegret) {
     videoManager.retileVideoBasedOnRegret(video);
 }
 
+
+TEST_F(VideoManagerTestFixture, testCompactTiledVideo) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+    std::string video("red10-compact");
+    std::string label("fish");
+    for (auto i = 0u; i < 90; ++i)
+        semanticIndex->addMetadata(video, label, i, 5, 5, 200, 150);
+
+    VideoManager videoManager;
+    videoManager.storeWithUniformLayout("/home/maureen/red102k.mp4", video, 1, 1);
+    videoManager.activateRegretBasedRetilingForVideo(video, video, semanticIndex, 0.1);
+
+    auto selectPixels = [&] {
+        std::shared_ptr<TemporalSelection> temporalSelection;
+        auto selection = videoManager.select(video, video, std::make_shared<SingleMetadataSelection>(label), temporalSelection, semanticIndex);
+        std::vector<std::vector<uint8_t>> images;
+        ImagePtr image;
+        while ((image = selection->next()))
+            images.emplace_back(image->pixels(), image->pixels() + image->width() * image->height() * 4);
+        return images;
+    };
+    for (auto i = 0; i < 5; ++i)
+        selectPixels();
+
+    // Re-tiling the GOPs one at a time leaves one directory per GOP, all with the same layout.
+    auto gopLength = TiledEntry(video).gopLength();
+    assert(gopLength);
+    assert(videoManager.retileGOPsBasedOnRegret(video, {1}) == 1);
+    assert(videoManager.retileGOPsBasedOnRegret(video, {2}) == 1);
+
+    auto layoutsBefore = std::make_unique<TiledVideoManager>(std::make_shared<TiledEntry>(video));
+    assert(layoutsBefore->locationForFrame(gopLength).directory != layoutsBefore->locationForFrame(2 * gopLength).directory);
+    auto imagesBefore = selectPixels();
+    assert(imagesBefore.size() == 90);
+
+    assert(videoManager.compactTiledVideo(video) == 1);
+    // Everything that could be merged already was.
+    assert(!videoManager.compactTiledVideo(video));
+
+    // The merged GOPs are read from one directory, with the layouts they had, and the original directory is untouched.
+    TiledVideoManager layoutsAfter(std::make_shared<TiledEntry>(video));
+    assert(layoutsAfter.locationForFrame(gopLength).directory == layoutsAfter.locationForFrame(2 * gopLength).directory);
+    for (auto frame = 0u; frame < 3 * gopLength; ++frame)
+        assert(*layoutsAfter.locationForFrame(frame).directory->layout == *layoutsBefore->locationForFrame(frame).directory->layout);
+    assert(TileFiles::tileVersionFromPath(layoutsAfter.locationForFrame(0).directory->path) == TileFiles::OriginalTileVersion);
+    assert(selectPixels() == imagesBefore);
+}
+
+TEST_F(VideoManagerTestFixture, testStabilizeLayoutsAcrossGOPs) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+
+    std::string video("jitter");
+    std::string label("car");
+    unsigned int gopLength = 30;
+    for (auto i = 0u; i < 3 * gopLength; ++i) {
+        // The object moves slightly each GOP, which changes the fine-grained layout.
+        auto x = 600 + 10 * (i / gopLength);
+        semanticIndex->addMetadata(video, label, i, x, 400, x + 200, 600);
+    }
+
+    auto semanticDataManager = std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>(label), std::shared_ptr<TemporalSelection>());
+    auto fineGrained = std::make_shared<FineGrainedTileConfigurationProvider>(gopLength, semanticDataManager, 1920, 1080);
+    StabilizedTileConfigurationProvider stabilized(fineGrained, std::make_shared<Workload>(semanticDataManager), gopLength, 0.1);
+
+    assert(*fineGrained->tileLayoutForFrame(0) != *fineGrained->tileLayoutForFrame(2 * gopLength));
+    assert(stabilized.tileLayoutForFrame(2 * gopLength) == stabilized.tileLayoutForFrame(0));
+}
+
+TEST_F(VideoManagerTestFixture, testTileForWeightedWorkload) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+
+    std::string video("traffic");
+    unsigned int gopLength = 30;
+    for (auto i = 0u; i < gopLength; ++i) {
+        semanticIndex->addMetadata(video, "car", i, 100, 100, 400, 300);
+        semanticIndex->addMetadata(video, "person", i, 1500, 700, 1600, 900);
+    }
+
+    auto carQuery = std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>("car"));
+    auto personQuery = std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>("person"));
+
+    SmartTileConfigurationProviderMultipleSelection carOnly(gopLength, semanticIndex, video,
+            std::make_shared<Workload>(std::vector<std::shared_ptr<SemanticDataManager>>{carQuery}, std::vector<unsigned int>{1}), 1920, 1080);
+    FineGrainedTileConfigurationProvider aroundCars(gopLength, carQuery, 1920, 1080);
+    assert(*carOnly.tileLayoutForFrame(0) == *aroundCars.tileLayoutForFrame(0));
+
+    SmartTileConfigurationProviderMultipleSelection mixed(gopLength, semanticIndex, video,
+            std::make_shared<Workload>(std::vector<std::shared_ptr<SemanticDataManager>>{carQuery, personQuery}, std::vector<unsigned int>{10, 1}), 1920, 1080);
+    assert(mixed.tileLayoutForFrame(0)->numberOfTiles() > 1);
+}
+
+TEST_F(VideoManagerTestFixture, testPlanLayoutsInParallel) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+
+    std::string video("planned");
+    std::string label("car");
+    unsigned int gopLength = 30;
+    unsigned int numberOfFrames = 10 * gopLength + 5;
+    for (auto i = 0u; i < numberOfFrames; ++i) {
+        auto x = 32 * (i / gopLength);
+        semanticIndex->addMetadata(video, label, i, x, 400, x + 300, 600);
+    }
+
+    auto semanticDataManager = std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>(label));
+    auto fineGrained = std::make_shared<FineGrainedTileConfigurationProvider>(gopLength, semanticDataManager, 1920, 1080);
+    auto planned = TileLayoutPlanner(gopLength, 4).planForFrames(fineGrained, numberOfFrames);
+
+    for (auto frame = 0u; frame < numberOfFrames; frame += 7)
+        assert(planned->tileLayoutForFrame(frame) == fineGrained->tileLayoutForFrame(frame));
+}
+
+TEST_F(VideoManagerTestFixture, testSaveAndLoadRegretState) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+
+    std::string video("regret-state");
+    unsigned int gopLength = 30;
+    for (auto i = 0u; i < 3 * gopLength; ++i)
+        semanticIndex->addMetadata(video, "car", i, 100, 100, 400, 300);
+
+    auto untiled = std::make_shared<SingleTileConfigurationProvider>(1920, 1080);
+    auto query = std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>("car"), std::make_shared<RangeTemporalSelection>(0, 2 * gopLength));
+
+    RegretAccumulator original(semanticIndex, video, 1920, 1080, gopLength, 0);
+    original.addRegretForQuery(std::make_shared<Workload>(query), untiled);
+    auto path = std::experimental::filesystem::temp_directory_path() / "regret-state-test.bin";
+    original.save(path);
+
+    RegretAccumulator loaded(semanticIndex, video, 1920, 1080, gopLength, 0);
+    assert(loaded.load(path));
+    RegretAccumulator differentVideo(semanticIndex, video, 1280, 720, gopLength, 0);
+    assert(!differentVideo.load(path));
+    std::experimental::filesystem::remove(path);
+
+    // Saves are debounced, and a state that can't be read is rebuilt rather than failing.
+    original.saveIfDue(path, std::chrono::seconds(3600));
+    assert(!std::experimental::filesystem::exists(path));
+    original.addRegretForQuery(std::make_shared<Workload>(query), untiled);
+    original.saveIfDue(path, std::chrono::seconds(0));
+    assert(std::experimental::filesystem::exists(path));
+    std::ofstream(path, std::ios::trunc) << "not a regret state";
+    RegretAccumulator corrupt(semanticIndex, video, 1920, 1080, gopLength, 0);
+    assert(!corrupt.load(path));
+    assert(corrupt.candidateLayouts().empty());
+    std::experimental::filesystem::remove(path);
+
+    auto originalLayouts = original.getNewGOPLayouts();
+    auto loadedLayouts = loaded.getNewGOPLayouts();
+    assert(originalLayouts->size() == 2);
+    assert(loadedLayouts->size() == originalLayouts->size());
+    for (const auto &gopAndLayout : *originalLayouts)
+        assert(*loadedLayouts->at(gopAndLayout.first)->tileLayoutForFrame(gopAndLayout.first * gopLength) == *gopAndLayout.second->tileLayoutForFrame(gopAndLayout.first * gopLength));
+}
+
+TEST_F(VideoManagerTestFixture, testTakeLayoutsForBackgroundRetiling) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+
+    std::string video("background-retile");
+    unsigned int gopLength = 30;
+    for (auto i = 0u; i < 3 * gopLength; ++i)
+        semanticIndex->addMetadata(video, "car", i, 100, 100, 400, 300);
+
+    auto untiled = std::make_shared<SingleTileConfigurationProvider>(1920, 1080);
+    auto query = std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>("car"), std::make_shared<RangeTemporalSelection>(0, 2 * gopLength));
+
+    RegretAccumulator regretAccumulator(semanticIndex, video, 1920, 1080, gopLength, 0);
+    regretAccumulator.addRegretForQuery(std::make_shared<Workload>(query), untiled);
+
+    auto candidates = regretAccumulator.gopsWorthRetiling();
+    assert(candidates.size() == 2);
+    for (const auto &candidate : candidates) {
+        assert(candidate.regret > 0);
+        assert(candidate.encodeCost > 0);
+    }
+
+    // A GOP keeps its regret until its re-tile is committed.
+    assert(regretAccumulator.layoutToRetileGOP(0));
+    assert(regretAccumulator.layoutToRetileGOP(0));
+    assert(!regretAccumulator.layoutToRetileGOP(2));
+    regretAccumulator.resetRegretForRetiledGOP(0);
+    assert(!regretAccumulator.layoutToRetileGOP(0));
+    assert(regretAccumulator.gopsWorthRetiling().size() == 1);
+
+    auto foregroundActivity = std::make_shared<ForegroundActivity>();
+    auto token = foregroundActivity->begin();
+    assert(!foregroundActivity->isIdle(std::chrono::milliseconds(0)));
+    token.reset();
+    assert(foregroundActivity->isIdle(std::chrono::milliseconds(0)));
+
+    // A token can outlive whatever owned the activity.
+    std::weak_ptr<ForegroundActivity> weakActivity = foregroundActivity;
+    token = foregroundActivity->begin();
+    foregroundActivity.reset();
+    assert(!weakActivity.expired());
+    token.reset();
+    assert(weakActivity.expired());
+}
+
+TEST_F(VideoManagerTestFixture, testBackgroundRetilingYieldsToQueries) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+    std::string video("red10-background");
+    std::string label("fish");
+    for (auto i = 0u; i < 90; ++i)
+        semanticIndex->addMetadata(video, label, i, 5, 5, 200, 150);
+
+    VideoManager videoManager;
+    videoManager.storeWithUniformLayout("/home/maureen/red102k.mp4", video, 1, 1);
+    videoManager.activateRegretBasedRetilingForVideo(video, video, semanticIndex, 0.1);
+    std::shared_ptr<TemporalSelection> temporalSelection;
+    for (auto i = 0; i < 5; ++i) {
+        auto selection = videoManager.select(video, video, std::make_shared<SingleMetadataSelection>(label), temporalSelection, semanticIndex);
+        while (selection->next()) {}
+    }
+
+    auto candidates = videoManager.gopsWorthRetiling();
+    assert(candidates.size() > 1);
+
+    // Re-tile one GOP at a time, with two jobs allowed, as soon as the budget allows.
+    RetilingBudget budget;
+    budget.encodeTimeFraction = 1;
+    budget.maxBurstSeconds = 0.001;
+    budget.maxConcurrentRetiles = 2;
+    budget.maxGOPsPerRetile = 1;
+    budget.pollInterval = std::chrono::milliseconds(10);
+    budget.foregroundQuietPeriod = std::chrono::milliseconds(100);
+
+    auto foregroundActivity = std::make_shared<ForegroundActivity>();
+    auto query = foregroundActivity->begin();
+    {
+        RetilingScheduler scheduler(videoManager, foregroundActivity, budget);
+
+        // Nothing is re-tiled while a query is running.
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        assert(scheduler.videosBeingRetiled().empty());
+        assert(videoManager.gopsWorthRetiling().size() == candidates.size());
+
+        query.reset();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(5);
+        while (!videoManager.gopsWorthRetiling().empty()) {
+            assert(std::chrono::steady_clock::now() < deadline);
+            // The video is only ever re-tiled by one job at a time.
+            assert(scheduler.videosBeingRetiled().size() <= 1);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    // Each GOP was re-tiled around the queried objects.
+    auto gopLength = TiledEntry(video).gopLength();
+    TiledVideoManager tiledVideoManager(std::make_shared<TiledEntry>(video));
+    auto expectedLayouts = CachedTileConfigurationProvider::fineGrainedLayoutProvider(gopLength,
+            std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<OrMetadataSelection>(std::vector<std::string>{label})),
+            tiledVideoManager.totalWidth(), tiledVideoManager.totalHeight());
+    for (const auto &videoAndCandidate : candidates) {
+        auto frame = videoAndCandidate.second.gop * gopLength;
+        auto &layout = *tiledVideoManager.locationForFrame(frame).directory->layout;
+        assert(layout.numberOfTiles() > 1);
+        assert(layout == *expectedLayouts->tileLayoutForFrame(frame));
+    }
+}
+
+TEST_F(VideoManagerTestFixture, testQuerySummaryEstimatesSameCostAsQuery) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+
+    std::string video("query-summary");
+    unsigned int gopLength = 30;
+    for (auto i = 0u; i < gopLength; ++i) {
+        semanticIndex->addMetadata(video, "car", i, 100 + 10 * i, 100, 400 + 10 * i, 300);
+        if (i < 10)
+            semanticIndex->addMetadata(video, "car", i, 1300, 700, 1500, 900);
+    }
+
+    auto query = std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>("car"));
+    GOPQuerySummary summary(1920, 1080);
+    for (auto frame : query->orderedFrames())
+        summary.addRectangles(frame, query->rectanglesForFrame(frame));
+    summary.addQueries(1, 0, 1);
+
+    auto fineGrained = std::make_shared<FineGrainedTileConfigurationProvider>(gopLength, query, 1920, 1080);
+    auto untiled = std::make_shared<SingleTileConfigurationProvider>(1920, 1080);
+    for (auto &provider : std::vector<std::shared_ptr<TileLayoutProvider>>{fineGrained, untiled}) {
+        auto layout = provider->tileLayoutForFrame(0);
+        auto expected = WorkloadCostEstimator(provider, std::make_shared<Workload>(query), gopLength).estimateCostForGOP(0, *layout);
+        auto estimated = summary.estimateCostForLayout(*layout, 0, nullptr);
+        assert(estimated.numPixels == expected.numPixels);
+        assert(estimated.numTiles == expected.numTiles);
+        assert(estimated.numFiles == expected.numFiles);
+    }
+
+    // Without room for any history, regret is still accumulated for the current query.
+    RegretAccumulator regretAccumulator(semanticIndex, video, 1920, 1080, gopLength, 0, CostModel::defaultModel(), 0);
+    regretAccumulator.addRegretForQuery(std::make_shared<Workload>(query), untiled);
+    assert(regretAccumulator.getNewGOPLayouts()->size() == 1);
+}
+
+TEST_F(VideoManagerTestFixture, testCandidateLayoutsFollowCoOccurrence) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+
+    std::string video("co-occurrence");
+    unsigned int gopLength = 30;
+    std::vector<std::string> labels{"a", "b", "c", "d", "e", "f"};
+    for (auto i = 0u; i < gopLength; ++i) {
+        semanticIndex->addMetadata(video, "car", i, 100, 100, 400, 300);
+        semanticIndex->addMetadata(video, "person", i, 300, 200, 500, 400);
+        for (auto j = 0u; j < labels.size(); ++j)
+            semanticIndex->addMetadata(video, labels[j], gopLength + i, 300 * j, 600, 300 * j + 100, 700);
+    }
+
+    auto untiled = std::make_shared<SingleTileConfigurationProvider>(1920, 1080);
+    auto queryFor = [&](const std::string &label) {
+        return std::make_shared<Workload>(std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>(label)));
+    };
+
+    // Objects that are always found together are also proposed together.
+    RegretAccumulator coOccurring(semanticIndex, video, 1920, 1080, gopLength, 0);
+    coOccurring.addRegretForQuery(queryFor("car"), untiled);
+    coOccurring.addRegretForQuery(queryFor("person"), untiled);
+    auto candidates = coOccurring.candidateLayouts();
+    assert(std::find(candidates.begin(), candidates.end(), "car_person") != candidates.end());
+
+    // Objects that are never found together are not, and dominated candidates are dropped.
+    RegretAccumulator capped(semanticIndex, video, 1920, 1080, gopLength, 0, CostModel::defaultModel(), RegretAccumulator::DefaultMaxHistoryBytes, 2);
+    for (const auto &label : labels)
+        capped.addRegretForQuery(queryFor(label), untiled);
+    assert(capped.candidateLayouts().size() <= 2);
+}
+
+TEST_F(VideoManagerTestFixture, testRegretSeesMetadataAddedAfterInvalidation) {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+
+    std::string video("regret-invalidation");
+    unsigned int gopLength = 30;
+    for (auto i = 0u; i < gopLength; ++i) {
+        semanticIndex->addMetadata(video, "car", i, 100, 100, 400, 300);
+        semanticIndex->addMetadata(video, "bike", gopLength + i, 1300, 700, 1500, 900);
+    }
+
+    auto untiled = std::make_shared<SingleTileConfigurationProvider>(1920, 1080);
+    auto queryFor = [&](const std::string &label) {
+        return std::make_shared<Workload>(std::make_shared<SemanticDataManager>(semanticIndex, video, std::make_shared<SingleMetadataSelection>(label)));
+    };
+
+    RegretAccumulator regretAccumulator(semanticIndex, video, 1920, 1080, gopLength, 0);
+    regretAccumulator.addRegretForQuery(queryFor("car"), untiled);
+    regretAccumulator.addRegretForQuery(queryFor("bike"), untiled);
+
+    // Bikes now also appear with the cars, and trucks with both.
+    for (auto i = 0u; i < gopLength; ++i) {
+        semanticIndex->addMetadata(video, "bike", i, 200, 150, 450, 350);
+        semanticIndex->addMetadata(video, "truck", i, 150, 100, 350, 300);
+    }
+    regretAccumulator.invalidateMetadata();
+
+    regretAccumulator.addRegretForQuery(queryFor("truck"), untiled);
+    auto candidates = regretAccumulator.candidateLayouts();
+    assert(std::find(candidates.begin(), candidates.end(), "bike_car_truck") != candidates.end());
+}
+
+TEST_F(VideoManagerTestFixture, testCommitMuxesEveryTile) {
+    VideoManager manager;
+    manager.storeWithUniformLayout("/home/maureen/red102k.mp4", "red10-4x4", 4, 4);
+
+    TiledVideoManager tiledVideoManager(std::make_shared<TiledEntry>("red10-4x4"));
+    for (auto id : tiledVideoManager.tileLayoutIds()) {
+        auto directory = tiledVideoManager.directoryForId(id);
+        for (auto tile = 0u; tile < tiledVideoManager.tileLayoutForId(id)->numberOfTiles(); ++tile)
+            assert(std::experimental::filesystem::exists(TileFiles::tileFilename(directory, tile)));
+
+        // Tiles are written straight into their mp4s, so no raw streams are left behind.
+        for (auto &file : std::experimental::filesystem::directory_iterator(directory))
+            assert(file.path().extension() != ".hevc");
+    }
+}
+
+TEST_F(VideoManagerTestFixture, testStreamedTilesAreCommittedToFinalDirectories) {
+    VideoManager manager;
+    manager.storeWithUniformLayout("/home/maureen/red102k.mp4", "red10-streamed", 2, 2);
+
+    // Every group is written to a pending directory while it is encoded, and renamed once its last frame is known.
+    auto entry = std::make_shared<TiledEntry>("red10-streamed");
+    for (auto &dir : std::experimental::filesystem::directory_iterator(entry->path()))
+        assert(dir.path().filename().string().find("pending") == std::string::npos);
+
+    TiledVideoManager tiledVideoManager(entry);
+    for (auto id : tiledVideoManager.tileLayoutIds()) {
+        auto directory = tiledVideoManager.directoryForId(id);
+        for (auto tile = 0u; tile < tiledVideoManager.tileLayoutForId(id)->numberOfTiles(); ++tile)
+            assert(std::experimental::filesystem::exists(TileFiles::tileFilename(directory, tile)));
+    }
+}
+
+TEST_F(VideoManagerTestFixture, testSelectPackedVideo) {
+    VideoManager manager;
+    // The directory the video is first stored into is never packed, so store it twice.
+    manager.storeWithUniformLayout("/home/maureen/red102k.mp4", "red10-packed-select", 2, 2);
+    manager.storeWithUniformLayout("/home/maureen/red102k.mp4", "red10-packed-select", 2, 2);
+
+    TiledVideoManager tiledVideoManager(std::make_shared<TiledEntry>("red10-packed-select"));
+    auto tilePath = tiledVideoManager.locationForFrame(0).directory->tilePaths.at(1);
+    auto configuration = video::GetConfiguration(tilePath);
+    assert(manager.packTiledVideo("red10-packed-select") == 1);
+    assert(!std::experimental::filesystem::exists(tilePath));
+
+    // The tile's configuration is read from the pack once its mp4 is gone.
+    auto packedConfiguration = video::GetConfiguration(tilePath);
+    assert(packedConfiguration->displayWidth == configuration->displayWidth);
+    assert(packedConfiguration->displayHeight == configuration->displayHeight);
+    assert(packedConfiguration->codedWidth == configuration->codedWidth);
+    assert(packedConfiguration->codedHeight == configuration->codedHeight);
+    assert(packedConfiguration->frameRate == configuration->frameRate);
+    assert(packedConfiguration->codec == configuration->codec);
+
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+    std::string video("red10-packed-select");
+    std::string label("fish");
+    for (int i = 0; i < 10; ++i)
+        semanticIndex->addMetadata(video, label, i, 5, 5, 20, 100);
+
+    // Both scans read every tile they need from the pack.
+    std::shared_ptr<TemporalSelection> temporalSelection;
+    for (auto strategy : {SelectStrategy::Objects, SelectStrategy::Frames}) {
+        auto selection = manager.select(video, video, std::make_shared<SingleMetadataSelection>(label), temporalSelection, semanticIndex, strategy);
+        auto count = 0u;
+        while (selection->next())
+            ++count;
+        assert(count == 10);
+    }
+
+    assert(manager.unpackTiledVideo("red10-packed-select") == 1);
+    assert(video::GetConfiguration(tilePath)->frameRate == configuration->frameRate);
+}
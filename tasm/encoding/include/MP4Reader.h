@@ -1,11 +1,17 @@
 #ifndef TASM_MP4READER_H
 #define TASM_MP4READER_H
 
+#include "Files.h"
+#include "TilePack.h"
 #include "gpac/isomedia.h"
 #include "gpac/internal/isomedia_dev.h"
 #include "gpac/list.h"
 #include <experimental/filesystem>
+#include <memory>
+#include <vector>
 
+// Reads the samples of an mp4. If the mp4 is a tile whose directory has been packed, and the mp4 itself has been removed,
+// the samples are read from the directory's tile pack instead.
 class MP4Reader {
 public:
     explicit MP4Reader(const std::experimental::filesystem::path &filename)
@@ -18,6 +24,12 @@ public:
             return;
         }
 
+        if (setUpTilePack()) {
+            keyframeNumbers_ = tilePack_->keyframeNumbers(packedTile_);
+            numberOfSamples_ = tilePack_->numberOfSamples();
+            return;
+        }
+
         setUpGFIsomFile();
 
         GF_TrackBox *trak = gf_isom_get_track_from_file2(file_, trackNumber_);
@@ -39,32 +51,32 @@ public:
               keyframeNumbers_(other.keyframeNumbers_),
               numberOfSamples_(other.numberOfSamples_),
               numberOfSamplesRead_(other.numberOfSamplesRead_),
-              invalidFile_(other.invalidFile_)
+              invalidFile_(other.invalidFile_),
+              tilePack_(other.tilePack_),
+              packedTile_(other.packedTile_),
+              sampleTable_(other.sampleTable_)
     {
         other.closeFile();
-        if (invalidFile_)
+        if (invalidFile_ || tilePack_)
             file_ = NULL;
         else
             setUpGFIsomFile();
     }
 
     ~MP4Reader() {
-        if (file_) {
-            gf_isom_close(file_);
-            file_ = NULL;
-        }
+        closeFile();
     }
 
-    void closeFile() const {
-        if (file_) {
-            gf_isom_close(file_);
-            file_ = NULL;
-        }
-    }
+    void closeFile() const;
 
     void setNewFileWithSameKeyframes(const std::experimental::filesystem::path &filename) {
         closeFile();
         filename_ = filename;
+        sampleTable_ = nullptr;
+        if (setUpTilePack()) {
+            numberOfSamples_ = tilePack_->numberOfSamples();
+            return;
+        }
         setUpGFIsomFile();
 
         numberOfSamples_ = gf_isom_get_sample_count(file_, trackNumber_);
@@ -92,7 +104,42 @@ public:
 
     std::unique_ptr<std::vector<char>> dataForSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) const;
 
+    // Sizes of the encoded samples as recorded in the sample table, indexed by frame number.
+    std::vector<unsigned int> sampleSizes() const;
+
 private:
+    // Where each sample is stored in the file, and what is needed to turn the stored samples into Annex-B.
+    struct SampleTable {
+        std::vector<u64> offsets;
+        std::vector<u32> sizes;
+        // The track's parameter sets, each preceded by a start code, which are inserted before every keyframe.
+        std::vector<char> parameterSets;
+        // The size of the length that precedes each NAL unit in a sample, or 0 if the samples can't be read directly.
+        unsigned int nalUnitLengthSize;
+    };
+
+    const SampleTable &sampleTable() const;
+    std::shared_ptr<const SampleTable> buildSampleTable() const;
+    bool isKeyframe(unsigned int frameNumber) const;
+    std::unique_ptr<std::vector<char>> readSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) const;
+    std::unique_ptr<std::vector<char>> extractSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) const;
+    void readAt(char *data, u64 size, u64 offset) const;
+
+    bool setUpTilePack() {
+        tilePack_ = nullptr;
+        if (std::experimental::filesystem::exists(filename_))
+            return false;
+
+        auto tilePackFilename = tasm::TileFiles::tilePackFilename(filename_.parent_path());
+        if (!std::experimental::filesystem::exists(tilePackFilename))
+            return false;
+
+        file_ = NULL;
+        tilePack_ = tasm::TilePack::open(tilePackFilename);
+        packedTile_ = tasm::TileFiles::tileNumberFromPath(filename_);
+        return true;
+    }
+
     void setUpGFIsomFile() {
         file_ = gf_isom_open(filename_.c_str(), GF_ISOM_OPEN_READ, nullptr);
         u32 flags = GF_ISOM_NALU_EXTRACT_INBAND_PS_FLAG | GF_ISOM_NALU_EXTRACT_ANNEXB_FLAG;
@@ -122,6 +169,11 @@ private:
     unsigned int numberOfSamples_;
     unsigned int numberOfSamplesRead_ = 0;
     bool invalidFile_;
+    std::shared_ptr<const tasm::TilePack> tilePack_;
+    unsigned int packedTile_ = 0;
+    // Looked up the first time samples are read, and shared with copies of this reader and other readers of the same file.
+    mutable std::shared_ptr<const SampleTable> sampleTable_;
+    mutable int fileDescriptor_ = -1;
 };
 
 #endif //TASM_MP4READER_H
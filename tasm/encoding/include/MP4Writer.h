@@ -0,0 +1,67 @@
+#ifndef TASM_MP4WRITER_H
+#define TASM_MP4WRITER_H
+
+#include "gpac/isomedia.h"
+#include <experimental/filesystem>
+#include <vector>
+
+namespace tasm {
+
+// Writes an HEVC elementary stream into an mp4 as it is produced, so the stream never has to be written to disk and
+// imported afterwards.
+// Each access unit is appended to the file as a sample as soon as the next one starts, and the moov is written when
+// the writer is closed. Only the access unit that is being parsed is held in memory.
+// The parameter sets that come before the first access unit go into the track's configuration, and copies of them in
+// the stream are dropped. Parameter sets that differ from those are kept in the samples.
+// The stream must be Annex-B, may be written in chunks of any size, and must not have B-frames.
+class MP4Writer {
+public:
+    MP4Writer(const std::experimental::filesystem::path &filename, unsigned int frameRate);
+
+    // Removes the file if the writer was not closed.
+    ~MP4Writer();
+
+    MP4Writer(const MP4Writer&) = delete;
+    MP4Writer &operator=(const MP4Writer&) = delete;
+
+    void write(const char *data, size_t size);
+
+    // Writes the last access unit and the moov. Throws if the stream had no access units.
+    void close();
+
+    // Stops writing and removes the file.
+    void abandon();
+
+    const std::experimental::filesystem::path &filename() const { return filename_; }
+    unsigned int numberOfSamples() const { return numberOfSamples_; }
+
+private:
+    void parseNALUnits(bool isEndOfStream);
+    void addNALUnit(const unsigned char *nalUnit, size_t size);
+    void appendToAccessUnit(const unsigned char *nalUnit, size_t size);
+    void finishAccessUnit();
+    void createTrack();
+
+    const std::experimental::filesystem::path filename_;
+    const unsigned int frameRate_;
+    GF_ISOFile *file_;
+    u32 trackNumber_;
+    u32 sampleDescriptionIndex_;
+    unsigned int numberOfSamples_;
+
+    // Bytes of the stream that are not part of a complete NAL unit yet.
+    std::vector<unsigned char> pendingData_;
+
+    // The access unit that is being parsed, with 4-byte NAL unit lengths.
+    std::vector<char> accessUnit_;
+    bool accessUnitHasPicture_;
+    bool accessUnitIsKeyframe_;
+
+    // Each parameter set NAL unit, in the order that they were first seen.
+    std::vector<std::vector<unsigned char>> parameterSets_;
+    bool hasInBandParameterSets_;
+};
+
+} // namespace tasm
+
+#endif //TASM_MP4WRITER_H
@@ -0,0 +1,98 @@
+#ifndef TASM_TILEPACK_H
+#define TASM_TILEPACK_H
+
+#include <cstdint>
+#include <experimental/filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+struct Configuration;
+
+namespace tasm {
+
+// A single file that holds the encoded samples of every tile in a tile directory, so reading several tiles of a
+// directory opens one file rather than one mp4 per tile.
+//
+// The samples are stored as Annex-B, with in-band parameter sets, exactly as MP4Reader extracts them from the tile mp4s.
+// Each tile's samples are contiguous and in order, so any range of samples of one tile is a single contiguous span.
+// The index follows the samples:
+//     number of tiles (u32), number of samples per tile (u32),
+//     for each tile: display width, display height, coded width, coded height, frame rate, codec, bitrate (u32 each)
+//     for each tile, for each sample: offset (u64), size (u32), is keyframe (u8)
+// and the file ends with the offset of the index (u64) followed by the magic string.
+struct TilePackSample {
+    uint64_t offset;
+    uint32_t size;
+    bool isKeyframe;
+};
+
+class TilePack {
+public:
+    // Throws if the file is missing or is not a complete tile pack.
+    explicit TilePack(const std::experimental::filesystem::path &filename);
+    ~TilePack();
+
+    TilePack(const TilePack&) = delete;
+    TilePack &operator=(const TilePack&) = delete;
+
+    // Packs are never modified once they are written, so readers of the same pack share one open file and index.
+    static std::shared_ptr<const TilePack> open(const std::experimental::filesystem::path &filename);
+
+    unsigned int numberOfTiles() const { return numberOfTiles_; }
+    unsigned int numberOfSamples() const { return numberOfSamples_; }
+
+    // The configuration of the tile's mp4 when it was packed.
+    const Configuration &configuration(unsigned int tile) const;
+
+    // Samples are 0-indexed.
+    const TilePackSample &sample(unsigned int tile, unsigned int sampleIndex) const {
+        return samples_[tile * numberOfSamples_ + sampleIndex];
+    }
+
+    // The 0-indexed keyframes of the tile. Like MP4Reader, this is empty if every sample is a keyframe.
+    std::vector<int> keyframeNumbers(unsigned int tile) const;
+
+    // Reads the samples in [firstSample, lastSample] with a single read.
+    std::unique_ptr<std::vector<char>> dataForSamples(unsigned int tile, unsigned int firstSample, unsigned int lastSample) const;
+
+    // Recreates the tile's mp4 at the destination.
+    void exportTile(unsigned int tile, const std::experimental::filesystem::path &destination) const;
+
+private:
+    void readIndex();
+    void readAt(char *data, uint64_t size, uint64_t offset) const;
+
+    const std::experimental::filesystem::path filename_;
+    int fileDescriptor_;
+    unsigned int numberOfTiles_;
+    unsigned int numberOfSamples_;
+    std::vector<Configuration> configurations_;
+    std::vector<TilePackSample> samples_;
+};
+
+// Writes a tile pack to a temporary file, which is renamed into place when the pack is committed.
+// Tiles must be written in order, each with the same number of samples.
+class TilePackWriter {
+public:
+    // There is one configuration for each tile.
+    TilePackWriter(const std::experimental::filesystem::path &filename, const std::vector<Configuration> &configurations);
+    ~TilePackWriter();
+
+    void writeSample(unsigned int tile, const std::vector<char> &data, bool isKeyframe);
+    void commit();
+
+private:
+    const std::experimental::filesystem::path filename_;
+    const std::experimental::filesystem::path temporaryFilename_;
+    const std::vector<Configuration> configurations_;
+    const unsigned int numberOfTiles_;
+    std::ofstream output_;
+    uint64_t offset_;
+    std::vector<std::vector<TilePackSample>> samples_;
+    bool committed_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEPACK_H
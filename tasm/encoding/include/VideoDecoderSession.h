@@ -20,11 +20,12 @@ public:
             : decoder_(decoder),
               nextDataQueue_(1000),
               isDoneReading_(false),
-              isComplete_(false) {
+              isComplete_(false),
+              decodeSeconds_(0) {
         reader_ = std::make_unique<std::thread>(&VideoDecoderSession::ReadNext, std::ref(decoder_), reader,
                                                 std::ref(nextDataQueue_), &isDoneReading_);
         worker_ = std::make_unique<std::thread>(&VideoDecoderSession::DecodeAll, std::ref(decoder_), std::ref(nextDataQueue_),
-                                                &isDoneReading_, &isComplete_);
+                                                &isDoneReading_, &isComplete_, &decodeSeconds_);
     }
 
     VideoDecoderSession(const VideoDecoderSession &) = delete;
@@ -40,6 +41,10 @@ public:
 
     bool isComplete() { return isComplete_; }
 
+    // Time spent parsing, decoding, and mapping pictures, excluding time spent waiting for data.
+    // Only complete once the session is complete.
+    double decodeSeconds() const { return decodeSeconds_; }
+
     template<typename Rep, typename Period, size_t interval=4>
     std::shared_ptr<DecodedFrame> decode(std::chrono::duration<Rep, Period> duration) {
         std::shared_ptr<CUVIDPARSERDISPINFO> packet;
@@ -75,6 +80,7 @@ private:
     DataQueue nextDataQueue_;
     std::atomic_bool isDoneReading_;
     std::atomic_bool isComplete_;
+    double decodeSeconds_;
 
     static CUvideoparser CreateParser(VideoDecoder &decoder) {
         CUresult status;
@@ -197,7 +203,8 @@ private:
     }
 
     static void
-    DecodeAll(VideoDecoder &decoder, DataQueue &nextDataQueue, std::atomic_bool *isDoneReading, std::atomic_bool *isComplete) {
+    DecodeAll(VideoDecoder &decoder, DataQueue &nextDataQueue, std::atomic_bool *isDoneReading, std::atomic_bool *isComplete,
+              double *decodeSeconds) {
         CUresult status;
         auto parser = CreateParser(decoder);
 
@@ -218,7 +225,12 @@ private:
             packet.flags = flags;
             packet.payload_size = combinedData->size();
             packet.payload = combinedData->data();
-            if ((status = cuvidParseVideoData(parser, &packet)) != CUDA_SUCCESS) {
+
+            // The parser decodes and maps pictures through its callbacks before returning.
+            auto parseStart = std::chrono::steady_clock::now();
+            status = cuvidParseVideoData(parser, &packet);
+            *decodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+            if (status != CUDA_SUCCESS) {
                 cuvidDestroyVideoParser(parser);
                 throw std::runtime_error("Call to cuvidParseVideoData failed: " + std::to_string(status));
             }
@@ -1,16 +1,181 @@
 #include "MP4Reader.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+
+static const char START_CODE[] = {0, 0, 0, 1};
+
+void MP4Reader::closeFile() const {
+    if (file_) {
+        gf_isom_close(file_);
+        file_ = NULL;
+    }
+    if (fileDescriptor_ >= 0) {
+        close(fileDescriptor_);
+        fileDescriptor_ = -1;
+    }
+}
+
 std::unique_ptr<std::vector<char>> MP4Reader::dataForSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) const {
-    unsigned long size = 0;
+    // Sample numbers are 1-indexed, but samples in a tile pack are 0-indexed.
+    if (tilePack_)
+        return tilePack_->dataForSamples(packedTile_, firstSampleToRead - 1, lastSampleToRead - 1);
 
-    // First read to get sizes.
-    for (auto i = firstSampleToRead; i <= lastSampleToRead; i++) {
-        GF_ISOSample *sample = gf_isom_get_sample_info(file_, trackNumber_, i, NULL, NULL);
-        size += sample->dataLength;
+    return readSamples(firstSampleToRead, lastSampleToRead);
+}
+
+const MP4Reader::SampleTable &MP4Reader::sampleTable() const {
+    if (sampleTable_)
+        return *sampleTable_;
+
+    // Every query opens new readers for the tiles it reads, so the tables are shared by all readers of the same file.
+    // The file's identity is part of the key so that a tile rewritten at the same path isn't read with a stale table.
+    struct stat fileStatus;
+    if (stat(filename_.c_str(), &fileStatus))
+        throw std::runtime_error("Failed to stat " + filename_.string() + ": " + std::strerror(errno));
+    using SampleTableKey = std::tuple<std::string, dev_t, ino_t, off_t, time_t, long>;
+    SampleTableKey key(filename_.string(), fileStatus.st_dev, fileStatus.st_ino, fileStatus.st_size, fileStatus.st_mtim.tv_sec, fileStatus.st_mtim.tv_nsec);
+
+    static std::mutex mutex;
+    static std::map<SampleTableKey, std::weak_ptr<const SampleTable>> sampleTables;
+    {
+        std::scoped_lock lock(mutex);
+        auto cachedTable = sampleTables.find(key);
+        if (cachedTable != sampleTables.end() && (sampleTable_ = cachedTable->second.lock()))
+            return *sampleTable_;
+    }
+
+    // Scanning the samples is slow, so it isn't done under the lock. If another reader built the table first, use theirs.
+    auto sampleTable = buildSampleTable();
+    std::scoped_lock lock(mutex);
+    auto &cachedTable = sampleTables[key];
+    if (!(sampleTable_ = cachedTable.lock())) {
+        sampleTable_ = sampleTable;
+        cachedTable = sampleTable;
+    }
+
+    // Drop the entries of tables that no reader uses anymore.
+    for (auto it = sampleTables.begin(); it != sampleTables.end();) {
+        if (it->second.expired())
+            it = sampleTables.erase(it);
+        else
+            ++it;
+    }
+    return *sampleTable_;
+}
+
+std::shared_ptr<const MP4Reader::SampleTable> MP4Reader::buildSampleTable() const {
+    assert(file_);
+    auto sampleTable = std::make_shared<SampleTable>();
+    sampleTable->offsets.resize(numberOfSamples_);
+    sampleTable->sizes.resize(numberOfSamples_);
+    sampleTable->nalUnitLengthSize = 0;
+
+    bool hasOneSampleDescription = true;
+    for (auto i = 0u; i < numberOfSamples_; ++i) {
+        u32 sampleDescriptionIndex = 0;
+        u64 offset = 0;
+        GF_ISOSample *sample = gf_isom_get_sample_info(file_, trackNumber_, frameNumberToSampleNumber(i), &sampleDescriptionIndex, &offset);
+        sampleTable->offsets[i] = offset;
+        sampleTable->sizes[i] = sample->dataLength;
+        hasOneSampleDescription &= sampleDescriptionIndex == 1;
         gf_isom_sample_del(&sample);
     }
 
-    // Then read to get the actual data.
+    // Only HEVC tracks with a single configuration are read directly. Anything else goes through gpac.
+    GF_HEVCConfig *config = hasOneSampleDescription ? gf_isom_hevc_config_get(file_, trackNumber_, 1) : nullptr;
+    if (config) {
+        sampleTable->nalUnitLengthSize = config->nal_unit_size;
+        for (auto i = 0u; i < gf_list_count(config->param_array); ++i) {
+            auto parameterArray = reinterpret_cast<GF_HEVCParamArray*>(gf_list_get(config->param_array, i));
+            for (auto j = 0u; j < gf_list_count(parameterArray->nalus); ++j) {
+                auto parameterSet = reinterpret_cast<GF_AVCConfigSlot*>(gf_list_get(parameterArray->nalus, j));
+                sampleTable->parameterSets.insert(sampleTable->parameterSets.end(), std::begin(START_CODE), std::end(START_CODE));
+                sampleTable->parameterSets.insert(sampleTable->parameterSets.end(), parameterSet->data, parameterSet->data + parameterSet->size);
+            }
+        }
+        gf_odf_hevc_cfg_del(config);
+    }
+
+    return sampleTable;
+}
+
+bool MP4Reader::isKeyframe(unsigned int frameNumber) const {
+    return keyframeNumbers_.empty() || std::binary_search(keyframeNumbers_.begin(), keyframeNumbers_.end(), static_cast<int>(frameNumber));
+}
+
+std::unique_ptr<std::vector<char>> MP4Reader::readSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) const {
+    auto &table = sampleTable();
+    auto firstFrame = sampleNumberToFrameNumber(firstSampleToRead);
+    auto lastFrame = sampleNumberToFrameNumber(lastSampleToRead);
+
+    // Start codes are the same size as 4-byte lengths, so only those can be replaced in place.
+    // Samples muxed by gpac are stored back to back, but anything else is also read through gpac.
+    if (table.nalUnitLengthSize != sizeof(START_CODE))
+        return extractSamples(firstSampleToRead, lastSampleToRead);
+    for (auto frame = firstFrame + 1; frame <= lastFrame; ++frame) {
+        if (table.offsets[frame] != table.offsets[frame - 1] + table.sizes[frame - 1])
+            return extractSamples(firstSampleToRead, lastSampleToRead);
+    }
+
+    u64 numberOfKeyframes = 0;
+    for (auto frame = firstFrame; frame <= lastFrame; ++frame)
+        numberOfKeyframes += isKeyframe(frame);
+
+    auto &parameterSets = table.parameterSets;
+    u64 span = table.offsets[lastFrame] + table.sizes[lastFrame] - table.offsets[firstFrame];
+    u64 size = span + numberOfKeyframes * parameterSets.size();
+
+    // Read the samples into the end of the buffer. Moving each sample forward to make room for the parameter sets before
+    // keyframes never overwrites samples that haven't been moved yet, and when only the first sample is a keyframe
+    // every sample is already in place.
+    std::unique_ptr<std::vector<char>> videoData(new std::vector<char>(size));
+    auto data = videoData->data();
+    u64 source = size - span;
+    readAt(data + source, span, table.offsets[firstFrame]);
+
+    u64 destination = 0;
+    for (auto frame = firstFrame; frame <= lastFrame; ++frame) {
+        if (isKeyframe(frame)) {
+            std::memcpy(data + destination, parameterSets.data(), parameterSets.size());
+            destination += parameterSets.size();
+        }
+
+        auto sampleSize = table.sizes[frame];
+        if (destination != source)
+            std::memmove(data + destination, data + source, sampleSize);
+
+        // Replace the length before each NAL unit with a start code.
+        u64 position = 0;
+        while (position + sizeof(START_CODE) <= sampleSize) {
+            auto nalUnit = reinterpret_cast<unsigned char*>(data + destination + position);
+            u64 nalUnitSize = (u64(nalUnit[0]) << 24) | (nalUnit[1] << 16) | (nalUnit[2] << 8) | nalUnit[3];
+            std::memcpy(nalUnit, START_CODE, sizeof(START_CODE));
+            position += sizeof(START_CODE) + nalUnitSize;
+        }
+        if (position != sampleSize)
+            throw std::runtime_error("Sample " + std::to_string(frameNumberToSampleNumber(frame)) + " of " + filename_.string() + " has invalid NAL unit lengths");
+
+        source += sampleSize;
+        destination += sampleSize;
+    }
+
+    return videoData;
+}
+
+std::unique_ptr<std::vector<char>> MP4Reader::extractSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) const {
+    auto &table = sampleTable();
+    unsigned long size = 0;
+    for (auto i = firstSampleToRead; i <= lastSampleToRead; i++)
+        size += table.sizes[sampleNumberToFrameNumber(i)];
+
     std::unique_ptr<std::vector<char>> videoData(new std::vector<char>);
     videoData->reserve(size);
     for (auto i = firstSampleToRead; i <= lastSampleToRead; i++) {
@@ -20,4 +185,37 @@ std::unique_ptr<std::vector<char>> MP4Reader::dataForSamples(unsigned int firstS
     }
 
     return videoData;
-}
\ No newline at end of file
+}
+
+void MP4Reader::readAt(char *data, u64 size, u64 offset) const {
+    if (fileDescriptor_ < 0 && (fileDescriptor_ = open(filename_.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+        throw std::runtime_error("Failed to open " + filename_.string() + ": " + std::strerror(errno));
+
+    while (size) {
+        auto bytesRead = pread(fileDescriptor_, data, size, offset);
+        if (bytesRead < 0 && errno == EINTR)
+            continue;
+        if (bytesRead <= 0)
+            throw std::runtime_error("Failed to read " + filename_.string() + ": " + (bytesRead ? std::strerror(errno) : "unexpected end of file"));
+
+        data += bytesRead;
+        size -= bytesRead;
+        offset += bytesRead;
+    }
+}
+
+std::vector<unsigned int> MP4Reader::sampleSizes() const {
+    if (invalidFile_)
+        return {};
+
+    std::vector<unsigned int> sizes(numberOfSamples_);
+    if (tilePack_) {
+        for (auto i = 0u; i < numberOfSamples_; ++i)
+            sizes[i] = tilePack_->sample(packedTile_, i).size;
+        return sizes;
+    }
+
+    for (auto i = 0u; i < numberOfSamples_; ++i)
+        sizes[i] = gf_isom_get_sample_size(file_, trackNumber_, frameNumberToSampleNumber(i));
+    return sizes;
+}
@@ -0,0 +1,363 @@
+#include "MP4Writer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace tasm {
+
+static constexpr unsigned int NAL_UNIT_LENGTH_SIZE = 4;
+static constexpr unsigned int START_CODE_SIZE = 3;
+
+enum NALUnitType {
+    FirstIRAP = 16,
+    LastIRAP = 23,
+    FirstNonPicture = 32,
+    VPS = 32,
+    SPS = 33,
+    PPS = 34,
+    AccessUnitDelimiter = 35,
+    PrefixSEI = 39,
+};
+
+static unsigned int nalUnitType(const unsigned char *nalUnit) {
+    return (nalUnit[0] >> 1) & 0x3f;
+}
+
+// Non-picture NAL units that can only come before the first picture of an access unit.
+static bool startsAccessUnit(unsigned int type) {
+    return (type >= VPS && type <= AccessUnitDelimiter)
+        || type == PrefixSEI
+        || (type >= 41 && type <= 44)
+        || (type >= 48 && type <= 55);
+}
+
+static size_t findStartCode(const std::vector<unsigned char> &data, size_t position) {
+    for (; position + START_CODE_SIZE <= data.size(); ++position) {
+        if (!data[position] && !data[position + 1] && data[position + 2] == 1)
+            return position;
+    }
+    return data.size();
+}
+
+class BitReader {
+public:
+    // Reads the payload of a NAL unit, skipping its header and emulation prevention bytes.
+    BitReader(const std::vector<unsigned char> &nalUnit)
+        : position_(0) {
+        for (auto i = 2u; i < nalUnit.size(); ++i) {
+            if (i >= 4 && nalUnit[i] == 3 && !nalUnit[i - 1] && !nalUnit[i - 2])
+                continue;
+            data_.push_back(nalUnit[i]);
+        }
+    }
+
+    u64 bits(unsigned int count) {
+        u64 value = 0;
+        for (auto i = 0u; i < count; ++i, ++position_) {
+            if (position_ >= data_.size() * 8)
+                throw std::runtime_error("Truncated sequence parameter set");
+            value = (value << 1) | ((data_[position_ / 8] >> (7 - position_ % 8)) & 1);
+        }
+        return value;
+    }
+
+    u32 unsignedExpGolomb() {
+        auto leadingZeros = 0u;
+        while (!bits(1)) {
+            if (++leadingZeros > 31)
+                throw std::runtime_error("Invalid exp-Golomb code in sequence parameter set");
+        }
+        return static_cast<u32>((1ull << leadingZeros) - 1 + bits(leadingZeros));
+    }
+
+private:
+    std::vector<unsigned char> data_;
+    size_t position_;
+};
+
+// The fields of a sequence parameter set that go into the track's configuration.
+struct SequenceParameterSet {
+    u8 profileSpace;
+    u8 tierFlag;
+    u8 profileIdc;
+    u32 profileCompatibilityFlags;
+    u64 constraintIndicatorFlags;
+    u8 levelIdc;
+    u8 numberOfTemporalLayers;
+    bool temporalIdNested;
+    u8 chromaFormat;
+    u8 lumaBitDepth;
+    u8 chromaBitDepth;
+    u32 width;
+    u32 height;
+};
+
+static SequenceParameterSet parseSequenceParameterSet(const std::vector<unsigned char> &nalUnit) {
+    BitReader reader(nalUnit);
+    SequenceParameterSet sps{};
+
+    reader.bits(4); // sps_video_parameter_set_id
+    auto maxSubLayersMinus1 = static_cast<unsigned int>(reader.bits(3));
+    sps.numberOfTemporalLayers = maxSubLayersMinus1 + 1;
+    sps.temporalIdNested = reader.bits(1);
+
+    // profile_tier_level
+    sps.profileSpace = reader.bits(2);
+    sps.tierFlag = reader.bits(1);
+    sps.profileIdc = reader.bits(5);
+    sps.profileCompatibilityFlags = reader.bits(32);
+    sps.constraintIndicatorFlags = reader.bits(48);
+    sps.levelIdc = reader.bits(8);
+    std::vector<bool> subLayerProfilePresent(maxSubLayersMinus1), subLayerLevelPresent(maxSubLayersMinus1);
+    for (auto i = 0u; i < maxSubLayersMinus1; ++i) {
+        subLayerProfilePresent[i] = reader.bits(1);
+        subLayerLevelPresent[i] = reader.bits(1);
+    }
+    if (maxSubLayersMinus1)
+        reader.bits(2 * (8 - maxSubLayersMinus1));
+    for (auto i = 0u; i < maxSubLayersMinus1; ++i) {
+        if (subLayerProfilePresent[i])
+            reader.bits(88);
+        if (subLayerLevelPresent[i])
+            reader.bits(8);
+    }
+
+    reader.unsignedExpGolomb(); // sps_seq_parameter_set_id
+    sps.chromaFormat = reader.unsignedExpGolomb();
+    auto hasSeparateColourPlanes = sps.chromaFormat == 3 && reader.bits(1);
+    auto width = reader.unsignedExpGolomb();
+    auto height = reader.unsignedExpGolomb();
+    if (reader.bits(1)) {
+        auto isSubsampled = !hasSeparateColourPlanes && (sps.chromaFormat == 1 || sps.chromaFormat == 2);
+        auto horizontalUnit = isSubsampled ? 2 : 1;
+        auto verticalUnit = !hasSeparateColourPlanes && sps.chromaFormat == 1 ? 2 : 1;
+        auto left = reader.unsignedExpGolomb();
+        auto right = reader.unsignedExpGolomb();
+        auto top = reader.unsignedExpGolomb();
+        auto bottom = reader.unsignedExpGolomb();
+        width -= horizontalUnit * (left + right);
+        height -= verticalUnit * (top + bottom);
+    }
+    sps.width = width;
+    sps.height = height;
+    sps.lumaBitDepth = reader.unsignedExpGolomb() + 8;
+    sps.chromaBitDepth = reader.unsignedExpGolomb() + 8;
+    return sps;
+}
+
+MP4Writer::MP4Writer(const std::experimental::filesystem::path &filename, unsigned int frameRate)
+    : filename_(filename),
+    frameRate_(frameRate),
+    file_(gf_isom_open(filename_.c_str(), GF_ISOM_OPEN_WRITE, nullptr)),
+    trackNumber_(0),
+    sampleDescriptionIndex_(0),
+    numberOfSamples_(0),
+    accessUnitHasPicture_(false),
+    accessUnitIsKeyframe_(false),
+    hasInBandParameterSets_(false) {
+    assert(frameRate_);
+    if (!file_)
+        throw std::runtime_error("Error opening destination file " + filename_.string());
+}
+
+MP4Writer::~MP4Writer() {
+    if (file_)
+        abandon();
+}
+
+void MP4Writer::write(const char *data, size_t size) {
+    assert(file_);
+    pendingData_.insert(pendingData_.end(), data, data + size);
+    parseNALUnits(false);
+}
+
+void MP4Writer::parseNALUnits(bool isEndOfStream) {
+    // Anything before the first start code is not part of a NAL unit.
+    auto nalUnitStart = findStartCode(pendingData_, 0);
+    if (nalUnitStart == pendingData_.size()) {
+        if (isEndOfStream)
+            pendingData_.clear();
+        return;
+    }
+    nalUnitStart += START_CODE_SIZE;
+
+    // A NAL unit is only complete once the next start code is seen, or at the end of the stream.
+    while (nalUnitStart < pendingData_.size()) {
+        auto nextStartCode = findStartCode(pendingData_, nalUnitStart);
+        if (nextStartCode == pendingData_.size() && !isEndOfStream)
+            break;
+
+        // NAL units never end with a zero byte, so trailing zeros belong to the next start code.
+        auto nalUnitEnd = nextStartCode;
+        while (nalUnitEnd > nalUnitStart && !pendingData_[nalUnitEnd - 1])
+            --nalUnitEnd;
+        addNALUnit(pendingData_.data() + nalUnitStart, nalUnitEnd - nalUnitStart);
+        nalUnitStart = nextStartCode + START_CODE_SIZE;
+    }
+
+    if (isEndOfStream)
+        pendingData_.clear();
+    else
+        pendingData_.erase(pendingData_.begin(), pendingData_.begin() + (nalUnitStart - START_CODE_SIZE));
+}
+
+void MP4Writer::addNALUnit(const unsigned char *nalUnit, size_t size) {
+    if (size < 2)
+        return;
+
+    auto type = nalUnitType(nalUnit);
+    auto isPicture = type < FirstNonPicture;
+    if (accessUnitHasPicture_ && (isPicture ? size > 2 && (nalUnit[2] & 0x80) : startsAccessUnit(type)))
+        finishAccessUnit();
+
+    if (type == AccessUnitDelimiter)
+        return;
+
+    if (type >= VPS && type <= PPS) {
+        std::vector<unsigned char> parameterSet(nalUnit, nalUnit + size);
+        auto isKnown = std::find(parameterSets_.begin(), parameterSets_.end(), parameterSet) != parameterSets_.end();
+
+        // Once a parameter set has been kept in band, copies of the configuration's are needed to switch back to it.
+        if (isKnown && !hasInBandParameterSets_)
+            return;
+        if (!trackNumber_) {
+            if (!isKnown)
+                parameterSets_.push_back(std::move(parameterSet));
+            return;
+        }
+        hasInBandParameterSets_ = true;
+    }
+
+    if (isPicture) {
+        accessUnitHasPicture_ = true;
+        accessUnitIsKeyframe_ |= type >= FirstIRAP && type <= LastIRAP;
+    }
+    appendToAccessUnit(nalUnit, size);
+}
+
+void MP4Writer::appendToAccessUnit(const unsigned char *nalUnit, size_t size) {
+    for (auto i = NAL_UNIT_LENGTH_SIZE; i-- > 0;)
+        accessUnit_.push_back(static_cast<char>((size >> (8 * i)) & 0xff));
+    accessUnit_.insert(accessUnit_.end(), nalUnit, nalUnit + size);
+}
+
+void MP4Writer::finishAccessUnit() {
+    if (!accessUnitHasPicture_)
+        return;
+    if (!trackNumber_)
+        createTrack();
+
+    GF_ISOSample *sample = gf_isom_sample_new();
+    sample->data = accessUnit_.data();
+    sample->dataLength = accessUnit_.size();
+    sample->DTS = numberOfSamples_;
+    sample->CTS_Offset = 0;
+    sample->IsRAP = accessUnitIsKeyframe_;
+    auto result = gf_isom_add_sample(file_, trackNumber_, sampleDescriptionIndex_, sample);
+
+    // The data belongs to the access unit.
+    sample->data = nullptr;
+    sample->dataLength = 0;
+    gf_isom_sample_del(&sample);
+    if (result != GF_OK)
+        throw std::runtime_error("Error adding sample to " + filename_.string() + ": " + std::to_string(result));
+
+    ++numberOfSamples_;
+    accessUnit_.clear();
+    accessUnitHasPicture_ = false;
+    accessUnitIsKeyframe_ = false;
+}
+
+void MP4Writer::createTrack() {
+    auto sequenceParameterSet = std::find_if(parameterSets_.begin(), parameterSets_.end(), [](const auto &parameterSet) {
+        return nalUnitType(parameterSet.data()) == SPS;
+    });
+    if (sequenceParameterSet == parameterSets_.end())
+        throw std::runtime_error(filename_.string() + " has a picture before its sequence parameter set");
+    auto sps = parseSequenceParameterSet(*sequenceParameterSet);
+
+    // Each sample lasts one tick.
+    if (!(trackNumber_ = gf_isom_new_track(file_, 0, GF_ISOM_MEDIA_VISUAL, frameRate_)))
+        throw std::runtime_error("Error creating track in " + filename_.string());
+    gf_isom_set_track_enabled(file_, trackNumber_, 1);
+
+    GF_HEVCConfig *config = gf_odf_hevc_cfg_new();
+    config->configurationVersion = 1;
+    config->profile_space = sps.profileSpace;
+    config->tier_flag = sps.tierFlag;
+    config->profile_idc = sps.profileIdc;
+    config->general_profile_compatibility_flags = sps.profileCompatibilityFlags;
+    config->constraint_indicator_flags = sps.constraintIndicatorFlags;
+    config->level_idc = sps.levelIdc;
+    config->chromaFormat = sps.chromaFormat;
+    config->luma_bit_depth = sps.lumaBitDepth;
+    config->chroma_bit_depth = sps.chromaBitDepth;
+    config->numTemporalLayers = sps.numberOfTemporalLayers;
+    config->temporalIdNested = sps.temporalIdNested;
+    config->nal_unit_size = NAL_UNIT_LENGTH_SIZE;
+    for (auto type : {VPS, SPS, PPS}) {
+        GF_HEVCParamArray *parameterArray;
+        GF_SAFEALLOC(parameterArray, GF_HEVCParamArray);
+        parameterArray->array_completeness = 1;
+        parameterArray->type = type;
+        parameterArray->nalus = gf_list_new();
+        gf_list_add(config->param_array, parameterArray);
+
+        for (const auto &parameterSet : parameterSets_) {
+            if (nalUnitType(parameterSet.data()) != static_cast<unsigned int>(type))
+                continue;
+
+            GF_AVCConfigSlot *slot;
+            GF_SAFEALLOC(slot, GF_AVCConfigSlot);
+            slot->size = parameterSet.size();
+            slot->data = static_cast<char*>(gf_malloc(parameterSet.size()));
+            std::memcpy(slot->data, parameterSet.data(), parameterSet.size());
+            gf_list_add(parameterArray->nalus, slot);
+        }
+    }
+
+    // The configuration is copied into the sample description.
+    auto result = gf_isom_hevc_config_new(file_, trackNumber_, config, nullptr, nullptr, &sampleDescriptionIndex_);
+    gf_odf_hevc_cfg_del(config);
+    if (result != GF_OK)
+        throw std::runtime_error("Error configuring track in " + filename_.string() + ": " + std::to_string(result));
+
+    gf_isom_set_visual_info(file_, trackNumber_, sampleDescriptionIndex_, sps.width, sps.height);
+    gf_isom_set_track_layout_info(file_, trackNumber_, sps.width << 16, sps.height << 16, 0, 0, 0);
+}
+
+void MP4Writer::close() {
+    assert(file_);
+    try {
+        parseNALUnits(true);
+        finishAccessUnit();
+        if (!numberOfSamples_)
+            throw std::runtime_error(filename_.string() + " has no pictures");
+        if (hasInBandParameterSets_)
+            gf_isom_hevc_set_inband_config(file_, trackNumber_, sampleDescriptionIndex_);
+    } catch (...) {
+        abandon();
+        throw;
+    }
+
+    auto result = gf_isom_close(file_);
+    file_ = nullptr;
+    if (result != GF_OK) {
+        abandon();
+        throw std::runtime_error("Error closing file " + filename_.string() + ": " + std::to_string(result));
+    }
+}
+
+void MP4Writer::abandon() {
+    if (file_) {
+        gf_isom_delete(file_);
+        file_ = nullptr;
+    }
+
+    std::error_code error;
+    std::experimental::filesystem::remove(filename_, error);
+}
+
+} // namespace tasm
@@ -0,0 +1,246 @@
+#include "TilePack.h"
+
+#include "Configuration.h"
+#include "MP4Writer.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <unistd.h>
+
+namespace tasm {
+
+// Changed when the index gained each tile's configuration, so packs without one read as invalid.
+static constexpr char TILE_PACK_MAGIC[8] = {'T', 'A', 'S', 'M', 'P', 'K', '0', '2'};
+static constexpr auto CONFIGURATION_SIZE = 7 * sizeof(uint32_t);
+static constexpr auto INDEX_ENTRY_SIZE = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint8_t);
+static constexpr auto FOOTER_SIZE = sizeof(uint64_t) + sizeof(TILE_PACK_MAGIC);
+
+template <typename T>
+static void writeValue(std::ostream &output, T value) {
+    output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static T readValue(const char *&data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    data += sizeof(value);
+    return value;
+}
+
+TilePack::TilePack(const std::experimental::filesystem::path &filename)
+    : filename_(filename),
+    fileDescriptor_(::open(filename.c_str(), O_RDONLY | O_CLOEXEC)),
+    numberOfTiles_(0),
+    numberOfSamples_(0) {
+    if (fileDescriptor_ < 0)
+        throw std::runtime_error("Failed to open " + filename_.string() + ": " + std::strerror(errno));
+
+    try {
+        readIndex();
+    } catch (...) {
+        close(fileDescriptor_);
+        throw;
+    }
+}
+
+TilePack::~TilePack() {
+    close(fileDescriptor_);
+}
+
+std::shared_ptr<const TilePack> TilePack::open(const std::experimental::filesystem::path &filename) {
+    static std::mutex mutex;
+    static std::map<std::experimental::filesystem::path, std::weak_ptr<const TilePack>> openPacks;
+
+    std::scoped_lock lock(mutex);
+    auto &openPack = openPacks[filename];
+    auto pack = openPack.lock();
+    if (!pack) {
+        pack = std::make_shared<const TilePack>(filename);
+        openPack = pack;
+    }
+
+    // Drop the entries of packs that nothing reads anymore.
+    for (auto it = openPacks.begin(); it != openPacks.end();) {
+        if (it->second.expired())
+            it = openPacks.erase(it);
+        else
+            ++it;
+    }
+    return pack;
+}
+
+void TilePack::readIndex() {
+    auto fileSize = std::experimental::filesystem::file_size(filename_);
+    if (fileSize < FOOTER_SIZE)
+        throw std::runtime_error("Tile pack " + filename_.string() + " is truncated");
+
+    char footer[FOOTER_SIZE];
+    readAt(footer, FOOTER_SIZE, fileSize - FOOTER_SIZE);
+    if (std::memcmp(footer + sizeof(uint64_t), TILE_PACK_MAGIC, sizeof(TILE_PACK_MAGIC)))
+        throw std::runtime_error("Tile pack " + filename_.string() + " is truncated");
+
+    const char *footerData = footer;
+    auto indexOffset = readValue<uint64_t>(footerData);
+    if (indexOffset > fileSize - FOOTER_SIZE)
+        throw std::runtime_error("Tile pack " + filename_.string() + " has an invalid index offset");
+
+    std::vector<char> index(fileSize - FOOTER_SIZE - indexOffset);
+    readAt(index.data(), index.size(), indexOffset);
+
+    const char *data = index.data();
+    if (index.size() < 2 * sizeof(uint32_t))
+        throw std::runtime_error("Tile pack " + filename_.string() + " has an invalid index");
+    numberOfTiles_ = readValue<uint32_t>(data);
+    numberOfSamples_ = readValue<uint32_t>(data);
+    if (index.size() != 2 * sizeof(uint32_t) + uint64_t(numberOfTiles_) * (CONFIGURATION_SIZE + numberOfSamples_ * INDEX_ENTRY_SIZE))
+        throw std::runtime_error("Tile pack " + filename_.string() + " has an invalid index");
+
+    configurations_.resize(numberOfTiles_);
+    for (auto &configuration : configurations_) {
+        configuration.displayWidth = readValue<uint32_t>(data);
+        configuration.displayHeight = readValue<uint32_t>(data);
+        configuration.codedWidth = configuration.maxWidth = readValue<uint32_t>(data);
+        configuration.codedHeight = configuration.maxHeight = readValue<uint32_t>(data);
+        configuration.frameRate = readValue<uint32_t>(data);
+        configuration.codec = static_cast<Codec>(readValue<uint32_t>(data));
+        configuration.bitrate = readValue<uint32_t>(data);
+    }
+
+    samples_.resize(numberOfTiles_ * numberOfSamples_);
+    for (auto &sample : samples_) {
+        sample.offset = readValue<uint64_t>(data);
+        sample.size = readValue<uint32_t>(data);
+        sample.isKeyframe = readValue<uint8_t>(data);
+        if (sample.offset + sample.size > indexOffset)
+            throw std::runtime_error("Tile pack " + filename_.string() + " has a sample outside of its data");
+    }
+}
+
+void TilePack::readAt(char *data, uint64_t size, uint64_t offset) const {
+    while (size) {
+        auto bytesRead = pread(fileDescriptor_, data, size, offset);
+        if (bytesRead < 0 && errno == EINTR)
+            continue;
+        if (bytesRead <= 0)
+            throw std::runtime_error("Failed to read " + filename_.string() + ": " + (bytesRead ? std::strerror(errno) : "unexpected end of file"));
+
+        data += bytesRead;
+        size -= bytesRead;
+        offset += bytesRead;
+    }
+}
+
+const Configuration &TilePack::configuration(unsigned int tile) const {
+    assert(tile < numberOfTiles_);
+    return configurations_[tile];
+}
+
+std::vector<int> TilePack::keyframeNumbers(unsigned int tile) const {
+    std::vector<int> keyframeNumbers;
+    for (auto i = 0u; i < numberOfSamples_; ++i) {
+        if (sample(tile, i).isKeyframe)
+            keyframeNumbers.push_back(i);
+    }
+
+    if (keyframeNumbers.size() == numberOfSamples_)
+        keyframeNumbers.clear();
+    return keyframeNumbers;
+}
+
+std::unique_ptr<std::vector<char>> TilePack::dataForSamples(unsigned int tile, unsigned int firstSample, unsigned int lastSample) const {
+    assert(tile < numberOfTiles_);
+    assert(firstSample <= lastSample);
+    assert(lastSample < numberOfSamples_);
+
+    auto &first = sample(tile, firstSample);
+    auto &last = sample(tile, lastSample);
+    auto size = last.offset + last.size - first.offset;
+
+    std::unique_ptr<std::vector<char>> data(new std::vector<char>(size));
+    readAt(data->data(), size, first.offset);
+    return data;
+}
+
+void TilePack::exportTile(unsigned int tile, const std::experimental::filesystem::path &destination) const {
+    MP4Writer writer(destination, configuration(tile).frameRate);
+    if (numberOfSamples_) {
+        auto data = dataForSamples(tile, 0, numberOfSamples_ - 1);
+        writer.write(data->data(), data->size());
+    }
+    writer.close();
+}
+
+TilePackWriter::TilePackWriter(const std::experimental::filesystem::path &filename, const std::vector<Configuration> &configurations)
+    : filename_(filename),
+    temporaryFilename_(std::experimental::filesystem::path(filename).concat(".tmp")),
+    configurations_(configurations),
+    numberOfTiles_(configurations.size()),
+    output_(temporaryFilename_, std::ios::out | std::ios::trunc | std::ios::binary),
+    offset_(0),
+    samples_(numberOfTiles_),
+    committed_(false) {
+    if (!output_)
+        throw std::runtime_error("Failed to open " + temporaryFilename_.string());
+}
+
+TilePackWriter::~TilePackWriter() {
+    if (!committed_) {
+        output_.close();
+        std::error_code error;
+        std::experimental::filesystem::remove(temporaryFilename_, error);
+    }
+}
+
+void TilePackWriter::writeSample(unsigned int tile, const std::vector<char> &data, bool isKeyframe) {
+    assert(tile < numberOfTiles_);
+    // Each tile's samples must be contiguous.
+    assert(std::all_of(samples_.begin() + tile + 1, samples_.end(), [](const auto &samples) { return samples.empty(); }));
+
+    output_.write(data.data(), data.size());
+    samples_[tile].push_back({offset_, static_cast<uint32_t>(data.size()), isKeyframe});
+    offset_ += data.size();
+}
+
+void TilePackWriter::commit() {
+    auto numberOfSamples = numberOfTiles_ ? samples_.front().size() : 0;
+    for (const auto &samples : samples_) {
+        if (samples.size() != numberOfSamples)
+            throw std::runtime_error("Every tile in " + filename_.string() + " must have the same number of samples");
+    }
+
+    auto indexOffset = offset_;
+    writeValue<uint32_t>(output_, numberOfTiles_);
+    writeValue<uint32_t>(output_, numberOfSamples);
+    for (const auto &configuration : configurations_) {
+        writeValue<uint32_t>(output_, configuration.displayWidth);
+        writeValue<uint32_t>(output_, configuration.displayHeight);
+        writeValue<uint32_t>(output_, configuration.codedWidth);
+        writeValue<uint32_t>(output_, configuration.codedHeight);
+        writeValue<uint32_t>(output_, configuration.frameRate);
+        writeValue<uint32_t>(output_, static_cast<uint32_t>(configuration.codec));
+        writeValue<uint32_t>(output_, configuration.bitrate);
+    }
+    for (const auto &samples : samples_) {
+        for (const auto &sample : samples) {
+            writeValue<uint64_t>(output_, sample.offset);
+            writeValue<uint32_t>(output_, sample.size);
+            writeValue<uint8_t>(output_, sample.isKeyframe);
+        }
+    }
+    writeValue<uint64_t>(output_, indexOffset);
+    output_.write(TILE_PACK_MAGIC, sizeof(TILE_PACK_MAGIC));
+
+    output_.close();
+    if (!output_)
+        throw std::runtime_error("Failed to write " + temporaryFilename_.string());
+
+    std::experimental::filesystem::rename(temporaryFilename_, filename_);
+    committed_ = true;
+}
+
+} // namespace tasm
@@ -25,8 +25,9 @@ using ImagePtr = std::shared_ptr<Image>;
 
 class ImageIterator {
 public:
-    ImageIterator(std::shared_ptr<Operator<std::unique_ptr<std::vector<ImagePtr>>>> parent)
-    : parent_(parent) {}
+    // activityToken is held until every image has been returned. It lets background work tell when queries are running.
+    ImageIterator(std::shared_ptr<Operator<std::unique_ptr<std::vector<ImagePtr>>>> parent, std::shared_ptr<void> activityToken = nullptr)
+    : parent_(parent), activityToken_(activityToken) {}
 
     ImagePtr next() {
         if (!currentImages_ || imageIterator_ == currentImages_->end())
@@ -50,9 +51,12 @@ private:
         }
         if (currentImages_)
             imageIterator_ = currentImages_->begin();
+        else
+            activityToken_.reset();
     }
 
     std::shared_ptr<Operator<std::unique_ptr<std::vector<ImagePtr>>>> parent_;
+    std::shared_ptr<void> activityToken_;
     std::unique_ptr<std::vector<ImagePtr>> currentImages_;
     std::vector<ImagePtr>::const_iterator imageIterator_;
 };
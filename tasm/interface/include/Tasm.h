@@ -7,6 +7,7 @@
 #include "VideoManager.h"
 
 #include <memory>
+#include <stdexcept>
 #include <string>
 
 namespace tasm {
@@ -45,6 +46,20 @@ public:
         videoManager_.storeWithNonUniformLayout(videoPath, savedName, metadataIdentifier, std::make_shared<SingleMetadataSelection>(labelToTileAround), semanticIndex_, force);
     }
 
+    // Tiles around the specified labels, weighted by the number of times each label is expected to be queried.
+    virtual void storeWithWorkloadLayout(const std::string &videoPath, const std::string &savedName, const std::string &metadataIdentifier,
+            const std::vector<std::string> &labels, const std::vector<unsigned int> &queryCounts) {
+        if (labels.size() != queryCounts.size())
+            throw std::invalid_argument("storeWithWorkloadLayout requires one query count per label, but got "
+                    + std::to_string(labels.size()) + " labels and " + std::to_string(queryCounts.size()) + " query counts");
+
+        std::vector<std::shared_ptr<MetadataSelection>> metadataSelections(labels.size());
+        std::transform(labels.begin(), labels.end(), metadataSelections.begin(), [](const std::string &label) {
+            return std::make_shared<SingleMetadataSelection>(label);
+        });
+        videoManager_.storeWithWorkloadLayout(videoPath, savedName, metadataIdentifier, metadataSelections, queryCounts, semanticIndex_);
+    }
+
     virtual std::unique_ptr<ImageIterator> select(const std::string &video, const std::string &label, const std::string &metadataIdentifier = "") {
         return select(video, label, std::shared_ptr<TemporalSelection>(), metadataIdentifier);
     }
@@ -93,6 +108,22 @@ public:
         videoManager_.retileVideoBasedOnRegret(video);
     }
 
+    unsigned int compactTiledVideo(const std::string &video) {
+        return videoManager_.compactTiledVideo(video);
+    }
+
+    GarbageCollectionResult collectGarbage(const std::string &video) {
+        return videoManager_.collectGarbage(video);
+    }
+
+    unsigned int packTiledVideo(const std::string &video) {
+        return videoManager_.packTiledVideo(video);
+    }
+
+    unsigned int unpackTiledVideo(const std::string &video) {
+        return videoManager_.unpackTiledVideo(video);
+    }
+
     void activateRegretBasedTilingForVideo(const std::string &video, const std::string &metadataIdentifier = "", double threshold = 0) {
         videoManager_.activateRegretBasedRetilingForVideo(video, metadataIdentifier.length() ? metadataIdentifier : video, semanticIndex_, threshold);
     }
@@ -101,6 +132,42 @@ public:
         videoManager_.deactivateRegretBasedRetilingForVideo(video);
     }
 
+    void calibrateCostModel(const std::vector<std::string> &videoPaths) {
+        videoManager_.calibrateCostModel({videoPaths.begin(), videoPaths.end()});
+    }
+
+    // Layout stabilization is off until a tolerance is set.
+    void setLayoutStabilityTolerance(double tolerance) {
+        videoManager_.setLayoutStabilityTolerance(tolerance);
+    }
+
+    void disableLayoutStability() {
+        videoManager_.setLayoutStabilityTolerance(std::nullopt);
+    }
+
+    void setGOPLength(unsigned int gopLength) {
+        videoManager_.setGOPLength(gopLength);
+    }
+
+    unsigned int recommendGOPLength(const std::string &videoPath, unsigned int numberOfPointQueries, unsigned int numberOfRangeQueries, unsigned int averageRangeLength) {
+        return videoManager_.recommendGOPLength(videoPath, QueryMix{numberOfPointQueries, numberOfRangeQueries, averageRangeLength});
+    }
+
+    void startBackgroundRetiling(double encodeTimeFraction = 0.25, unsigned int maxConcurrentRetiles = 1) {
+        RetilingBudget budget;
+        budget.encodeTimeFraction = encodeTimeFraction;
+        budget.maxConcurrentRetiles = maxConcurrentRetiles;
+        videoManager_.startBackgroundRetiling(budget);
+    }
+
+    void stopBackgroundRetiling() {
+        videoManager_.stopBackgroundRetiling();
+    }
+
+    TileAccessMap tileAccessStatistics(const std::string &video) {
+        return videoManager_.tileAccessStatistics(video);
+    }
+
     virtual ~TASM() = default;
 
     std::shared_ptr<SemanticIndex> semanticIndex() const {
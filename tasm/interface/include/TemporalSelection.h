@@ -8,6 +8,8 @@ namespace tasm {
 class TemporalSelection {
 public:
     virtual std::string frameConstraints() const = 0;
+    virtual int firstFrameInclusive() const = 0;
+    virtual int lastFrameExclusive() const = 0;
 };
 
 class EqualTemporalSelection : public TemporalSelection {
@@ -19,6 +21,9 @@ public:
     std::string frameConstraints() const override {
         return "frame=" + std::to_string(frame_);
     }
+
+    int firstFrameInclusive() const override { return frame_; }
+    int lastFrameExclusive() const override { return frame_ + 1; }
 private:
     int frame_;
 };
@@ -33,6 +38,9 @@ public:
     std::string frameConstraints() const override {
         return "frame >= " + std::to_string(lowerBoundInclusive_) + " and frame < " + std::to_string(upperBoundExclusive_);
     }
+
+    int firstFrameInclusive() const override { return lowerBoundInclusive_; }
+    int lastFrameExclusive() const override { return upperBoundExclusive_; }
 private:
     int lowerBoundInclusive_;
     int upperBoundExclusive_;
@@ -10,10 +10,13 @@ void TASM::addMetadata(const std::string &video,
                        unsigned int x2,
                        unsigned int y2) {
     semanticIndex_->addMetadata(video, label, frame, x1, y1, x2, y2);
+    videoManager_.metadataChanged(video);
 }
 
 void TASM::addBulkMetadata(const std::vector<MetadataInfo> &metadataInfo) {
     semanticIndex_->addBulkMetadata(metadataInfo);
+    for (const auto &info : metadataInfo)
+        videoManager_.metadataChanged(info.video);
 }
 
 } // namespace tasm
\ No newline at end of file
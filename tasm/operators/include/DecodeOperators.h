@@ -6,6 +6,7 @@
 #include "EncodedData.h"
 #include "VideoDecoder.h"
 #include "VideoDecoderSession.h"
+#include <functional>
 
 namespace tasm {
 
@@ -36,6 +37,11 @@ public:
 
     bool isComplete() override { return isComplete_; }
 
+    // Called with the time spent decoding once every frame has been decoded.
+    void setCompletionHandler(std::function<void(double decodeSeconds)> completionHandler) {
+        completionHandler_ = std::move(completionHandler);
+    }
+
     std::optional<GPUDecodedFrameData> next() override {
         if (isComplete_)
             return {};
@@ -58,6 +64,8 @@ public:
         } else {
             std::cout << "Num-frames-from-decoder: " << numberOfFramesDecoded_ << std::endl;
             isComplete_ = true;
+            if (completionHandler_)
+                completionHandler_(session_.decodeSeconds());
             return std::nullopt;
         }
     }
@@ -77,6 +85,7 @@ private:
     VideoDecoder decoder_;
     VideoDecoderSession session_;
     int numberOfFramesDecoded_;
+    std::function<void(double)> completionHandler_;
 };
 
 } // namespace tasm
@@ -3,11 +3,14 @@
 
 #include "Operator.h"
 
+#include "CostFeedback.h"
 #include "EncodedData.h"
 #include "Rectangle.h"
 #include "SemanticDataManager.h"
 #include "TileLocationProvider.h"
 #include "StitchContext.h"
+#include "TileAccessStatistics.h"
+#include <chrono>
 
 namespace tasm {
 
@@ -17,15 +20,20 @@ public:
             std::shared_ptr<TiledEntry> entry,
             std::shared_ptr<SemanticDataManager> semanticDataManager,
             std::shared_ptr<TileLocationProvider> tileLocationProvider,
-            bool shouldReadEntireGOPs = false)
+            bool shouldReadEntireGOPs = false,
+            std::shared_ptr<CostFeedback> costFeedback = nullptr,
+            std::shared_ptr<TileAccessStatistics> tileAccessStatistics = nullptr)
             : isComplete_(false), entry_(entry), semanticDataManager_(semanticDataManager),
             tileLocationProvider_(tileLocationProvider),
             shouldReadEntireGOPs_(shouldReadEntireGOPs),
+            costFeedback_(costFeedback),
+            tileAccessStatistics_(tileAccessStatistics),
             totalVideoWidth_(0), totalVideoHeight_(0),
             totalNumberOfPixels_(0), totalNumberOfFrames_(0),
             totalNumberOfBytes_(0), numberOfTilesRead_(0),
+            readSeconds_(0),
             didSignalEOS_(false),
-            currentTileNumber_(0), currentTileArea_(0)
+            currentTileNumber_(0), currentTileVersion_(0), currentTileArea_(0)
     {
         preprocess();
     }
@@ -33,6 +41,10 @@ public:
     bool isComplete() override { return isComplete_; }
     std::optional<CPUEncodedFrameDataPtr> next() override;
 
+    // Feeds what was read, and how long reading and decoding it took, back into the cost model.
+    // The decoder measures its own time, so this is called once it has decoded everything that was read.
+    void recordExecutionStatistics(double decodeSeconds);
+
 private:
     void preprocess();
     void setUpNextEncodedFrameReader();
@@ -44,6 +56,8 @@ private:
     std::shared_ptr<SemanticDataManager> semanticDataManager_;
     std::shared_ptr<TileLocationProvider> tileLocationProvider_;
     bool shouldReadEntireGOPs_;
+    std::shared_ptr<CostFeedback> costFeedback_;
+    std::shared_ptr<TileAccessStatistics> tileAccessStatistics_;
 
     unsigned int totalVideoWidth_;
     unsigned int totalVideoHeight_;
@@ -52,11 +66,15 @@ private:
     unsigned long long int totalNumberOfFrames_;
     unsigned long long int totalNumberOfBytes_;
     unsigned int numberOfTilesRead_;
+
+    // Time spent reading tiles.
+    double readSeconds_;
     bool didSignalEOS_;
 
     std::shared_ptr<const TileLayout> currentTileLayout_;
     std::unique_ptr<std::experimental::filesystem::path> currentTilePath_;
     unsigned int currentTileNumber_;
+    unsigned int currentTileVersion_;
     std::unique_ptr<EncodedFrameReader> currentEncodedFrameReader_;
     std::unordered_map<std::string, Configuration> tilePathToConfiguration_;
 
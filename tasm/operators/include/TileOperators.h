@@ -6,6 +6,7 @@
 #include "MultipleEncoderManager.h"
 #include "Operator.h"
 #include "TileConfigurationProvider.h"
+#include "Transaction.h"
 #include "Video.h"
 
 namespace tasm {
@@ -36,6 +37,7 @@ public:
 
 private:
     void reconfigureEncodersForNewLayout(std::shared_ptr<const TileLayout> newLayout);
+    void startTileGroup();
     void saveTileGroupsToDisk();
     void encodeFrameToTiles(GPUFramePtr frame, int frameNumber);
     void readDataFromEncoders(bool shouldFlush);
@@ -53,7 +55,10 @@ private:
     unsigned int frameNumber_;
     std::vector<unsigned int> tilesCurrentlyBeingEncoded_;
 
-    std::unordered_map<unsigned int, std::list<std::unique_ptr<std::vector<char>>>> encodedDataForTiles_;
+    // Encoded data is written to the group's transaction as soon as it is read from the encoders,
+    // so only the data for frames still inside the encoders is held in memory.
+    std::unique_ptr<TileCrackingTransaction> transaction_;
+    std::unordered_map<unsigned int, OutputStream*> tileStreams_;
 };
 
 } // namespace tasm
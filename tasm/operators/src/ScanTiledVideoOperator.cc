@@ -49,14 +49,11 @@ std::shared_ptr<std::vector<int>> ScanTiledVideoOperator::nextGroupOfFramesWithT
         totalVideoHeight_ = currentTileLayout_->totalHeight();
     }
 
+    // Frames are ordered, so the group ends with the last frame in the current file.
+    auto lastFrameInFile = static_cast<int>(tileLocationProvider_->lastFrameInSameTileFile(*frameIt));
     auto framesWithSamePathAndConfiguration = std::make_shared<std::vector<int>>();
-    framesWithSamePathAndConfiguration->push_back(*frameIt++);
-    while (frameIt != endIt) {
-        if (tileLocationProvider_->locationOfTileForFrame(fakeTileNumber, *frameIt) == *currentTilePath_)
-            framesWithSamePathAndConfiguration->push_back(*frameIt++);
-        else
-            break;
-    }
+    while (frameIt != endIt && *frameIt <= lastFrameInFile)
+        framesWithSamePathAndConfiguration->push_back(*frameIt++);
 
     return framesWithSamePathAndConfiguration;
 }
@@ -102,6 +99,7 @@ void ScanTiledVideoOperator::setUpNextEncodedFrameReader() {
         currentTileArea_ = orderedTileInformationIt_->width * orderedTileInformationIt_->height;
         currentTilePath_ = std::make_unique<std::experimental::filesystem::path>(orderedTileInformationIt_->filename);
         currentTileNumber_ = orderedTileInformationIt_->tileNumber;
+        currentTileVersion_ = TileFiles::tileVersionFromPath(currentTilePath_->parent_path());
 
         ++orderedTileInformationIt_;
     }
@@ -116,16 +114,21 @@ std::optional<CPUEncodedFrameDataPtr> ScanTiledVideoOperator::next() {
         std::cout << "ANALYSIS: num-frames-decoded " << totalNumberOfFrames_ << std::endl;
         std::cout << "ANALYSIS: num-bytes-decoded " << totalNumberOfBytes_ << std::endl;
         std::cout << "ANALYSIS: num-tiles-read " << numberOfTilesRead_ << std::endl;
+        if (tileAccessStatistics_)
+            tileAccessStatistics_->flushIfDue();
         isComplete_ = true;
         return {};
     }
 
+    auto readStart = std::chrono::steady_clock::now();
+
     if (!currentEncodedFrameReader_ || currentEncodedFrameReader_->isEos()) {
         setUpNextEncodedFrameReader();
 
         // If the frame reader is still empty, then there are no more frames to read.
         // Flush the decoder.
         if (!currentEncodedFrameReader_) {
+            readSeconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - readStart).count();
             didSignalEOS_ = true;
             CUVIDSOURCEDATAPACKET packet;
             memset(&packet, 0, sizeof(packet));
@@ -152,6 +155,9 @@ std::optional<CPUEncodedFrameDataPtr> ScanTiledVideoOperator::next() {
     totalNumberOfPixels_ += gopPacket->numberOfFrames() * currentTileArea_;
     totalNumberOfFrames_ += gopPacket->numberOfFrames();
     totalNumberOfBytes_ += gopPacket->data()->size();
+    readSeconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - readStart).count();
+    if (tileAccessStatistics_)
+        tileAccessStatistics_->recordRead(currentTileVersion_, currentTileNumber_, gopPacket->firstFrameIndex(), gopPacket->data()->size());
 
     unsigned long flags = 0;
     auto data = std::make_shared<CPUEncodedFrameData>(configuration, DecodeReaderPacket(*gopPacket->data(), flags));
@@ -161,6 +167,17 @@ std::optional<CPUEncodedFrameDataPtr> ScanTiledVideoOperator::next() {
     return {data};
 }
 
+void ScanTiledVideoOperator::recordExecutionStatistics(double decodeSeconds) {
+    if (!costFeedback_ || !totalNumberOfFrames_)
+        return;
+
+    // totalNumberOfFrames_ counts each tile of each frame, which matches how CostElements counts tiles.
+    costFeedback_->recordExecution(entry_->path(), {
+        CostElements(totalNumberOfPixels_, totalNumberOfFrames_, totalNumberOfBytes_, numberOfTilesRead_),
+        readSeconds_,
+        decodeSeconds});
+}
+
 static std::vector<unsigned int> ToCtbs(const std::vector<unsigned int> &pixelVals) {
     std::vector<unsigned int> ctbs(pixelVals.size() - 1);
     std::transform(pixelVals.begin(), std::prev(pixelVals.end(), 1), ctbs.begin(), [](auto &v) { return std::ceil(v / ALIGNMENT); });
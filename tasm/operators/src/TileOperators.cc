@@ -1,7 +1,6 @@
 #include "TileOperators.h"
 
 #include "EncodeAPI.h"
-#include "Transaction.h"
 
 namespace tasm {
 
@@ -35,6 +34,7 @@ std::optional<GPUDecodedFrameData> TileOperator::next() {
 
             currentTileLayout_ = tileLayout;
             firstFrameInGroup_ = frameNumber;
+            startTileGroup();
         }
 
         // Encode each tile.
@@ -42,6 +42,9 @@ std::optional<GPUDecodedFrameData> TileOperator::next() {
         encodeFrameToTiles(frame, frameNumber);
     }
 
+    // Write out whatever the encoders have finished with so it isn't held until the end of the group.
+    readDataFromEncoders(false);
+
     return decodedData;
 }
 
@@ -53,37 +56,43 @@ void TileOperator::reconfigureEncodersForNewLayout(std::shared_ptr<const tasm::T
     }
 }
 
-void TileOperator::saveTileGroupsToDisk() {
-    if (!currentTileLayout_ || *currentTileLayout_ == EmptyTileLayout) {
+void TileOperator::startTileGroup() {
+    tileStreams_.clear();
+    if (*currentTileLayout_ == EmptyTileLayout)
         return;
-    }
 
+    // The last frame in the group isn't known yet, so the transaction writes to a pending directory.
     assert(tilesCurrentlyBeingEncoded_.size());
-    TileCrackingTransaction transaction(outputEntry_,
-                                      *currentTileLayout_,
-                                      firstFrameInGroup_,
-                                      lastFrameInGroup_);
+    transaction_ = std::make_unique<TileCrackingTransaction>(outputEntry_,
+                                                            *currentTileLayout_,
+                                                            parent_->configuration().frameRate,
+                                                            firstFrameInGroup_);
 
     // Get the list of tiles that should be involved in the current tile layout.
     // Create an output for each.
-    for (auto &tileIndex : tilesCurrentlyBeingEncoded_) {
-        auto &output = transaction.write(tileIndex);
-
-        // Write the encoded data for this tile index to the output stream.
-        for (auto &data : encodedDataForTiles_[tileIndex])
-            output.stream().write(data->data(), data->size());
+    for (auto &tileIndex : tilesCurrentlyBeingEncoded_)
+        tileStreams_[tileIndex] = &transaction_->write(tileIndex);
+}
 
-        encodedDataForTiles_[tileIndex].clear();
-    }
+void TileOperator::saveTileGroupsToDisk() {
+    if (!transaction_)
+        return;
 
-    transaction.commit();
+    transaction_->setLastFrame(lastFrameInGroup_);
+    transaction_->commit();
+    transaction_.reset();
+    tileStreams_.clear();
 }
 
 void TileOperator::readDataFromEncoders(bool shouldFlush) {
     for (auto &i : tilesCurrentlyBeingEncoded_) {
         auto encodedData = shouldFlush ? tileEncodersManager_.flushEncoderForIdentifier(i) : tileEncodersManager_.getEncodedFramesForIdentifier(i);
-        if (!encodedData->empty())
-            encodedDataForTiles_[i].push_back(std::move(encodedData));
+        if (encodedData->empty())
+            continue;
+
+        auto stream = tileStreams_.find(i);
+        if (stream != tileStreams_.end())
+            stream->second->write(encodedData->data(), encodedData->size());
     }
 }
 
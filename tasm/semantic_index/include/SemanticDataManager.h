@@ -5,6 +5,7 @@
 #include "SemanticIndex.h"
 #include "SemanticSelection.h"
 #include "TemporalSelection.h"
+#include <mutex>
 
 namespace tasm {
 
@@ -24,20 +25,33 @@ public:
             maxHeight_(maxHeight)
     {}
 
+    // The index is queried without holding the lock so that threads planning different GOPs don't wait on each other.
+    // When two threads query the same data, the first result to be published is kept.
     const std::vector<int> &orderedFrames() {
-        if (orderedFrames_)
-            return *orderedFrames_;
+        {
+            std::scoped_lock lock(mutex_);
+            if (orderedFrames_)
+                return *orderedFrames_;
+        }
 
-        orderedFrames_ = index_->orderedFramesForSelection(video_, metadataSelection_, temporalSelection_);
+        auto orderedFrames = index_->orderedFramesForSelection(video_, metadataSelection_, temporalSelection_);
+        std::scoped_lock lock(mutex_);
+        if (!orderedFrames_)
+            orderedFrames_ = std::move(orderedFrames);
         return *orderedFrames_;
     }
 
     const std::list<Rectangle> &rectanglesForFrame(int frame) {
-        if (frameToRectangles_.count(frame))
-            return *frameToRectangles_.at(frame);
+        {
+            std::scoped_lock lock(mutex_);
+            auto rectangles = frameToRectangles_.find(frame);
+            if (rectangles != frameToRectangles_.end())
+                return *rectangles->second;
+        }
 
-        frameToRectangles_.emplace(frame, std::move(index_->rectanglesForFrame(video_, metadataSelection_, frame, maxWidth_, maxHeight_)));
-        return *frameToRectangles_.at(frame);
+        auto rectangles = index_->rectanglesForFrame(video_, metadataSelection_, frame, maxWidth_, maxHeight_);
+        std::scoped_lock lock(mutex_);
+        return *frameToRectangles_.emplace(frame, std::move(rectangles)).first->second;
     }
 
     std::unique_ptr<std::list<Rectangle>> rectanglesForFrames(int firstFrameInclusive, int lastFrameExclusive) {
@@ -45,6 +59,10 @@ public:
     }
 
     const std::vector<std::string> &labelsInQuery() const { return metadataSelection_->objects(); }
+    const std::string &metadataIdentifier() const { return video_; }
+    std::shared_ptr<MetadataSelection> metadataSelection() const { return metadataSelection_; }
+    std::shared_ptr<TemporalSelection> temporalSelection() const { return temporalSelection_; }
+    std::shared_ptr<SemanticIndex> index() const { return index_; }
 
 private:
     std::shared_ptr<SemanticIndex> index_;
@@ -54,6 +72,8 @@ private:
     unsigned int maxWidth_;
     unsigned int maxHeight_;
 
+    // Layouts may be planned for several GOPs at once, so the caches are shared between threads.
+    std::mutex mutex_;
     std::unique_ptr<std::vector<int>> orderedFrames_;
     std::unordered_map<int, std::unique_ptr<std::list<Rectangle>>> frameToRectangles_;
 };
@@ -62,12 +62,16 @@ public:
             int firstFrameInclusive,
             int lastFrameExclusive) = 0;
 
+    // Identifies the index's data across processes, or is empty if the data only lives in this index.
+    virtual std::string identity() const = 0;
+
     virtual ~SemanticIndex() {}
 };
 
 class SemanticIndexSQLiteBase : public SemanticIndex {
 public:
     void addBulkMetadata(const std::vector<MetadataInfo>&) override;
+    std::string identity() const override { return std::experimental::filesystem::absolute(dbPath_).string(); }
     virtual void setup() {
         openDatabase(dbPath_);
         initializeStatements();
@@ -138,6 +142,9 @@ protected:
     SemanticIndexSQLiteInMemory()
             : SemanticIndexSQLite(":memory:")
     { }
+
+public:
+    std::string identity() const override { return ""; }
 };
 
 class SemanticIndexWH : public SemanticIndexSQLiteBase {
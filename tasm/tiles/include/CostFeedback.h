@@ -0,0 +1,115 @@
+#ifndef TASM_COSTFEEDBACK_H
+#define TASM_COSTFEEDBACK_H
+
+#include "CostModel.h"
+#include "WorkloadCostEstimator.h"
+#include <chrono>
+#include <experimental/filesystem>
+#include <mutex>
+
+namespace tasm {
+
+struct QueryExecutionStatistics {
+    CostElements costs;
+    double readSeconds;
+    double decodeSeconds;
+};
+
+// Log of the measured cost of the queries run against a video. It lives in the video's catalog entry.
+// Records are appended, and once the file holds about twice maxNumberOfRecords it is compacted to the most recent
+// maxNumberOfRecords, so it stays bounded however many queries run.
+class QueryStatisticsStore {
+public:
+    static constexpr unsigned int DefaultMaxNumberOfRecords = 1000;
+
+    QueryStatisticsStore(const std::experimental::filesystem::path &entryPath, unsigned int maxNumberOfRecords = DefaultMaxNumberOfRecords)
+        : path_(entryPath / statistics_filename_),
+        lockPath_(entryPath / statistics_lock_filename_),
+        maxNumberOfRecords_(maxNumberOfRecords) {}
+
+    void record(const QueryExecutionStatistics &statistics);
+
+    // Returns at most the maxNumberOfRecords most recent records, oldest first.
+    std::vector<QueryExecutionStatistics> load(unsigned int maxNumberOfRecords = DefaultMaxNumberOfRecords) const;
+
+private:
+    std::vector<QueryExecutionStatistics> loadLocked(unsigned int maxNumberOfRecords) const;
+    void compactLocked() const;
+
+    static constexpr auto statistics_filename_ = "query-statistics";
+    static constexpr auto statistics_lock_filename_ = "query-statistics.lock";
+    std::experimental::filesystem::path path_;
+    std::experimental::filesystem::path lockPath_;
+    unsigned int maxNumberOfRecords_;
+};
+
+// Refits the decode and read weights of a cost model from measured query executions.
+// The fit is recursive least squares with exponential forgetting, so recent measurements count the most and the
+// weights follow changes in load. Features are scaled to megapixels and megabytes to keep the fit well conditioned.
+class OnlineCostModelFitter {
+public:
+    OnlineCostModelFitter(std::shared_ptr<CostModel> costModel, double forgettingFactor = 0.98)
+        : costModel_(costModel),
+        forgettingFactor_(forgettingFactor) {
+        assert(forgettingFactor_ > 0 && forgettingFactor_ <= 1);
+        reset();
+    }
+
+    // Restart the fit from the cost model's current coefficients, e.g. after it was recalibrated.
+    void reset();
+    void addObservation(const QueryExecutionStatistics &statistics);
+
+private:
+    static constexpr double PixelScale = 1e6;
+    static constexpr double ByteScale = 1e6;
+
+    struct RecursiveLeastSquares {
+        double weights[2];
+        double covariance[2][2] = {{1, 0}, {0, 1}};
+
+        void update(double x0, double x1, double y, double forgettingFactor);
+    };
+
+    std::mutex mutex_;
+    std::shared_ptr<CostModel> costModel_;
+    double forgettingFactor_;
+    RecursiveLeastSquares decodeFit_;
+    RecursiveLeastSquares readFit_;
+};
+
+// Records the statistics of executed queries and feeds them back into the cost model.
+// The refit coefficients are saved at most once per save interval, and when the feedback is flushed or destroyed.
+class CostFeedback {
+public:
+    CostFeedback(std::shared_ptr<CostModel> costModel, const std::experimental::filesystem::path &costModelPath,
+            std::chrono::steady_clock::duration saveInterval = std::chrono::seconds(60))
+        : costModel_(costModel),
+        costModelPath_(costModelPath),
+        fitter_(costModel_),
+        saveInterval_(saveInterval),
+        lastSaveTime_(std::chrono::steady_clock::now()),
+        hasUnsavedCoefficients_(false) {}
+
+    ~CostFeedback();
+
+    void recordExecution(const std::experimental::filesystem::path &entryPath, const QueryExecutionStatistics &statistics);
+    void flush();
+
+    // Called after the cost model was recalibrated and saved, so any coefficients fit before then are stale.
+    void reset();
+
+private:
+    void saveLocked();
+
+    std::mutex mutex_;
+    std::shared_ptr<CostModel> costModel_;
+    std::experimental::filesystem::path costModelPath_;
+    OnlineCostModelFitter fitter_;
+    const std::chrono::steady_clock::duration saveInterval_;
+    std::chrono::steady_clock::time_point lastSaveTime_;
+    bool hasUnsavedCoefficients_;
+};
+
+} // namespace tasm
+
+#endif //TASM_COSTFEEDBACK_H
@@ -0,0 +1,93 @@
+#ifndef TASM_COSTMODEL_H
+#define TASM_COSTMODEL_H
+
+#include <experimental/filesystem>
+#include <memory>
+#include <mutex>
+
+namespace tasm {
+struct CostElements;
+
+struct CostCoefficients {
+    // Seconds to decode one pixel and to read one tile.
+    double pixelCostWeight;
+    double tileCostWeight;
+
+    // Seconds to re-encode a GOP as a linear function of the number of pixels in it.
+    double encodePixelCoefficient;
+    double encodePixelIntercept;
+
+    // Only tile a GOP when the tiled layout decodes at most this fraction of the pixels of the untiled layout.
+    double pixelThreshold;
+
+    // Seconds to read one encoded byte and to open one tile file. These default to 0, which ignores I/O.
+    double byteCostWeight;
+    double fileCostWeight;
+};
+
+// The queries that a stored video is expected to serve.
+struct QueryMix {
+    // Queries that read a single frame.
+    unsigned int numberOfPointQueries;
+
+    // Queries that read averageRangeLength consecutive frames.
+    unsigned int numberOfRangeQueries;
+    unsigned int averageRangeLength;
+};
+
+class CostModel {
+public:
+    // The coefficients TASM shipped with. They were fitted on a single machine, so calibrate when possible.
+    static constexpr CostCoefficients DefaultCoefficients{1.608e-06, 1.703e-01, 3.206e-06, 2.592, 0.8, 0, 0};
+
+    CostModel(const CostCoefficients &coefficients = DefaultCoefficients)
+        : coefficients_(coefficients) {}
+
+    CostCoefficients coefficients() const;
+    void setCoefficients(const CostCoefficients &coefficients);
+
+    double pixelThreshold() const;
+
+    // Estimating the bytes that a layout reads requires reading sample tables, so skip it when bytes are free.
+    bool usesByteCosts() const;
+
+    double estimateCostToDecode(const CostElements &costs) const;
+    double estimateCostToRead(const CostElements &costs) const;
+    double estimateCost(const CostElements &costs) const;
+    double estimateCostToEncodeGOP(long long int sizeInPixels) const;
+
+    // Recommends the GOP length that minimizes the cost to encode the video plus the cost to serve the query mix.
+    // Every frame a query reads is decoded from the keyframe of its GOP, which favors short GOPs for point queries.
+    // Every GOP pays the encoder's fixed cost, and each keyframe is keyframeSizeRatio times larger than the
+    // bytesPerInterframe of other frames, which favors long GOPs for scans. Frame sizes only matter when bytes have a cost.
+    unsigned int recommendGOPLength(const QueryMix &queryMix,
+            unsigned int width,
+            unsigned int height,
+            unsigned int numberOfFrames,
+            double bytesPerInterframe = 0,
+            double keyframeSizeRatio = DefaultKeyframeSizeRatio,
+            unsigned int maxGOPLength = MaxRecommendedGOPLength) const;
+
+    static constexpr double DefaultKeyframeSizeRatio = 5;
+    static constexpr unsigned int MaxRecommendedGOPLength = 300;
+
+    // Returns false and leaves the current coefficients alone if the file does not exist.
+    bool load(const std::experimental::filesystem::path &path);
+    void save(const std::experimental::filesystem::path &path) const;
+
+    static std::experimental::filesystem::path pathInCatalog();
+    static std::shared_ptr<CostModel> loadFromCatalog();
+
+    static std::shared_ptr<CostModel> defaultModel() {
+        static auto model = std::make_shared<CostModel>();
+        return model;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    CostCoefficients coefficients_;
+};
+
+} // namespace tasm
+
+#endif //TASM_COSTMODEL_H
@@ -0,0 +1,103 @@
+#ifndef TASM_LAYOUTCACHE_H
+#define TASM_LAYOUTCACHE_H
+
+#include "TileConfigurationProvider.h"
+#include <experimental/filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace tasm {
+class MetadataSelection;
+class SemanticDataManager;
+
+// Layouts that have been computed around one metadata selection, saved in the catalog so that they are only computed
+// once across stores, regret sessions, and processes.
+// Layouts are keyed by (index identity, metadata identifier, label constraints, frame size, GOP length), with one file
+// per key. A file that can't be read is treated as if it had no layouts.
+// New layouts are written when the cache is saved or destroyed. Saving merges with layouts that other caches for the
+// same key saved in the meantime, and drops the cache's layouts instead if the identifier was invalidated since the
+// cache was loaded.
+class PersistentLayoutCache {
+public:
+    PersistentLayoutCache(const std::experimental::filesystem::path &directory,
+            const std::string &indexIdentity,
+            const std::string &metadataIdentifier,
+            const MetadataSelection &metadataSelection,
+            unsigned int width,
+            unsigned int height,
+            unsigned int gopLength);
+
+    ~PersistentLayoutCache();
+
+    PersistentLayoutCache(const PersistentLayoutCache&) = delete;
+    PersistentLayoutCache &operator=(const PersistentLayoutCache&) = delete;
+
+    // Returns nullptr when the GOP's layout has not been computed yet.
+    std::shared_ptr<TileLayout> layoutForGOP(unsigned int gop) const;
+    void addLayoutForGOP(unsigned int gop, std::shared_ptr<TileLayout> layout);
+
+    void save();
+
+    const std::experimental::filesystem::path &path() const { return path_; }
+
+    static std::experimental::filesystem::path directoryInCatalog();
+
+    // Layouts depend on the metadata, so they must be dropped when metadata is added for the identifier.
+    static void invalidate(const std::string &metadataIdentifier,
+            const std::experimental::filesystem::path &directory = directoryInCatalog());
+
+private:
+    void load();
+    void mergeSavedLayouts();
+
+    static unsigned long long loadGeneration(const std::experimental::filesystem::path &identifierDirectory);
+
+    const std::string indexIdentity_;
+    const std::string metadataIdentifier_;
+    const std::string labelConstraints_;
+    const unsigned int width_;
+    const unsigned int height_;
+    const unsigned int gopLength_;
+    const std::experimental::filesystem::path path_;
+
+    mutable std::mutex mutex_;
+    // The number of times the identifier had been invalidated when the layouts were loaded.
+    unsigned long long generation_;
+    std::unordered_map<unsigned int, std::shared_ptr<TileLayout>> gopToLayout_;
+    bool hasUnsavedLayouts_;
+};
+
+// Serves layouts from a persistent cache, asking the base provider only for GOPs that have not been computed before.
+// The base provider must produce one layout per GOP, e.g. a FineGrainedTileConfigurationProvider whose tile layout
+// duration is the GOP length.
+class CachedTileConfigurationProvider : public TileLayoutProvider {
+public:
+    CachedTileConfigurationProvider(std::shared_ptr<TileLayoutProvider> baseLayoutProvider,
+            std::shared_ptr<PersistentLayoutCache> layoutCache,
+            unsigned int gopLength)
+        : baseLayoutProvider_(baseLayoutProvider),
+        layoutCache_(layoutCache),
+        gopLength_(gopLength) {}
+
+    std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override;
+
+    // A FineGrainedTileConfigurationProvider around the semantic data manager's selection whose layouts are cached.
+    // Layouts restricted to a temporal selection, or computed from an index without an identity, such as an in-memory
+    // index, are not cached.
+    static std::shared_ptr<TileLayoutProvider> fineGrainedLayoutProvider(unsigned int gopLength,
+            std::shared_ptr<SemanticDataManager> semanticDataManager,
+            unsigned int frameWidth,
+            unsigned int frameHeight,
+            const std::experimental::filesystem::path &cacheDirectory = PersistentLayoutCache::directoryInCatalog());
+
+private:
+    std::shared_ptr<TileLayoutProvider> baseLayoutProvider_;
+    std::shared_ptr<PersistentLayoutCache> layoutCache_;
+    unsigned int gopLength_;
+};
+
+} // namespace tasm
+
+#endif //TASM_LAYOUTCACHE_H
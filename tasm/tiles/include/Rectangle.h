@@ -2,6 +2,8 @@
 #define TASM_RECTANGLE_H
 
 #include <boost/functional/hash.hpp>
+#include <list>
+#include <vector>
 
 namespace tasm {
 struct Rectangle {
@@ -70,51 +72,32 @@ struct Rectangle {
     }
 };
 
+// Merges overlapping rectangles into the rectangles that bound them, until no two rectangles overlap.
+// A merged rectangle keeps the id of the first of the rectangles it bounds.
 class RectangleMerger {
 public:
-    RectangleMerger(std::unique_ptr<std::list<Rectangle>> rectangles)
-            : rectangles_(std::move(rectangles))
-    {
-        merge();
-    }
+    RectangleMerger(std::vector<Rectangle> rectangles)
+            : rectangles_(mergeRectangles(std::move(rectangles)))
+    {}
 
-    void addRectangle(const Rectangle &other) {
-        auto merged = false;
-        for (auto &rectangle : *rectangles_) {
-            if (rectangle.intersects(other)) {
-                rectangle.expand(other);
-                merged = true;
-            }
-        }
-        if (!merged)
-            rectangles_->push_back(other);
-
-        merge();
-    }
+    RectangleMerger(const std::list<Rectangle> &rectangles)
+            : RectangleMerger(std::vector<Rectangle>(rectangles.begin(), rectangles.end()))
+    {}
 
-    const std::list<Rectangle> &rectangles() const { return *rectangles_; }
+    void addRectangle(const Rectangle &other);
 
-private:
-    void merge() {
-        bool changed = true;
-        while (changed) {
-            changed = false;
-            for (auto it = rectangles_->begin(); it != rectangles_->end(); ++it) {
-                for (auto it2 = std::next(it, 1); it2 != rectangles_->end(); ++it2) {
-                    if (it->intersects(*it2)) {
-                        it->expand(*it2);
-                        rectangles_->erase(it2);
-                        changed = true;
-                        break;
-                    }
-                }
-                if (changed)
-                    break;
-            }
-        }
-    }
+    // Merging a batch at once, e.g. all of a GOP's boxes, is cheaper than adding them one at a time.
+    void addRectangles(const std::vector<Rectangle> &others);
+
+    const std::vector<Rectangle> &rectangles() const { return rectangles_; }
 
-    std::unique_ptr<std::list<Rectangle>> rectangles_;
+    // Sweeps over the rectangles in order of their left edge to find overlapping pairs, and unions them.
+    // Bounding a group can make it overlap rectangles that none of its members overlapped, so this repeats on the
+    // bounding rectangles until nothing overlaps. Each pass takes O(n log n) plus the number of overlapping pairs.
+    static std::vector<Rectangle> mergeRectangles(std::vector<Rectangle> rectangles);
+
+private:
+    std::vector<Rectangle> rectangles_;
 };
 } // namespace tasm
 
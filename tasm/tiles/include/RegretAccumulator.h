@@ -1,48 +1,175 @@
 #ifndef TASM_REGRETACCUMULATOR_H
 #define TASM_REGRETACCUMULATOR_H
 
+#include "CostModel.h"
 #include "TileConfigurationProvider.h"
 #include "WorkloadCostEstimator.h"
+#include <chrono>
+#include <deque>
+#include <experimental/filesystem>
+#include <list>
+#include <mutex>
 #include <unordered_set>
 
 namespace tasm {
 class SemanticIndex;
 
+// Summarizes the queries for one set of objects over one GOP: for each cell of a grid aligned with tile boundaries,
+// the last frame in the GOP where a queried object overlapped the cell.
+// This is enough to estimate what the queries would cost with any layout without keeping their metadata around.
+// When queries read different frames of the GOP, the summary assumes they all read up to the latest of them.
+class GOPQuerySummary {
+public:
+    GOPQuerySummary(unsigned int width, unsigned int height)
+        : numberOfColumns_((width + CellSize - 1) / CellSize),
+        numberOfRows_((height + CellSize - 1) / CellSize),
+        numberOfQueries_(0),
+        baselineCost_(0),
+        lastIteration_(0),
+        framesTouched_(numberOfColumns_ * numberOfRows_, 0) {}
+
+    void addRectangles(unsigned int frameOffsetInGOP, const std::list<Rectangle> &rectangles);
+    void addQueries(unsigned int numberOfQueries, double baselineCost, unsigned int iteration);
+    void merge(const GOPQuerySummary &other);
+
+    CostElements estimateCostForLayout(const TileLayout &layout, unsigned int keyframe, std::shared_ptr<TileSizeEstimator> tileSizeEstimator) const;
+
+    unsigned int numberOfQueries() const { return numberOfQueries_; }
+    double baselineCost() const { return baselineCost_; }
+    unsigned int lastIteration() const { return lastIteration_; }
+    const std::vector<unsigned int> &framesTouched() const { return framesTouched_; }
+    void setFramesTouched(std::vector<unsigned int> framesTouched) { framesTouched_ = std::move(framesTouched); }
+
+    unsigned int sizeInBytes() const { return sizeof(GOPQuerySummary) + framesTouched_.size() * sizeof(unsigned int); }
+
+    static constexpr unsigned int CellSize = FineGrainedTileConfigurationProvider::TileAlignment;
+
+private:
+    unsigned int numberOfColumns_;
+    unsigned int numberOfRows_;
+    unsigned int numberOfQueries_;
+    double baselineCost_;
+    unsigned int lastIteration_;
+
+    // 0 if no object overlapped the cell, otherwise one more than the offset in the GOP of the last frame that did.
+    std::vector<unsigned int> framesTouched_;
+};
+
+struct RetileCandidate {
+    unsigned int gop;
+    double regret;
+    double encodeCost;
+};
+
 class RegretAccumulator {
 public:
     RegretAccumulator(std::shared_ptr<SemanticIndex> semanticIndex, const std::string &metadataIdentifier,
-            unsigned int width, unsigned int height, unsigned int gopLength, double threshold = 1.0)
+            unsigned int width, unsigned int height, unsigned int gopLength, double threshold = 1.0,
+            std::shared_ptr<CostModel> costModel = CostModel::defaultModel(),
+            unsigned long long maxHistoryBytes = DefaultMaxHistoryBytes,
+            unsigned int maxCandidatesPerGOP = DefaultMaxCandidatesPerGOP)
         : semanticIndex_(semanticIndex), metadataIdentifier_(metadataIdentifier),
         width_(width), height_(height), gopLength_(gopLength), threshold_(threshold),
+        costModel_(costModel),
+        maxHistoryBytes_(maxHistoryBytes),
+        maxCandidatesPerGOP_(maxCandidatesPerGOP),
         gopSizeInPixels_(width_ * height_ * gopLength_),
-        gopTilingCost_(estimateCostToEncodeGOP(gopSizeInPixels_)),
         queryIteration_(0),
+        historyBytes_(0),
+        objectBoundsBytes_(0),
         noTilesConfiguration_(new SingleTileConfigurationProvider(width_, height_)) {}
 
-    void addRegretForQuery(std::shared_ptr<Workload> workload, std::shared_ptr<TileLayoutProvider> currentLayout);
+    // Past queries are kept as one GOPQuerySummary per GOP and set of objects.
+    // When the summaries take more than the history's limit, the ones that were queried least recently are dropped.
+    // Dropping a summary keeps the regret it already added, but new candidate layouts are no longer scored against it.
+    static constexpr unsigned long long DefaultMaxHistoryBytes = 64ull << 20;
+
+    // Each query proposes a layout around its own objects and one around the objects that co-occur with them.
+    // Only the candidates with the most regret are tracked for each GOP; a candidate that is not among them for any GOP
+    // is dropped for good.
+    static constexpr unsigned int DefaultMaxCandidatesPerGOP = 8;
+
+    // Evicted candidates are not proposed again until metadata is added for the identifier. Only the most recently
+    // evicted ones are remembered.
+    static constexpr unsigned int MaxEvictedCandidates = 1024;
+
+    // Objects co-occur when at least this fraction of the GOPs that contain either have both in overlapping regions.
+    static constexpr double CoOccurrenceThreshold = 0.5;
+
+    // If tileSizeEstimator is specified, regret also accounts for the bytes that each layout would read.
+    void addRegretForQuery(std::shared_ptr<Workload> workload, std::shared_ptr<TileLayoutProvider> currentLayout,
+            std::shared_ptr<TileSizeEstimator> tileSizeEstimator = nullptr);
     std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<TileLayoutProvider>>> getNewGOPLayouts();
 
+    // The GOPs that have accumulated enough regret to be re-tiled, without resetting their regret.
+    std::vector<RetileCandidate> gopsWorthRetiling() const;
+
+    // Returns the layout to re-tile the GOP with, or nullptr if the GOP no longer has enough regret to be re-tiled.
+    // The GOP keeps its regret until resetRegretForRetiledGOP is called once the re-tile is committed, so a re-tile
+    // that fails is retried.
+    std::shared_ptr<TileLayoutProvider> layoutToRetileGOP(unsigned int gop);
+    void resetRegretForRetiledGOP(unsigned int gop);
+
+    // The identifiers of the layouts that regret is currently accumulated for.
+    std::vector<std::string> candidateLayouts() const;
+
+    const std::string &metadataIdentifier() const { return metadataIdentifier_; }
+
+    // Drops what was derived from the metadata, which must be called when metadata is added for the identifier.
+    void invalidateMetadata();
+
+    // Persist the accumulated regret, the candidate layouts, and summaries of the queries so that retiling
+    // picks up where it left off after a restart.
+    // load returns false and leaves the state alone if the file does not exist, can't be parsed, or was saved for a
+    // different video, in which case the state is rebuilt by later queries.
+    bool load(const std::experimental::filesystem::path &path);
+    void save(const std::experimental::filesystem::path &path) const;
+
+    // Saves if the state changed since it was last saved and saveInterval has passed since then, so that queries
+    // don't each rewrite the file. Regret added since the last save is lost if the process crashes.
+    void saveIfDue(const std::experimental::filesystem::path &path, std::chrono::seconds saveInterval = DefaultSaveInterval);
+    // Saves if the state changed since it was last saved.
+    void saveIfChanged(const std::experimental::filesystem::path &path);
+
+    static constexpr std::chrono::seconds DefaultSaveInterval{30};
+
+    static std::experimental::filesystem::path pathForEntry(const std::experimental::filesystem::path &entryPath);
+
 private:
     bool shouldRetileGOP(unsigned int gop, std::string &layoutIdentifier);
+    double maxRegretForGOP(unsigned int gop, std::string &layoutIdentifier) const;
     void resetRegretForGOP(unsigned int gop);
     std::shared_ptr<TileLayoutProvider> configurationProviderForIdentifier(const std::string &identifier);
 
     void addRegretForHistoricalQueries(const std::vector<std::string> &objects);
+    void addCandidateLayout(const std::string &identifier, const std::vector<std::string> &objects);
+    std::vector<std::string> coOccurringObjects(const std::vector<std::string> &objects);
+    double coOccurrence(const std::string &object, const std::string &otherObject);
+    const std::unordered_map<unsigned int, Rectangle> &boundsByGOPForObject(const std::string &object);
+    void clearObjectBounds();
+    bool isCandidateForGOP(unsigned int gop, const std::string &layoutIdentifier) const;
+    void pruneDominatedCandidates(unsigned int gop);
+    void evictCandidate(const std::string &layoutIdentifier);
+    void rememberEvictedCandidate(const std::string &layoutIdentifier);
     std::shared_ptr<TileLayoutProvider> tileLayoutForObjects(const std::vector<std::string> &objects);
-    bool costsAreForGOPsThatHaveNotBeenRetiled(unsigned int iteration, std::shared_ptr<std::unordered_map<unsigned int, CostElements>> baselineCosts);
     void addRegretForWorkload(
-            unsigned int iteration,
             std::shared_ptr<Workload> workload,
-            std::shared_ptr<std::unordered_map<unsigned int, CostElements>> baselineCosts,
+            const std::unordered_map<unsigned int, CostElements> &baselineCosts,
             const std::vector<std::string> layouts);
+    void addRegretForSummary(unsigned int gop, const GOPQuerySummary &summary, const std::vector<std::string> &layouts);
+    void addQueryToSummaries(const std::string &objects, std::shared_ptr<Workload> workload,
+            const std::unordered_map<unsigned int, CostElements> &baselineCosts);
+    void addSummary(unsigned int gop, const std::string &objects, const GOPQuerySummary &summary);
+    void evictLeastRecentlyQueriedSummaries();
     void addRegretToGOP(unsigned int gop, double regret, const std::string &layoutIdentifier);
-    double estimateCostToEncodeGOP(long long int sizeInPixels) const {
-        static double pixelCoef = 3.206e-06;
-        static double pixelIntercept = 2.592;
-
-        return pixelCoef * gopSizeInPixels_ + pixelIntercept;
-    }
+    double gopTilingCost() const { return costModel_->estimateCostToEncodeGOP(gopSizeInPixels_); }
 
+    // Queries add regret while GOPs are re-tiled in the background.
+    mutable std::mutex mutex_;
+    // Serializes saves so that an older state never replaces a newer one. Taken before mutex_.
+    mutable std::mutex saveMutex_;
+    mutable bool hasUnsavedChanges_ = false;
+    mutable std::chrono::steady_clock::time_point lastSave_ = std::chrono::steady_clock::now();
     std::shared_ptr<SemanticIndex> semanticIndex_;
     const std::string metadataIdentifier_;
 
@@ -51,17 +178,28 @@ private:
     unsigned int gopLength_;
 
     double threshold_;
+    std::shared_ptr<CostModel> costModel_;
+    unsigned long long maxHistoryBytes_;
+    unsigned int maxCandidatesPerGOP_;
+    std::shared_ptr<TileSizeEstimator> tileSizeEstimator_;
     std::vector<std::string> labels_;
+    std::unordered_map<std::string, std::vector<std::string>> idToObjects_;
     std::unordered_map<std::string, std::shared_ptr<TileLayoutProvider>> idToConfig_;
 
     long long int gopSizeInPixels_;
-    double gopTilingCost_;
     std::unordered_map<unsigned int, std::unordered_map<std::string, double>> gopToRegret_;
+    std::unordered_map<unsigned int, std::unordered_set<std::string>> gopToPrunedCandidates_;
+    std::unordered_map<std::string, unsigned int> candidateToNumberOfGOPs_;
+    std::unordered_set<std::string> evictedCandidates_;
+    // In the order they were evicted.
+    std::deque<std::string> evictedCandidateOrder_;
+    std::unordered_map<std::string, std::unordered_map<unsigned int, Rectangle>> objectToBoundsByGOP_;
 
     unsigned int queryIteration_;
-    std::unordered_map<unsigned int, unsigned int> gopToClearedIteration_;
-    std::unordered_map<unsigned int, std::shared_ptr<Workload>> iterationToWorkload_;
-    std::unordered_map<unsigned int, std::shared_ptr<std::unordered_map<unsigned int, CostElements>>> iterationToBaselineCosts_;
+    std::unordered_map<unsigned int, std::unordered_map<std::string, GOPQuerySummary>> gopToSummaries_;
+    // Includes the object bounds, which are dropped before any summary because they can be recomputed.
+    unsigned long long historyBytes_;
+    unsigned long long objectBoundsBytes_;
     std::unordered_set<std::string> allObjects_;
     std::unordered_set<std::string> singleObjects_;
 
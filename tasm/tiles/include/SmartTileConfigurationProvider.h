@@ -1,11 +1,13 @@
 #ifndef TASM_SMARTTILECONFIGURATIONPROVIDER_H
 #define TASM_SMARTTILECONFIGURATIONPROVIDER_H
 
+#include "CostModel.h"
+#include "LayoutCache.h"
 #include "TileConfigurationProvider.h"
 #include "WorkloadCostEstimator.h"
 
 namespace tasm {
-
+class SemanticIndex;
 
 class SmartTileConfigurationProviderSingleSelection : public TileLayoutProvider {
 public:
@@ -13,14 +15,17 @@ public:
             unsigned int tileLayoutDuration,
             std::shared_ptr<SemanticDataManager> semanticDataManager,
             unsigned int frameWidth,
-            unsigned int frameHeight)
-            : fineGrainedLayoutProvider_(new FineGrainedTileConfigurationProvider(tileLayoutDuration, semanticDataManager, frameWidth, frameHeight)),
+            unsigned int frameHeight,
+            std::shared_ptr<CostModel> costModel = CostModel::defaultModel(),
+            std::shared_ptr<TileSizeEstimator> tileSizeEstimator = nullptr)
+            : fineGrainedLayoutProvider_(CachedTileConfigurationProvider::fineGrainedLayoutProvider(tileLayoutDuration, semanticDataManager, frameWidth, frameHeight)),
             singleTileLayoutProvider_(new SingleTileConfigurationProvider(frameWidth, frameHeight)),
             workload_(new Workload(semanticDataManager)),
-            fineGrainedWorkloadCostEstimator_(new WorkloadCostEstimator(fineGrainedLayoutProvider_, workload_, tileLayoutDuration)),
-            untiledWorkloadCostEstimator_(new WorkloadCostEstimator(singleTileLayoutProvider_, workload_, tileLayoutDuration)),
+            fineGrainedWorkloadCostEstimator_(new WorkloadCostEstimator(fineGrainedLayoutProvider_, workload_, tileLayoutDuration, tileSizeEstimator)),
+            untiledWorkloadCostEstimator_(new WorkloadCostEstimator(singleTileLayoutProvider_, workload_, tileLayoutDuration, tileSizeEstimator)),
             fineGrainedLayoutCostByGOP_(new std::unordered_map<unsigned int, CostElements>()),
-            untiledCostByGOP_(new std::unordered_map<unsigned int, CostElements>()) {
+            untiledCostByGOP_(new std::unordered_map<unsigned int, CostElements>()),
+            costModel_(costModel) {
         // TODO: Do this work incrementally rather than in constructor.
         fineGrainedWorkloadCostEstimator_->estimateCostForQuery(0, fineGrainedLayoutCostByGOP_.get());
         untiledWorkloadCostEstimator_->estimateCostForQuery(0, untiledCostByGOP_.get());
@@ -29,17 +34,56 @@ public:
     std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override;
 
 private:
-    std::shared_ptr<FineGrainedTileConfigurationProvider> fineGrainedLayoutProvider_;
+    bool shouldTileGOP(unsigned int gop) const;
+
+    std::shared_ptr<TileLayoutProvider> fineGrainedLayoutProvider_;
     std::shared_ptr<SingleTileConfigurationProvider> singleTileLayoutProvider_;
     std::shared_ptr<Workload> workload_;
     std::shared_ptr<WorkloadCostEstimator> fineGrainedWorkloadCostEstimator_;
     std::shared_ptr<WorkloadCostEstimator> untiledWorkloadCostEstimator_;
 
+    std::mutex mutex_;
     std::unordered_map<unsigned int, std::shared_ptr<TileLayout>> gopToLayout_;
-    constexpr static const double pixelThreshold_ = 0.8;
 
     std::unique_ptr<std::unordered_map<unsigned int, CostElements>> fineGrainedLayoutCostByGOP_;
     std::unique_ptr<std::unordered_map<unsigned int, CostElements>> untiledCostByGOP_;
+    std::shared_ptr<CostModel> costModel_;
+};
+
+// Chooses each GOP's layout to minimize the expected cost of a weighted mix of queries.
+// The candidates are a fine-grained layout around the labels of each query, a fine-grained layout around the union
+// of every query's labels, and no tiles. Each query's cost is weighted by the number of times it is executed.
+class SmartTileConfigurationProviderMultipleSelection : public TileLayoutProvider {
+public:
+    SmartTileConfigurationProviderMultipleSelection(
+            unsigned int tileLayoutDuration,
+            std::shared_ptr<SemanticIndex> semanticIndex,
+            const std::string &metadataIdentifier,
+            std::shared_ptr<Workload> workload,
+            unsigned int frameWidth,
+            unsigned int frameHeight,
+            std::shared_ptr<CostModel> costModel = CostModel::defaultModel(),
+            std::shared_ptr<TileSizeEstimator> tileSizeEstimator = nullptr);
+
+    std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override;
+
+private:
+    void addCandidateForLabels(const std::vector<std::string> &labels);
+    std::shared_ptr<TileLayout> layoutForGOP(unsigned int gop);
+
+    unsigned int tileLayoutDuration_;
+    std::shared_ptr<SemanticIndex> semanticIndex_;
+    std::string metadataIdentifier_;
+    std::shared_ptr<SingleTileConfigurationProvider> singleTileLayoutProvider_;
+    std::unique_ptr<WorkloadCostEstimator> workloadCostEstimator_;
+    std::shared_ptr<CostModel> costModel_;
+    unsigned int frameWidth_;
+    unsigned int frameHeight_;
+
+    std::vector<std::vector<std::string>> candidateLabels_;
+    std::vector<std::shared_ptr<TileLayoutProvider>> candidateLayoutProviders_;
+    std::mutex mutex_;
+    std::unordered_map<unsigned int, std::shared_ptr<TileLayout>> gopToLayout_;
 };
 
 } // namespace tasm
@@ -0,0 +1,59 @@
+#ifndef TASM_STABILIZEDTILECONFIGURATIONPROVIDER_H
+#define TASM_STABILIZEDTILECONFIGURATIONPROVIDER_H
+
+#include "CostModel.h"
+#include "TileConfigurationProvider.h"
+#include "WorkloadCostEstimator.h"
+
+namespace tasm {
+
+// Smooths the per-GOP layouts of another provider so that small changes in the objects' positions do not produce
+// a slightly different layout every GOP. Each new layout changes the encoders' and decoders' configuration, so fewer
+// distinct layouts make both storing and scanning cheaper.
+// For each GOP, the previous GOP's layout is reused if its modeled cost is within the tolerance of the proposed layout's cost.
+// Otherwise the proposed cuts are snapped to nearby cuts of the previous layout, subject to the same tolerance.
+class StabilizedTileConfigurationProvider : public TileLayoutProvider {
+public:
+    StabilizedTileConfigurationProvider(std::shared_ptr<TileLayoutProvider> baseLayoutProvider,
+            std::shared_ptr<Workload> workload,
+            unsigned int gopLength,
+            double tolerance,
+            std::shared_ptr<CostModel> costModel = CostModel::defaultModel(),
+            std::shared_ptr<TileSizeEstimator> tileSizeEstimator = nullptr,
+            unsigned int snapDistance = 64)
+        : baseLayoutProvider_(baseLayoutProvider),
+        costEstimator_(new WorkloadCostEstimator(baseLayoutProvider, workload, gopLength, tileSizeEstimator)),
+        gopLength_(gopLength),
+        tolerance_(tolerance),
+        costModel_(costModel),
+        snapDistance_(snapDistance),
+        nextGOPToStabilize_(0) {
+        assert(tolerance_ >= 0);
+    }
+
+    std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override;
+
+private:
+    std::shared_ptr<TileLayout> stabilizedLayoutForGOP(unsigned int gop);
+    std::shared_ptr<TileLayout> snapToLayout(const TileLayout &layout, const TileLayout &previousLayout) const;
+    std::vector<unsigned int> snapDimensions(const std::vector<unsigned int> &dimensions,
+                                             const std::vector<unsigned int> &previousDimensions,
+                                             unsigned int minimumDimension) const;
+    bool isWithinTolerance(unsigned int gop, const TileLayout &candidate, double proposedCost);
+
+    std::shared_ptr<TileLayoutProvider> baseLayoutProvider_;
+    std::unique_ptr<WorkloadCostEstimator> costEstimator_;
+    unsigned int gopLength_;
+    double tolerance_;
+    std::shared_ptr<CostModel> costModel_;
+    unsigned int snapDistance_;
+
+    // Each GOP's layout depends on the previous GOP's, so GOPs are stabilized in order, one at a time.
+    std::mutex mutex_;
+    unsigned int nextGOPToStabilize_;
+    std::unordered_map<unsigned int, std::shared_ptr<TileLayout>> gopToLayout_;
+};
+
+} // namespace tasm
+
+#endif //TASM_STABILIZEDTILECONFIGURATIONPROVIDER_H
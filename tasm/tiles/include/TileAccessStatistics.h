@@ -0,0 +1,90 @@
+#ifndef TASM_TILEACCESSSTATISTICS_H
+#define TASM_TILEACCESSSTATISTICS_H
+
+#include <chrono>
+#include <experimental/filesystem>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_set>
+
+namespace tasm {
+
+// A tile of a GOP, as stored by one version of the video's layouts.
+struct TileAccess {
+    unsigned int tileVersion;
+    unsigned int gop;
+    unsigned int tile;
+
+    bool operator<(const TileAccess &other) const {
+        return std::tie(tileVersion, gop, tile) < std::tie(other.tileVersion, other.gop, other.tile);
+    }
+};
+
+struct TileAccessCounts {
+    unsigned long long numberOfReads;
+    unsigned long long numberOfBytes;
+};
+
+using TileAccessMap = std::map<TileAccess, TileAccessCounts>;
+
+// Counts the reads of each tile of each GOP of a tiled video, and the bytes they read.
+// Counts are kept in memory and added to a file in the video's catalog entry by flushIfDue at most every
+// flushInterval, and when the statistics are destroyed. Recording a read never touches the file, so reads aren't
+// slowed down by it. Processes that share the entry merge their counts into the file under a file lock.
+class TileAccessStatistics {
+public:
+    TileAccessStatistics(const std::experimental::filesystem::path &entryPath,
+            unsigned int gopLength,
+            std::chrono::seconds flushInterval = DefaultFlushInterval)
+        : path_(entryPath / statistics_filename_),
+        gopLength_(gopLength),
+        flushInterval_(flushInterval),
+        lastFlush_(std::chrono::steady_clock::now()) {}
+
+    ~TileAccessStatistics();
+
+    TileAccessStatistics(const TileAccessStatistics&) = delete;
+    TileAccessStatistics &operator=(const TileAccessStatistics&) = delete;
+
+    // Records one read of frames of the tile, starting at firstFrame, which all belong to one GOP.
+    void recordRead(unsigned int tileVersion, unsigned int tile, unsigned int firstFrame, unsigned long long numberOfBytes);
+
+    // Flushes if flushInterval has passed since the last flush. Called once a query is done reading.
+    void flushIfDue();
+    void flush();
+
+    unsigned int gopLength() const { return gopLength_; }
+
+    // The saved counts plus the counts that have not been flushed yet.
+    TileAccessMap accesses() const;
+
+    static TileAccessMap load(const std::experimental::filesystem::path &entryPath);
+
+    // Drops the saved counts of tile versions whose directories were deleted. Counts that a TileAccessStatistics
+    // has not flushed yet are kept.
+    static void removeVersions(const std::experimental::filesystem::path &entryPath, const std::unordered_set<unsigned int> &tileVersions);
+
+    static constexpr std::chrono::seconds DefaultFlushInterval{30};
+
+private:
+    static void save(const std::experimental::filesystem::path &path, const TileAccessMap &counts);
+    static std::experimental::filesystem::path lockPath(const std::experimental::filesystem::path &path);
+    static TileAccessMap loadFromPath(const std::experimental::filesystem::path &path);
+    static void addCounts(TileAccessMap &counts, const TileAccessMap &countsToAdd);
+
+    static constexpr auto statistics_filename_ = "tile-access-statistics";
+    const std::experimental::filesystem::path path_;
+    const unsigned int gopLength_;
+    const std::chrono::seconds flushInterval_;
+
+    // Serializes flushes so that counts that are being flushed are never missing from accesses().
+    mutable std::mutex flushMutex_;
+    mutable std::mutex mutex_;
+    TileAccessMap unflushedCounts_;
+    std::chrono::steady_clock::time_point lastFlush_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEACCESSSTATISTICS_H
@@ -4,6 +4,7 @@
 #include "Configuration.h"
 #include "Interval.h"
 #include "TileLayout.h"
+#include <mutex>
 
 namespace tasm {
 class SemanticDataManager;
@@ -35,16 +36,13 @@ public:
     UniformTileconfigurationProvider(unsigned int numRows, unsigned int numColumns, Configuration configuration)
         : numRows_(numRows),
         numColumns_(numColumns),
-        configuration_(configuration)
+        configuration_(configuration),
+        layoutPtr(std::make_shared<TileLayout>(numColumns_, numRows_,
+                tile_dimensions(configuration_.codedWidth, configuration_.displayWidth, numColumns_),
+                tile_dimensions(configuration_.codedHeight, configuration_.displayHeight, numRows_)))
     {}
 
     std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override {
-        if (layoutPtr)
-            return layoutPtr;
-
-        layoutPtr = std::make_shared<TileLayout>(numColumns_, numRows_,
-                tile_dimensions(configuration_.codedWidth, configuration_.displayWidth, numColumns_),
-                tile_dimensions(configuration_.codedHeight, configuration_.displayHeight, numRows_));
         return layoutPtr;
     }
 
@@ -83,6 +81,12 @@ public:
 
     std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override;
 
+    static constexpr unsigned int MinimumTileWidth = 256;
+    static constexpr unsigned int MinimumTileHeight = 160;
+
+    // Tile boundaries are placed at multiples of this many pixels from the previous boundary.
+    static constexpr unsigned int TileAlignment = 32;
+
 private:
     std::vector<unsigned int> tileDimensions(const std::vector<interval::Interval<int>> &sortedIntervals, int minDistance, int totalDimension);
 
@@ -90,6 +94,7 @@ private:
     std::shared_ptr<SemanticDataManager> semanticDataManager_;
     unsigned int frameWidth_;
     unsigned int frameHeight_;
+    std::mutex mutex_;
     std::unordered_map<unsigned int, std::shared_ptr<TileLayout>> tileGroupToTileLayout_;
 };
 
@@ -0,0 +1,52 @@
+#ifndef TASM_TILELAYOUTPLANNER_H
+#define TASM_TILELAYOUTPLANNER_H
+
+#include "TileConfigurationProvider.h"
+#include <thread>
+
+namespace tasm {
+
+// Serves layouts that were computed ahead of time, indexed by GOP.
+// Frames in GOPs that were not planned fall back to the provider the plan was computed from.
+class PrecomputedTileConfigurationProvider : public TileLayoutProvider {
+public:
+    PrecomputedTileConfigurationProvider(std::shared_ptr<TileLayoutProvider> baseLayoutProvider,
+            unsigned int gopLength,
+            std::vector<std::shared_ptr<TileLayout>> gopToLayout)
+        : baseLayoutProvider_(baseLayoutProvider),
+        gopLength_(gopLength),
+        gopToLayout_(std::move(gopToLayout)) {}
+
+    std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override {
+        auto gop = frame / gopLength_;
+        if (gop < gopToLayout_.size() && gopToLayout_[gop])
+            return gopToLayout_[gop];
+        return baseLayoutProvider_->tileLayoutForFrame(frame);
+    }
+
+private:
+    std::shared_ptr<TileLayoutProvider> baseLayoutProvider_;
+    unsigned int gopLength_;
+    const std::vector<std::shared_ptr<TileLayout>> gopToLayout_;
+};
+
+// Computes the layouts of many GOPs in parallel before they are needed, so that querying the semantic index and
+// computing the layouts does not stall the encoders at every GOP boundary.
+// The provider must allow concurrent calls to tileLayoutForFrame for different GOPs.
+class TileLayoutPlanner {
+public:
+    TileLayoutPlanner(unsigned int gopLength, unsigned int numberOfThreads = std::thread::hardware_concurrency())
+        : gopLength_(gopLength),
+        numberOfThreads_(std::max(numberOfThreads, 1u)) {}
+
+    std::shared_ptr<PrecomputedTileConfigurationProvider> planForFrames(std::shared_ptr<TileLayoutProvider> layoutProvider, unsigned int numberOfFrames) const;
+    std::shared_ptr<PrecomputedTileConfigurationProvider> planForGOPs(std::shared_ptr<TileLayoutProvider> layoutProvider, const std::vector<unsigned int> &gops) const;
+
+private:
+    unsigned int gopLength_;
+    unsigned int numberOfThreads_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILELAYOUTPLANNER_H
@@ -3,13 +3,14 @@
 
 #include "Files.h"
 #include "TileConfigurationProvider.h"
+#include "TileReaderLease.h"
 #include "TiledVideoManager.h"
 
 namespace tasm {
 
 class TileLocationProvider : public TileLayoutProvider {
 public:
-    virtual std::experimental::filesystem::path locationOfTileForFrame(unsigned int tileNumber, unsigned int frame) const = 0;
+    virtual const std::experimental::filesystem::path &locationOfTileForFrame(unsigned int tileNumber, unsigned int frame) const = 0;
 
     unsigned int frameOffsetInTileFile(const std::experimental::filesystem::path &tilePath) const {
         return TileFiles::firstAndLastFramesFromPath(tilePath.parent_path()).first;
@@ -17,46 +18,42 @@ public:
 
     virtual unsigned int lastFrameWithLayout() const = 0;
 
+    // The last frame at or after the given frame whose tiles are read from the same files with the same layout.
+    virtual unsigned int lastFrameInSameTileFile(unsigned int frame) const = 0;
+
     virtual ~TileLocationProvider() {}
 };
 
 class SingleTileLocationProvider : public TileLocationProvider {
 public:
-    SingleTileLocationProvider(std::shared_ptr<const TiledVideoManager> tileLayoutsManager)
-            : tileLayoutsManager_(tileLayoutsManager)
+    // The lease, if any, is held for as long as the provider is, so the directories it points to aren't deleted.
+    SingleTileLocationProvider(std::shared_ptr<const TiledVideoManager> tileLayoutsManager,
+            std::shared_ptr<const TileReaderLease> tileReaderLease = nullptr)
+            : tileLayoutsManager_(tileLayoutsManager),
+              tileReaderLease_(tileReaderLease)
     { }
 
-    std::experimental::filesystem::path locationOfTileForFrame(unsigned int tileNumber, unsigned int frame) const override {
-        return tileLayoutsManager_->locationOfTileForId(tileNumber, layoutIdForFrame(frame));
+    // Directories and their tile paths are resolved when the tiled video manager loads, so lookups don't lock or allocate.
+    const std::experimental::filesystem::path &locationOfTileForFrame(unsigned int tileNumber, unsigned int frame) const override {
+        return tileLayoutsManager_->locationForFrame(frame).directory->tilePaths.at(tileNumber);
     }
 
     std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override {
-        std::scoped_lock lock(mutex_);
-        return tileLayoutsManager_->tileLayoutForId(layoutIdForFrame(frame));
+        return tileLayoutsManager_->locationForFrame(frame).directory->layout;
     }
 
     unsigned int lastFrameWithLayout() const override {
         return tileLayoutsManager_->maximumFrame();
     }
 
-private:
-    int layoutIdForFrame(unsigned int frame) const {
-        std::scoped_lock lock(mutex_);
-
-        if (frameToLayoutId_.count(frame))
-            return frameToLayoutId_.at(frame);
-
-        auto layoutIds = tileLayoutsManager_->tileLayoutIdsForFrame(frame);
-        // Pick the one with the largest value because it's the most recent layout.
-        auto layoutId = *std::max_element(layoutIds.begin(), layoutIds.end());
-
-        frameToLayoutId_[frame] = layoutId;
-        return layoutId;
+    unsigned int lastFrameInSameTileFile(unsigned int frame) const override {
+        return tileLayoutsManager_->locationForFrame(frame).lastFrameInDirectory;
     }
 
+private:
+
     std::shared_ptr<const TiledVideoManager> tileLayoutsManager_;
-    mutable std::unordered_map<unsigned int, int> frameToLayoutId_;
-    mutable std::recursive_mutex mutex_;
+    std::shared_ptr<const TileReaderLease> tileReaderLease_;
 };
 
 } // namespace tasm
@@ -0,0 +1,76 @@
+#ifndef TASM_TILEMANIFEST_H
+#define TASM_TILEMANIFEST_H
+
+#include "FileLock.h"
+#include "Files.h"
+#include "TileLayout.h"
+#include <experimental/filesystem>
+#include <optional>
+#include <vector>
+
+namespace tasm {
+
+struct TileDirectoryRecord {
+    unsigned int firstFrame;
+    unsigned int lastFrame;
+    unsigned int tileVersion;
+    TileLayout layout;
+};
+
+// The directories of an entry as of one point in time.
+struct TileManifestSnapshot {
+    std::vector<TileDirectoryRecord> directories;
+
+    // The manifest's size and modification time when the directories were read. Every commit and removal changes them.
+    std::uintmax_t size;
+    std::experimental::filesystem::file_time_type writeTime;
+};
+
+// Append-only log of the tile directories that have been committed to and removed from a tiled entry.
+// Loading an entry from its manifest reads one file instead of listing the entry's directories and reading each
+// one's metadata. The manifest is rebuilt from the directories when it is missing or unreadable.
+class TileManifest {
+public:
+    explicit TileManifest(const std::experimental::filesystem::path &entryPath)
+        : entryPath_(entryPath),
+        path_(TileFiles::tileManifestFilename(entryPath)) {}
+
+    // Readers hold the lock shared and writers hold it exclusively, in any process, so a reader never sees a partly
+    // written record and each record is published atomically.
+    std::unique_ptr<FileLock> lock(FileLock::Mode mode) const;
+
+    // Called once the directory's tiles and metadata have been written.
+    void recordCommit(unsigned int firstFrame, unsigned int lastFrame, unsigned int tileVersion, const TileLayout &layout);
+    // For callers that already hold the lock exclusively, e.g. to also write the directory's metadata under it.
+    void recordCommit(unsigned int firstFrame, unsigned int lastFrame, unsigned int tileVersion, const TileLayout &layout, const FileLock &exclusiveLock);
+    void recordRemoval(unsigned int tileVersion);
+
+    // The directories that have been committed and not removed, in order of version.
+    // Returns nothing if the manifest doesn't exist or can't be parsed.
+    std::optional<std::vector<TileDirectoryRecord>> load() const;
+    std::optional<std::vector<TileDirectoryRecord>> load(const FileLock &lock) const;
+
+    // Replaces the manifest with the directories on disk that have tile metadata, and returns them.
+    std::vector<TileDirectoryRecord> rebuild();
+
+    // Loads the directories from the manifest, rebuilding it first if necessary.
+    std::vector<TileDirectoryRecord> loadOrRebuild();
+
+    // Like loadOrRebuild(), along with the state of the manifest the directories were read from.
+    TileManifestSnapshot snapshot();
+
+    const std::experimental::filesystem::path &path() const { return path_; }
+
+private:
+    std::vector<TileDirectoryRecord> rebuild(const FileLock &exclusiveLock);
+    void append(const std::string &record, const FileLock &exclusiveLock);
+    void write(const std::vector<TileDirectoryRecord> &directories, const FileLock &exclusiveLock);
+    TileManifestSnapshot stamp(std::vector<TileDirectoryRecord> directories) const;
+
+    const std::experimental::filesystem::path entryPath_;
+    const std::experimental::filesystem::path path_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEMANIFEST_H
@@ -0,0 +1,30 @@
+#ifndef TASM_TILEREADERLEASE_H
+#define TASM_TILEREADERLEASE_H
+
+#include "FileLock.h"
+#include <experimental/filesystem>
+#include <memory>
+
+namespace tasm {
+
+// Held while tile files of an entry may be read, e.g. for the lifetime of a query's scan.
+// Tile directories that newer versions have replaced are only deleted while nothing, in any process, holds a lease
+// on the entry. A reader must take its lease before loading the entry's tile directories.
+class TileReaderLease {
+public:
+    // Only waits while a collection is deleting directories.
+    explicit TileReaderLease(const std::experimental::filesystem::path &entryPath);
+
+    // Returns a lease that excludes every reader, or nullptr if a reader currently holds a lease.
+    static std::unique_ptr<TileReaderLease> tryAcquireExclusive(const std::experimental::filesystem::path &entryPath);
+
+private:
+    explicit TileReaderLease(std::unique_ptr<FileLock> lock)
+        : lock_(std::move(lock)) {}
+
+    std::unique_ptr<FileLock> lock_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEREADERLEASE_H
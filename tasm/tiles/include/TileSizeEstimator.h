@@ -0,0 +1,51 @@
+#ifndef TASM_TILESIZEESTIMATOR_H
+#define TASM_TILESIZEESTIMATOR_H
+
+#include "TileLayout.h"
+#include <experimental/filesystem>
+#include <mutex>
+#include <unordered_map>
+
+namespace tasm {
+class TiledVideoManager;
+
+// Estimates how many encoded bytes have to be read to decode a region of the frame.
+// The estimate comes from the sample tables of the tiles that are already stored: a stored tile's bytes are
+// attributed to the region in proportion to how much of the tile the region covers.
+// For a region that matches a stored tile exactly, this is the tile's actual size on disk.
+class TileSizeEstimator {
+public:
+    // Estimate sizes from the tiles stored in the catalog, using the most recent layout for each frame.
+    TileSizeEstimator(std::shared_ptr<const TiledVideoManager> tiledVideoManager)
+        : tiledVideoManager_(tiledVideoManager) {}
+
+    // Estimate sizes from an untiled video that has not been stored yet.
+    TileSizeEstimator(const std::experimental::filesystem::path &untiledVideo, unsigned int width, unsigned int height)
+        : untiledVideo_(untiledVideo),
+        untiledLayout_(std::make_shared<TileLayout>(1, 1, std::vector<unsigned int>{width}, std::vector<unsigned int>{height})) {}
+
+    unsigned long long estimateBytesForRegion(const Rectangle &region, unsigned int firstFrame, unsigned int lastFrameInclusive);
+
+private:
+    struct StoredLayout {
+        int id;
+        std::shared_ptr<TileLayout> layout;
+        unsigned int firstFrame;
+    };
+
+    const StoredLayout &storedLayoutForFrame(unsigned int frame);
+    std::experimental::filesystem::path locationOfTile(const StoredLayout &storedLayout, unsigned int tile) const;
+    const std::vector<unsigned int> &sampleSizesForTile(const std::experimental::filesystem::path &tilePath);
+
+    std::shared_ptr<const TiledVideoManager> tiledVideoManager_;
+    std::experimental::filesystem::path untiledVideo_;
+    std::shared_ptr<TileLayout> untiledLayout_;
+
+    std::mutex mutex_;
+    std::unordered_map<unsigned int, StoredLayout> frameToStoredLayout_;
+    std::unordered_map<std::string, std::vector<unsigned int>> tilePathToSampleSizes_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILESIZEESTIMATOR_H
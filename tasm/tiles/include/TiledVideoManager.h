@@ -1,7 +1,7 @@
 #ifndef TASM_TILEDVIDEOMANAGER_H
 #define TASM_TILEDVIDEOMANAGER_H
 
-#include "IntervalTree.h"
+#include "LatestIntervalIndex.h"
 #include "TileLayout.h"
 #include "Video.h"
 #include <mutex>
@@ -9,20 +9,50 @@
 namespace tasm {
 class TiledVideoManager {
 public:
+    // Frames [first, last] that are read from the directory with the layout id.
+    using TileLayoutRun = LatestIntervalIndex<unsigned int>::Segment;
+
+    struct TileDirectory {
+        int id;
+        std::shared_ptr<TileLayout> layout;
+        std::experimental::filesystem::path path;
+        std::vector<std::experimental::filesystem::path> tilePaths;
+    };
+
+    // Where a frame's tiles are read from, and the last frame that is read from the same directory after it.
+    struct FrameLocation {
+        const TileDirectory *directory;
+        unsigned int lastFrameInDirectory;
+    };
+
     TiledVideoManager(std::shared_ptr<TiledEntry> entry)
             : entry_(entry),
+              framesPerLocation_(1),
               totalWidth_(0),
               totalHeight_(0),
               largestWidth_(0),
               largestHeight_(0),
-              maximumFrame_(0) {
+              maximumFrame_(0),
+              manifestSize_(0) {
         loadAllTileConfigurations();
     }
 
     std::shared_ptr<TiledEntry> entry() const { return entry_; }
-    std::vector<int> tileLayoutIdsForFrame(unsigned int frameNumber) const;
+    // The id of the most recent layout that covers the frame.
+    int tileLayoutIdForFrame(unsigned int frameNumber) const;
+    // Lock-free and allocation-free. The frame must have a layout.
+    const FrameLocation &locationForFrame(unsigned int frameNumber) const {
+        assert(frameNumber / framesPerLocation_ < frameLocations_.size());
+        auto &location = frameLocations_[frameNumber / framesPerLocation_];
+        assert(location.directory);
+        return location;
+    }
+    // The most recent layouts that cover frames [firstFrame, lastFrameExclusive), in frame order.
+    std::vector<TileLayoutRun> tileLayoutRunsForFrames(unsigned int firstFrame, unsigned int lastFrameExclusive) const;
     std::shared_ptr<TileLayout> tileLayoutForId(int id) const { return directoryIdToTileLayout_.at(id); }
     std::experimental::filesystem::path locationOfTileForId(unsigned int tileNumber, int id) const;
+    std::experimental::filesystem::path directoryForId(int id) const;
+    std::vector<int> tileLayoutIds() const;
 
     unsigned int totalWidth() const { return totalWidth_; }
     unsigned int totalHeight() const { return totalHeight_; }
@@ -30,10 +60,22 @@ public:
     unsigned int largestHeight() const { return largestHeight_; }
     unsigned int maximumFrame() const { return maximumFrame_; }
 
+    // False once a directory has been committed to or removed from the entry since it was loaded, by any process.
+    bool isCurrent() const;
+
 private:
     void loadAllTileConfigurations();
+    void buildFrameLocations();
     std::shared_ptr<TiledEntry> entry_;
-    IntervalTree<unsigned int> intervalTree_;
+    // Not modified after loading, so it is read without taking the mutex.
+    LatestIntervalIndex<unsigned int> layoutIndex_;
+
+    // Like layoutIndex_, also not modified after loading.
+    // Every run of frames with the same layout starts and ends on a multiple of framesPerLocation_, which is usually
+    // the GOP length, so frameLocations_ has one entry per framesPerLocation_ frames.
+    std::vector<TileDirectory> directories_;
+    unsigned int framesPerLocation_;
+    std::vector<FrameLocation> frameLocations_;
 
 public: // For sake of measuring.
     std::unordered_map<int, std::experimental::filesystem::path> directoryIdToTileDirectory_;
@@ -48,6 +90,10 @@ private:
     unsigned int largestWidth_;
     unsigned int largestHeight_;
     unsigned int maximumFrame_;
+
+    // Every commit and removal changes the size and modification time of the entry's manifest.
+    std::uintmax_t manifestSize_;
+    std::experimental::filesystem::file_time_type manifestWriteTime_;
 };
 
 } // namespace tasm
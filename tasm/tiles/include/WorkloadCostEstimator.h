@@ -2,6 +2,7 @@
 #define TASM_WORKLOADCOSTESTIMATOR_H
 
 #include "TileConfigurationProvider.h"
+#include "TileSizeEstimator.h"
 
 namespace tasm {
 class SemanticDataManager;
@@ -36,17 +37,25 @@ private:
 };
 
 struct CostElements {
-    CostElements(unsigned long long numPixels, unsigned long long numTiles):
+    CostElements(unsigned long long numPixels, unsigned long long numTiles, unsigned long long numBytes = 0, unsigned long long numFiles = 0):
             numPixels(numPixels),
-            numTiles(numTiles) {}
+            numTiles(numTiles),
+            numBytes(numBytes),
+            numFiles(numFiles) {}
 
     void add(const CostElements &other) {
         numPixels += other.numPixels;
         numTiles += other.numTiles;
+        numBytes += other.numBytes;
+        numFiles += other.numFiles;
     }
 
     unsigned long long numPixels;
     unsigned long long numTiles;
+
+    // Encoded bytes read and tile files opened. numBytes is only estimated when a TileSizeEstimator is available.
+    unsigned long long numBytes;
+    unsigned long long numFiles;
 };
 
 std::ostream &operator<<(std::ostream &ostr, const CostElements &c);
@@ -55,16 +64,21 @@ class WorkloadCostEstimator {
 public:
     WorkloadCostEstimator(std::shared_ptr<TileLayoutProvider> tileLayoutProvider,
             std::shared_ptr<Workload> workload,
-            unsigned int gopLength)
+            unsigned int gopLength,
+            std::shared_ptr<TileSizeEstimator> tileSizeEstimator = nullptr)
             : tileLayoutProvider_(tileLayoutProvider),
             workload_(workload),
             gopLength_(gopLength),
+            tileSizeEstimator_(tileSizeEstimator),
             totalNumberOfPixels_(0),
             totalNumberOfTiles_(0) {}
 
     CostElements estimateCostForQuery(unsigned int queryNum, std::unordered_map<unsigned int, CostElements> *costByGOP = nullptr);
     CostElements estimateCostForWorkload();
 
+    // Estimates the cost of the whole workload over a single GOP if that GOP were stored with the specified layout.
+    CostElements estimateCostForGOP(unsigned int gop, const TileLayout &layout);
+
     unsigned int gopForFrame(unsigned int frameNum) const {
         return frameNum / gopLength_;
     }
@@ -76,10 +90,15 @@ private:
     std::pair<int, CostElements> estimateCostForNextGOP(std::vector<int>::const_iterator &start,
                                                         std::vector<int>::const_iterator end,
                                                         std::shared_ptr<SemanticDataManager> metadataManager);
+    CostElements estimateCostForFramesInGOP(std::vector<int>::const_iterator &currentFrame,
+                                            std::vector<int>::const_iterator end,
+                                            const TileLayout &layout,
+                                            std::shared_ptr<SemanticDataManager> metadataManager);
 
     std::shared_ptr<TileLayoutProvider> tileLayoutProvider_;
     std::shared_ptr<Workload> workload_;
     unsigned int gopLength_;
+    std::shared_ptr<TileSizeEstimator> tileSizeEstimator_;
     unsigned int totalNumberOfPixels_;
     unsigned int totalNumberOfTiles_;
 };
@@ -0,0 +1,150 @@
+#include "CostFeedback.h"
+
+#include "FileLock.h"
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+namespace tasm {
+
+static void writeRecord(std::ostream &output, const QueryExecutionStatistics &statistics) {
+    output << statistics.costs.numPixels << " "
+           << statistics.costs.numTiles << " "
+           << statistics.costs.numBytes << " "
+           << statistics.costs.numFiles << " "
+           << statistics.readSeconds << " "
+           << statistics.decodeSeconds << "\n";
+}
+
+void QueryStatisticsStore::record(const QueryExecutionStatistics &statistics) {
+    FileLock lock(lockPath_, FileLock::Mode::Exclusive);
+
+    std::ostringstream record;
+    writeRecord(record, statistics);
+    auto recordText = record.str();
+    {
+        std::ofstream output(path_, std::ios::out | std::ios::app);
+        output << recordText;
+    }
+
+    // Records are about the same size, so the file size tells roughly how many it holds without reading it.
+    if (std::experimental::filesystem::file_size(path_) > 2 * static_cast<uintmax_t>(maxNumberOfRecords_) * recordText.size())
+        compactLocked();
+}
+
+void QueryStatisticsStore::compactLocked() const {
+    static std::atomic<unsigned int> compactionCount(0);
+    auto records = loadLocked(maxNumberOfRecords_);
+    auto temporaryPath = path_;
+    temporaryPath += ".tmp" + std::to_string(getpid()) + "-" + std::to_string(compactionCount++);
+    {
+        std::ofstream output(temporaryPath, std::ios::out | std::ios::trunc);
+        for (const auto &record : records)
+            writeRecord(output, record);
+        if (!output)
+            throw std::runtime_error("Failed to write query statistics to " + temporaryPath.string());
+    }
+    std::experimental::filesystem::rename(temporaryPath, path_);
+}
+
+std::vector<QueryExecutionStatistics> QueryStatisticsStore::load(unsigned int maxNumberOfRecords) const {
+    FileLock lock(lockPath_, FileLock::Mode::Shared);
+    return loadLocked(maxNumberOfRecords);
+}
+
+std::vector<QueryExecutionStatistics> QueryStatisticsStore::loadLocked(unsigned int maxNumberOfRecords) const {
+    std::deque<QueryExecutionStatistics> records;
+    std::ifstream input(path_);
+    unsigned long long numPixels, numTiles, numBytes, numFiles;
+    double readSeconds, decodeSeconds;
+    while (input >> numPixels >> numTiles >> numBytes >> numFiles >> readSeconds >> decodeSeconds) {
+        records.push_back({CostElements(numPixels, numTiles, numBytes, numFiles), readSeconds, decodeSeconds});
+        if (records.size() > maxNumberOfRecords)
+            records.pop_front();
+    }
+    return {records.begin(), records.end()};
+}
+
+void OnlineCostModelFitter::RecursiveLeastSquares::update(double x0, double x1, double y, double forgettingFactor) {
+    double px0 = covariance[0][0] * x0 + covariance[0][1] * x1;
+    double px1 = covariance[1][0] * x0 + covariance[1][1] * x1;
+    double denominator = forgettingFactor + x0 * px0 + x1 * px1;
+    double gain0 = px0 / denominator;
+    double gain1 = px1 / denominator;
+
+    double error = y - (weights[0] * x0 + weights[1] * x1);
+    weights[0] = std::max(weights[0] + gain0 * error, 0.0);
+    weights[1] = std::max(weights[1] + gain1 * error, 0.0);
+
+    // P = (P - k * x^T * P) / lambda. P is symmetric, so x^T * P = (P * x)^T.
+    covariance[0][0] = (covariance[0][0] - gain0 * px0) / forgettingFactor;
+    covariance[0][1] = (covariance[0][1] - gain0 * px1) / forgettingFactor;
+    covariance[1][0] = (covariance[1][0] - gain1 * px0) / forgettingFactor;
+    covariance[1][1] = (covariance[1][1] - gain1 * px1) / forgettingFactor;
+}
+
+void OnlineCostModelFitter::reset() {
+    std::scoped_lock lock(mutex_);
+
+    auto coefficients = costModel_->coefficients();
+    decodeFit_ = {{coefficients.pixelCostWeight * PixelScale, coefficients.tileCostWeight}};
+    readFit_ = {{coefficients.byteCostWeight * ByteScale, coefficients.fileCostWeight}};
+}
+
+void OnlineCostModelFitter::addObservation(const QueryExecutionStatistics &statistics) {
+    std::scoped_lock lock(mutex_);
+
+    auto &costs = statistics.costs;
+    if (costs.numPixels || costs.numTiles)
+        decodeFit_.update(costs.numPixels / PixelScale, costs.numTiles, statistics.decodeSeconds, forgettingFactor_);
+    if (costs.numBytes || costs.numFiles)
+        readFit_.update(costs.numBytes / ByteScale, costs.numFiles, statistics.readSeconds, forgettingFactor_);
+
+    auto coefficients = costModel_->coefficients();
+    coefficients.pixelCostWeight = decodeFit_.weights[0] / PixelScale;
+    coefficients.tileCostWeight = decodeFit_.weights[1];
+    coefficients.byteCostWeight = readFit_.weights[0] / ByteScale;
+    coefficients.fileCostWeight = readFit_.weights[1];
+    costModel_->setCoefficients(coefficients);
+}
+
+CostFeedback::~CostFeedback() {
+    try {
+        flush();
+    } catch (const std::exception &e) {
+        std::cerr << "Failed to save the cost model: " << e.what() << std::endl;
+    }
+}
+
+void CostFeedback::recordExecution(const std::experimental::filesystem::path &entryPath, const QueryExecutionStatistics &statistics) {
+    std::scoped_lock lock(mutex_);
+
+    QueryStatisticsStore(entryPath).record(statistics);
+    fitter_.addObservation(statistics);
+    hasUnsavedCoefficients_ = true;
+    if (std::chrono::steady_clock::now() - lastSaveTime_ >= saveInterval_)
+        saveLocked();
+}
+
+void CostFeedback::flush() {
+    std::scoped_lock lock(mutex_);
+    if (hasUnsavedCoefficients_)
+        saveLocked();
+}
+
+void CostFeedback::reset() {
+    std::scoped_lock lock(mutex_);
+    fitter_.reset();
+    hasUnsavedCoefficients_ = false;
+}
+
+void CostFeedback::saveLocked() {
+    costModel_->save(costModelPath_);
+    lastSaveTime_ = std::chrono::steady_clock::now();
+    hasUnsavedCoefficients_ = false;
+}
+
+} // namespace tasm
@@ -0,0 +1,145 @@
+#include "CostModel.h"
+
+#include "CostModel.pb.h"
+#include "EnvironmentConfiguration.h"
+#include "WorkloadCostEstimator.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace tasm {
+
+static auto constexpr COST_MODEL_VERSION = 1u;
+static auto constexpr COST_MODEL_FILENAME = "cost-model.bin";
+
+constexpr CostCoefficients CostModel::DefaultCoefficients;
+constexpr double CostModel::DefaultKeyframeSizeRatio;
+constexpr unsigned int CostModel::MaxRecommendedGOPLength;
+
+CostCoefficients CostModel::coefficients() const {
+    std::scoped_lock lock(mutex_);
+    return coefficients_;
+}
+
+void CostModel::setCoefficients(const CostCoefficients &coefficients) {
+    std::scoped_lock lock(mutex_);
+    coefficients_ = coefficients;
+}
+
+double CostModel::pixelThreshold() const {
+    std::scoped_lock lock(mutex_);
+    return coefficients_.pixelThreshold;
+}
+
+bool CostModel::usesByteCosts() const {
+    std::scoped_lock lock(mutex_);
+    return coefficients_.byteCostWeight > 0;
+}
+
+double CostModel::estimateCostToDecode(const CostElements &costs) const {
+    std::scoped_lock lock(mutex_);
+    return coefficients_.pixelCostWeight * costs.numPixels + coefficients_.tileCostWeight * costs.numTiles;
+}
+
+double CostModel::estimateCostToRead(const CostElements &costs) const {
+    std::scoped_lock lock(mutex_);
+    return coefficients_.byteCostWeight * costs.numBytes + coefficients_.fileCostWeight * costs.numFiles;
+}
+
+double CostModel::estimateCost(const CostElements &costs) const {
+    return estimateCostToDecode(costs) + estimateCostToRead(costs);
+}
+
+double CostModel::estimateCostToEncodeGOP(long long int sizeInPixels) const {
+    std::scoped_lock lock(mutex_);
+    return coefficients_.encodePixelCoefficient * sizeInPixels + coefficients_.encodePixelIntercept;
+}
+
+unsigned int CostModel::recommendGOPLength(const QueryMix &queryMix,
+                                           unsigned int width,
+                                           unsigned int height,
+                                           unsigned int numberOfFrames,
+                                           double bytesPerInterframe,
+                                           double keyframeSizeRatio,
+                                           unsigned int maxGOPLength) const {
+    auto frameSizeInPixels = static_cast<long long int>(width) * height;
+    auto costToDecodeFrame = estimateCostToDecode(CostElements(frameSizeInPixels, 1));
+    auto costToReadFrame = estimateCostToRead(CostElements(0, 0, static_cast<unsigned long long>(bytesPerInterframe), 0));
+    auto keyframeOverhead = keyframeSizeRatio - 1;
+
+    auto bestGOPLength = 1u;
+    auto lowestCost = std::numeric_limits<double>::max();
+    for (auto gopLength = 1u; gopLength <= std::max(maxGOPLength, 1u); ++gopLength) {
+        // On average, a point query decodes half of a GOP, and a range query decodes half of a GOP before its first frame.
+        double framesDecodedPerPointQuery = (gopLength + 1) / 2.0;
+        double framesDecodedPerRangeQuery = queryMix.averageRangeLength + (gopLength - 1) / 2.0;
+        double keyframesReadPerRangeQuery = 1 + static_cast<double>(std::max(queryMix.averageRangeLength, 1u) - 1) / gopLength;
+
+        auto numberOfGOPs = (numberOfFrames + gopLength - 1) / gopLength;
+        auto cost = numberOfGOPs * estimateCostToEncodeGOP(frameSizeInPixels * gopLength)
+                + queryMix.numberOfPointQueries * (framesDecodedPerPointQuery * (costToDecodeFrame + costToReadFrame) + keyframeOverhead * costToReadFrame)
+                + queryMix.numberOfRangeQueries * (framesDecodedPerRangeQuery * (costToDecodeFrame + costToReadFrame) + keyframesReadPerRangeQuery * keyframeOverhead * costToReadFrame);
+        if (cost < lowestCost) {
+            lowestCost = cost;
+            bestGOPLength = gopLength;
+        }
+    }
+    return bestGOPLength;
+}
+
+bool CostModel::load(const std::experimental::filesystem::path &path) {
+    if (!std::experimental::filesystem::exists(path))
+        return false;
+
+    lightdb::serialization::CostModel serialized;
+    std::fstream input(path, std::ios::in | std::ios::binary);
+    if (!serialized.ParseFromIstream(&input))
+        throw std::runtime_error("Failed to read cost model from " + path.string());
+
+    setCoefficients({
+        serialized.pixelcostweight(),
+        serialized.tilecostweight(),
+        serialized.encodepixelcoefficient(),
+        serialized.encodepixelintercept(),
+        serialized.pixelthreshold(),
+        serialized.bytecostweight(),
+        serialized.filecostweight()});
+    return true;
+}
+
+void CostModel::save(const std::experimental::filesystem::path &path) const {
+    auto current = coefficients();
+
+    lightdb::serialization::CostModel serialized;
+    serialized.set_version(COST_MODEL_VERSION);
+    serialized.set_pixelcostweight(current.pixelCostWeight);
+    serialized.set_tilecostweight(current.tileCostWeight);
+    serialized.set_encodepixelcoefficient(current.encodePixelCoefficient);
+    serialized.set_encodepixelintercept(current.encodePixelIntercept);
+    serialized.set_pixelthreshold(current.pixelThreshold);
+    serialized.set_bytecostweight(current.byteCostWeight);
+    serialized.set_filecostweight(current.fileCostWeight);
+
+    std::fstream output(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!serialized.SerializeToOstream(&output))
+        throw std::runtime_error("Failed to write cost model to " + path.string());
+}
+
+std::experimental::filesystem::path CostModel::pathInCatalog() {
+    return EnvironmentConfiguration::instance().catalogPath() / COST_MODEL_FILENAME;
+}
+
+std::shared_ptr<CostModel> CostModel::loadFromCatalog() {
+    auto model = std::make_shared<CostModel>();
+    try {
+        model->load(pathInCatalog());
+    } catch (const std::exception &e) {
+        // A damaged model must not keep TASM from starting. It is overwritten by the next calibration or refit.
+        std::cerr << e.what() << "; using the default cost model" << std::endl;
+        model->setCoefficients(DefaultCoefficients);
+    }
+    return model;
+}
+
+} // namespace tasm
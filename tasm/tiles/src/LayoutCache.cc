@@ -0,0 +1,234 @@
+#include "LayoutCache.h"
+
+#include "EnvironmentConfiguration.h"
+#include "FileLock.h"
+#include "LayoutCache.pb.h"
+#include "SemanticDataManager.h"
+#include "SemanticSelection.h"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+namespace tasm {
+
+static auto constexpr LAYOUT_CACHE_VERSION = 2u;
+static auto constexpr LAYOUT_CACHE_DIRECTORY = "layout-cache";
+static auto constexpr GENERATION_FILENAME = "generation";
+static auto constexpr GENERATION_LOCK_FILENAME = "generation.lock";
+
+static std::string hashedName(const std::string &key) {
+    std::stringstream name;
+    name << std::hex << std::hash<std::string>()(key);
+    return name.str();
+}
+
+// Layouts of each metadata identifier share a directory so that they can be invalidated together.
+static std::experimental::filesystem::path directoryForMetadataIdentifier(const std::experimental::filesystem::path &directory, const std::string &metadataIdentifier) {
+    return directory / hashedName(metadataIdentifier);
+}
+
+PersistentLayoutCache::PersistentLayoutCache(const std::experimental::filesystem::path &directory,
+        const std::string &indexIdentity,
+        const std::string &metadataIdentifier,
+        const MetadataSelection &metadataSelection,
+        unsigned int width,
+        unsigned int height,
+        unsigned int gopLength)
+    : indexIdentity_(indexIdentity),
+    metadataIdentifier_(metadataIdentifier),
+    labelConstraints_(metadataSelection.labelConstraints()),
+    width_(width),
+    height_(height),
+    gopLength_(gopLength),
+    path_(directoryForMetadataIdentifier(directory, metadataIdentifier_)
+            / (hashedName(indexIdentity_ + '\0' + labelConstraints_ + '\0' + std::to_string(width_) + 'x' + std::to_string(height_) + '/' + std::to_string(gopLength_)) + ".bin")),
+    generation_(0),
+    hasUnsavedLayouts_(false) {
+    load();
+}
+
+PersistentLayoutCache::~PersistentLayoutCache() {
+    try {
+        save();
+    } catch (const std::exception &e) {
+        std::cout << "Failed to save layout cache " << path_ << ": " << e.what() << std::endl;
+    }
+}
+
+std::shared_ptr<TileLayout> PersistentLayoutCache::layoutForGOP(unsigned int gop) const {
+    std::scoped_lock lock(mutex_);
+    auto layout = gopToLayout_.find(gop);
+    return layout != gopToLayout_.end() ? layout->second : nullptr;
+}
+
+void PersistentLayoutCache::addLayoutForGOP(unsigned int gop, std::shared_ptr<TileLayout> layout) {
+    std::scoped_lock lock(mutex_);
+    if (gopToLayout_.emplace(gop, layout).second)
+        hasUnsavedLayouts_ = true;
+}
+
+void PersistentLayoutCache::load() {
+    std::scoped_lock lock(mutex_);
+    auto identifierDirectory = path_.parent_path();
+    std::experimental::filesystem::create_directories(identifierDirectory);
+    FileLock generationLock(identifierDirectory / GENERATION_LOCK_FILENAME, FileLock::Mode::Shared);
+    generation_ = loadGeneration(identifierDirectory);
+    mergeSavedLayouts();
+}
+
+unsigned long long PersistentLayoutCache::loadGeneration(const std::experimental::filesystem::path &identifierDirectory) {
+    std::ifstream input(identifierDirectory / GENERATION_FILENAME);
+    unsigned long long generation = 0;
+    input >> generation;
+    return generation;
+}
+
+void PersistentLayoutCache::mergeSavedLayouts() {
+    if (!std::experimental::filesystem::exists(path_))
+        return;
+
+    lightdb::serialization::LayoutCache serialized;
+    std::fstream input(path_, std::ios::in | std::ios::binary);
+    if (!serialized.ParseFromIstream(&input)) {
+        // The layouts can be computed again, and the next save rewrites the file.
+        std::cerr << "Ignoring unreadable layout cache " << path_ << std::endl;
+        std::error_code error;
+        std::experimental::filesystem::remove(path_, error);
+        return;
+    }
+
+    // The file name is a hash of the key, so make sure that the file really is for this key.
+    if (serialized.version() != LAYOUT_CACHE_VERSION
+            || serialized.indexidentity() != indexIdentity_
+            || serialized.metadataidentifier() != metadataIdentifier_
+            || serialized.labelconstraints() != labelConstraints_
+            || serialized.width() != width_
+            || serialized.height() != height_
+            || serialized.goplength() != gopLength_)
+        return;
+
+    for (const auto &cachedLayout : serialized.layouts()) {
+        if (gopToLayout_.count(cachedLayout.gop()))
+            continue;
+
+        std::vector<unsigned int> widths(cachedLayout.widthsofcolumns().begin(), cachedLayout.widthsofcolumns().end());
+        std::vector<unsigned int> heights(cachedLayout.heightsofrows().begin(), cachedLayout.heightsofrows().end());
+        gopToLayout_[cachedLayout.gop()] = std::make_shared<TileLayout>(widths.size(), heights.size(), widths, heights);
+    }
+}
+
+void PersistentLayoutCache::save() {
+    std::scoped_lock lock(mutex_);
+    if (!hasUnsavedLayouts_)
+        return;
+
+    // Invalidation waits for saves, so no layout from before it can be written after it.
+    auto identifierDirectory = path_.parent_path();
+    std::experimental::filesystem::create_directories(identifierDirectory);
+    FileLock generationLock(identifierDirectory / GENERATION_LOCK_FILENAME, FileLock::Mode::Exclusive);
+    auto generation = loadGeneration(identifierDirectory);
+    if (generation != generation_) {
+        gopToLayout_.clear();
+        generation_ = generation;
+        hasUnsavedLayouts_ = false;
+        return;
+    }
+
+    // Another cache for the same key may have saved layouts since this one was loaded.
+    mergeSavedLayouts();
+
+    lightdb::serialization::LayoutCache serialized;
+    serialized.set_version(LAYOUT_CACHE_VERSION);
+    serialized.set_indexidentity(indexIdentity_);
+    serialized.set_metadataidentifier(metadataIdentifier_);
+    serialized.set_labelconstraints(labelConstraints_);
+    serialized.set_width(width_);
+    serialized.set_height(height_);
+    serialized.set_goplength(gopLength_);
+    for (const auto &gopAndLayout : gopToLayout_) {
+        auto *cachedLayout = serialized.add_layouts();
+        cachedLayout->set_gop(gopAndLayout.first);
+        for (auto width : gopAndLayout.second->widthsOfColumns())
+            cachedLayout->add_widthsofcolumns(width);
+        for (auto height : gopAndLayout.second->heightsOfRows())
+            cachedLayout->add_heightsofrows(height);
+    }
+
+    // Each save writes its own temporary file and renames it into place, so concurrent saves never interleave.
+    static std::atomic<unsigned int> saveCount(0);
+    std::experimental::filesystem::create_directories(path_.parent_path());
+    auto temporaryPath = path_;
+    temporaryPath += ".tmp" + std::to_string(getpid()) + "-" + std::to_string(saveCount++);
+    {
+        std::fstream output(temporaryPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!serialized.SerializeToOstream(&output))
+            throw std::runtime_error("Failed to write layout cache to " + temporaryPath.string());
+    }
+    std::experimental::filesystem::rename(temporaryPath, path_);
+    hasUnsavedLayouts_ = false;
+}
+
+std::experimental::filesystem::path PersistentLayoutCache::directoryInCatalog() {
+    return EnvironmentConfiguration::instance().catalogPath() / LAYOUT_CACHE_DIRECTORY;
+}
+
+void PersistentLayoutCache::invalidate(const std::string &metadataIdentifier, const std::experimental::filesystem::path &directory) {
+    // Caches that are still open hold layouts from before the invalidation, so the directory is kept with a new
+    // generation that tells them not to save those layouts.
+    auto identifierDirectory = directoryForMetadataIdentifier(directory, metadataIdentifier);
+    std::experimental::filesystem::create_directories(identifierDirectory);
+    FileLock generationLock(identifierDirectory / GENERATION_LOCK_FILENAME, FileLock::Mode::Exclusive);
+    auto generation = loadGeneration(identifierDirectory);
+
+    for (const auto &entry : std::experimental::filesystem::directory_iterator(identifierDirectory)) {
+        if (entry.path().extension() == ".bin")
+            std::experimental::filesystem::remove(entry.path());
+    }
+
+    static std::atomic<unsigned int> invalidationCount(0);
+    auto generationPath = identifierDirectory / GENERATION_FILENAME;
+    auto temporaryPath = generationPath;
+    temporaryPath += ".tmp" + std::to_string(getpid()) + "-" + std::to_string(invalidationCount++);
+    {
+        std::ofstream output(temporaryPath, std::ios::out | std::ios::trunc);
+        output << generation + 1;
+        if (!output)
+            throw std::runtime_error("Failed to write layout cache generation to " + temporaryPath.string());
+    }
+    std::experimental::filesystem::rename(temporaryPath, generationPath);
+}
+
+std::shared_ptr<TileLayout> CachedTileConfigurationProvider::tileLayoutForFrame(unsigned int frame) {
+    auto gop = frame / gopLength_;
+    auto layout = layoutCache_->layoutForGOP(gop);
+    if (layout)
+        return layout;
+
+    layout = baseLayoutProvider_->tileLayoutForFrame(gop * gopLength_);
+    layoutCache_->addLayoutForGOP(gop, layout);
+    return layout;
+}
+
+std::shared_ptr<TileLayoutProvider> CachedTileConfigurationProvider::fineGrainedLayoutProvider(unsigned int gopLength,
+        std::shared_ptr<SemanticDataManager> semanticDataManager,
+        unsigned int frameWidth,
+        unsigned int frameHeight,
+        const std::experimental::filesystem::path &cacheDirectory) {
+    auto layoutProvider = std::make_shared<FineGrainedTileConfigurationProvider>(gopLength, semanticDataManager, frameWidth, frameHeight);
+    auto indexIdentity = semanticDataManager->index()->identity();
+    if (semanticDataManager->temporalSelection() || indexIdentity.empty())
+        return layoutProvider;
+
+    auto layoutCache = std::make_shared<PersistentLayoutCache>(cacheDirectory,
+            indexIdentity,
+            semanticDataManager->metadataIdentifier(),
+            *semanticDataManager->metadataSelection(),
+            frameWidth,
+            frameHeight,
+            gopLength);
+    return std::make_shared<CachedTileConfigurationProvider>(layoutProvider, layoutCache, gopLength);
+}
+
+} // namespace tasm
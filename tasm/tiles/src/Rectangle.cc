@@ -0,0 +1,92 @@
+#include "Rectangle.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace tasm {
+
+void RectangleMerger::addRectangle(const Rectangle &other) {
+    // The existing rectangles don't overlap each other, so only the added rectangle can overlap them as it grows.
+    auto merged = other;
+    bool isFirstOverlap = true;
+    for (bool grew = true; grew;) {
+        grew = false;
+        auto keptEnd = rectangles_.begin();
+        for (auto &rectangle : rectangles_) {
+            if (rectangle.intersects(merged)) {
+                if (isFirstOverlap)
+                    merged.id = rectangle.id;
+                isFirstOverlap = false;
+                merged.expand(rectangle);
+                grew = true;
+            } else
+                *keptEnd++ = rectangle;
+        }
+        rectangles_.erase(keptEnd, rectangles_.end());
+    }
+    rectangles_.push_back(merged);
+}
+
+void RectangleMerger::addRectangles(const std::vector<Rectangle> &others) {
+    rectangles_.insert(rectangles_.end(), others.begin(), others.end());
+    rectangles_ = mergeRectangles(std::move(rectangles_));
+}
+
+std::vector<Rectangle> RectangleMerger::mergeRectangles(std::vector<Rectangle> rectangles) {
+    while (true) {
+        std::vector<unsigned int> parent(rectangles.size());
+        std::iota(parent.begin(), parent.end(), 0);
+        auto find = [&](unsigned int index) {
+            while (parent[index] != index)
+                index = parent[index] = parent[parent[index]];
+            return index;
+        };
+
+        std::vector<unsigned int> byLeftEdge(rectangles.size());
+        std::iota(byLeftEdge.begin(), byLeftEdge.end(), 0);
+        std::sort(byLeftEdge.begin(), byLeftEdge.end(), [&](unsigned int a, unsigned int b) {
+            return rectangles[a].x < rectangles[b].x;
+        });
+
+        // Rectangles whose right edge is past the sweep line.
+        std::vector<unsigned int> active;
+        bool anyMerged = false;
+        for (auto index : byLeftEdge) {
+            auto &rectangle = rectangles[index];
+            active.erase(std::remove_if(active.begin(), active.end(), [&](unsigned int activeIndex) {
+                return rectangles[activeIndex].x + rectangles[activeIndex].width <= rectangle.x;
+            }), active.end());
+
+            for (auto activeIndex : active) {
+                if (!rectangles[activeIndex].intersects(rectangle))
+                    continue;
+
+                auto root = find(index);
+                auto activeRoot = find(activeIndex);
+                if (root != activeRoot) {
+                    // The lower index becomes the root so that the merged rectangle keeps the first rectangle's id.
+                    parent[std::max(root, activeRoot)] = std::min(root, activeRoot);
+                    anyMerged = true;
+                }
+            }
+            active.push_back(index);
+        }
+
+        if (!anyMerged)
+            return rectangles;
+
+        std::vector<Rectangle> merged;
+        std::vector<int> rootToMergedIndex(rectangles.size(), -1);
+        for (auto i = 0u; i < rectangles.size(); ++i) {
+            auto root = find(i);
+            if (rootToMergedIndex[root] < 0) {
+                rootToMergedIndex[root] = merged.size();
+                merged.push_back(rectangles[root]);
+            } else
+                merged[rootToMergedIndex[root]].expand(rectangles[i]);
+        }
+        rectangles = std::move(merged);
+    }
+}
+
+} // namespace tasm
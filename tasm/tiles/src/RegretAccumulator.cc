@@ -1,10 +1,22 @@
 #include "RegretAccumulator.h"
 
+#include "LayoutCache.h"
+#include "RegretState.pb.h"
 #include "SemanticDataManager.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iostream>
+#include <tuple>
+#include <unistd.h>
 
 namespace tasm {
 
+static auto constexpr REGRET_STATE_VERSION = 2u;
+static auto constexpr REGRET_STATE_FILENAME = "regret-state.bin";
+
+constexpr std::chrono::seconds RegretAccumulator::DefaultSaveInterval;
+
 static std::string combineStrings(const std::vector<std::string> &strings) {
     static const std::string connector = "_";
     std::string combined = "";
@@ -17,25 +29,88 @@ static std::string combineStrings(const std::vector<std::string> &strings) {
     return combined;
 }
 
- void RegretAccumulator::addRegretForQuery(std::shared_ptr<Workload> workload,
-                                          std::shared_ptr<TileLayoutProvider> currentLayout) {
+void GOPQuerySummary::addRectangles(unsigned int frameOffsetInGOP, const std::list<Rectangle> &rectangles) {
+    for (const auto &rectangle : rectangles) {
+        if (!rectangle.width || !rectangle.height)
+            continue;
+
+        auto lastColumn = std::min((rectangle.x + rectangle.width - 1) / CellSize, numberOfColumns_ - 1);
+        auto lastRow = std::min((rectangle.y + rectangle.height - 1) / CellSize, numberOfRows_ - 1);
+        for (auto row = rectangle.y / CellSize; row <= lastRow; ++row) {
+            for (auto column = rectangle.x / CellSize; column <= lastColumn; ++column) {
+                auto &frameTouched = framesTouched_[row * numberOfColumns_ + column];
+                frameTouched = std::max(frameTouched, frameOffsetInGOP + 1);
+            }
+        }
+    }
+}
+
+void GOPQuerySummary::addQueries(unsigned int numberOfQueries, double baselineCost, unsigned int iteration) {
+    numberOfQueries_ += numberOfQueries;
+    baselineCost_ += baselineCost;
+    lastIteration_ = std::max(lastIteration_, iteration);
+}
+
+void GOPQuerySummary::merge(const GOPQuerySummary &other) {
+    assert(framesTouched_.size() == other.framesTouched_.size());
+    for (auto i = 0u; i < framesTouched_.size(); ++i)
+        framesTouched_[i] = std::max(framesTouched_[i], other.framesTouched_[i]);
+    addQueries(other.numberOfQueries_, other.baselineCost_, other.lastIteration_);
+}
+
+CostElements GOPQuerySummary::estimateCostForLayout(const TileLayout &layout, unsigned int keyframe, std::shared_ptr<TileSizeEstimator> tileSizeEstimator) const {
+    // Mirrors WorkloadCostEstimator: each tile that an object overlaps is decoded from the keyframe through the last
+    // frame where an object overlaps it. Cells that a tile only partially covers count as overlapping the tile.
+    CostElements costs(0, 0);
+    for (auto i = 0u; i < layout.numberOfTiles(); ++i) {
+        auto tileRectangle = layout.rectangleForTile(i);
+        auto lastColumn = std::min((tileRectangle.x + tileRectangle.width - 1) / CellSize, numberOfColumns_ - 1);
+        auto lastRow = std::min((tileRectangle.y + tileRectangle.height - 1) / CellSize, numberOfRows_ - 1);
+        unsigned int numTiles = 0;
+        for (auto row = tileRectangle.y / CellSize; row <= lastRow; ++row) {
+            for (auto column = tileRectangle.x / CellSize; column <= lastColumn; ++column)
+                numTiles = std::max(numTiles, framesTouched_[row * numberOfColumns_ + column]);
+        }
+        if (!numTiles)
+            continue;
+
+        costs.add(CostElements(
+                static_cast<unsigned long long>(tileRectangle.area()) * numTiles,
+                numTiles,
+                tileSizeEstimator ? tileSizeEstimator->estimateBytesForRegion(tileRectangle, keyframe, keyframe + numTiles - 1) : 0,
+                1));
+    }
+    return CostElements(numberOfQueries_ * costs.numPixels,
+                        numberOfQueries_ * costs.numTiles,
+                        numberOfQueries_ * costs.numBytes,
+                        numberOfQueries_ * costs.numFiles);
+}
+
+void RegretAccumulator::addRegretForQuery(std::shared_ptr<Workload> workload,
+                                          std::shared_ptr<TileLayoutProvider> currentLayout,
+                                          std::shared_ptr<TileSizeEstimator> tileSizeEstimator) {
+    std::scoped_lock lock(mutex_);
     ++queryIteration_;
+    tileSizeEstimator_ = tileSizeEstimator;
     auto &queryObjects = workload->semanticDataManagerForQuery(0)->labelsInQuery();
 
     addRegretForHistoricalQueries(queryObjects);
 
     // Generate baseline costs based on the current layout.
-    WorkloadCostEstimator baselineCostEstimator(currentLayout, workload, gopLength_);
-    auto baselineCosts = std::make_shared<std::unordered_map<unsigned int, CostElements>>();
-    baselineCostEstimator.estimateCostForQuery(0, baselineCosts.get());
+    WorkloadCostEstimator baselineCostEstimator(currentLayout, workload, gopLength_, tileSizeEstimator_);
+    std::unordered_map<unsigned int, CostElements> baselineCosts;
+    baselineCostEstimator.estimateCostForQuery(0, &baselineCosts);
 
-    addRegretForWorkload(queryIteration_, workload, baselineCosts, labels_);
+    addRegretForWorkload(workload, baselineCosts, labels_);
 
-    iterationToWorkload_[queryIteration_] = workload;
-    iterationToBaselineCosts_[queryIteration_] = baselineCosts;
+    // Only a summary of the query is kept, so its metadata can be released once the query is done.
+    addQueryToSummaries(combineStrings(queryObjects), workload, baselineCosts);
+    evictLeastRecentlyQueriedSummaries();
+    hasUnsavedChanges_ = true;
 }
 
 std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<TileLayoutProvider>>> RegretAccumulator::getNewGOPLayouts() {
+    std::scoped_lock lock(mutex_);
     auto newGOPLayouts = std::make_unique<std::unordered_map<unsigned int, std::shared_ptr<TileLayoutProvider>>>();
     for (auto it = gopToRegret_.begin(); it != gopToRegret_.end(); ++it) {
         auto gop = it->first;
@@ -43,23 +118,65 @@ std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<TileLayoutProvi
         if (shouldRetileGOP(gop, idForGOP)) {
             newGOPLayouts->insert({gop, configurationProviderForIdentifier(idForGOP)});
             resetRegretForGOP(gop);
+            hasUnsavedChanges_ = true;
         }
     }
     return newGOPLayouts;
 }
 
-bool RegretAccumulator::shouldRetileGOP(unsigned int gop, std::string &layoutIdentifier) {
-    long long int maxRegret = 0;
-    std::string labelWithMaxRegret;
+std::vector<RetileCandidate> RegretAccumulator::gopsWorthRetiling() const {
+    std::scoped_lock lock(mutex_);
+    std::vector<RetileCandidate> candidates;
+    auto encodeCost = gopTilingCost();
+    for (auto it = gopToRegret_.begin(); it != gopToRegret_.end(); ++it) {
+        std::string layoutIdentifier;
+        auto maxRegret = maxRegretForGOP(it->first, layoutIdentifier);
+        if (maxRegret > threshold_ * encodeCost)
+            candidates.push_back({it->first, maxRegret, encodeCost});
+    }
+    return candidates;
+}
+
+std::shared_ptr<TileLayoutProvider> RegretAccumulator::layoutToRetileGOP(unsigned int gop) {
+    std::scoped_lock lock(mutex_);
+    std::string layoutIdentifier;
+    if (!gopToRegret_.count(gop) || !shouldRetileGOP(gop, layoutIdentifier))
+        return nullptr;
+
+    return configurationProviderForIdentifier(layoutIdentifier);
+}
+
+void RegretAccumulator::resetRegretForRetiledGOP(unsigned int gop) {
+    std::scoped_lock lock(mutex_);
+    if (!gopToRegret_.count(gop))
+        return;
+
+    resetRegretForGOP(gop);
+    hasUnsavedChanges_ = true;
+}
+
+std::vector<std::string> RegretAccumulator::candidateLayouts() const {
+    std::scoped_lock lock(mutex_);
+    return labels_;
+}
 
-    for (auto it = gopToRegret_[gop].begin(); it != gopToRegret_[gop].end(); ++it) {
+double RegretAccumulator::maxRegretForGOP(unsigned int gop, std::string &layoutIdentifier) const {
+    long long int maxRegret = 0;
+    auto &regretForGOP = gopToRegret_.at(gop);
+    for (auto it = regretForGOP.begin(); it != regretForGOP.end(); ++it) {
         if (it->second > maxRegret) {
             maxRegret = it->second;
-            labelWithMaxRegret = it->first;
+            layoutIdentifier = it->first;
         }
     }
+    return maxRegret;
+}
 
-    if (maxRegret > threshold_ * gopTilingCost_) {
+bool RegretAccumulator::shouldRetileGOP(unsigned int gop, std::string &layoutIdentifier) {
+    std::string labelWithMaxRegret;
+    auto maxRegret = maxRegretForGOP(gop, labelWithMaxRegret);
+
+    if (maxRegret > threshold_ * gopTilingCost()) {
         layoutIdentifier = labelWithMaxRegret;
         std::cout << "Retile GOP " << gop << " to " << layoutIdentifier << std::endl;
         return true;
@@ -71,7 +188,15 @@ void RegretAccumulator::resetRegretForGOP(unsigned int gop) {
     for (auto it = gopToRegret_[gop].begin(); it != gopToRegret_[gop].end(); ++it)
         it->second = 0;
 
-    gopToClearedIteration_[gop] = queryIteration_;
+    // Queries from before the GOP was re-tiled no longer say anything about its current layout.
+    gopToPrunedCandidates_.erase(gop);
+    auto summaries = gopToSummaries_.find(gop);
+    if (summaries == gopToSummaries_.end())
+        return;
+
+    for (const auto &objectsAndSummary : summaries->second)
+        historyBytes_ -= objectsAndSummary.second.sizeInBytes();
+    gopToSummaries_.erase(summaries);
 }
 
 std::shared_ptr<TileLayoutProvider> RegretAccumulator::configurationProviderForIdentifier(const std::string &identifier) {
@@ -86,101 +211,441 @@ void RegretAccumulator::addRegretForHistoricalQueries(const std::vector<std::str
     allObjects_.insert(combinedObjects);
     singleObjects_.insert(objects.begin(), objects.end());
 
-    // Add a layout for new objects and new combined objects.
-    labels_.push_back(combinedObjects);
-    idToConfig_[combinedObjects] = tileLayoutForObjects(objects);
-    std::vector<std::string> newLayouts{combinedObjects};
+    // Add a layout for the new objects, and one for them together with the objects they co-occur with.
+    std::vector<std::string> newLayouts;
+    if (!idToConfig_.count(combinedObjects) && !evictedCandidates_.count(combinedObjects)) {
+        addCandidateLayout(combinedObjects, objects);
+        newLayouts.push_back(combinedObjects);
+    }
 
-    if (labels_.size() > 1) {
-        std::vector<std::string> newAllObjects(singleObjects_.begin(), singleObjects_.end());
-        auto newAllObjectsLabel = combineStrings(newAllObjects);
-        labels_.push_back(newAllObjectsLabel);
-        idToConfig_[newAllObjectsLabel] = tileLayoutForObjects(newAllObjects);
-        newLayouts.push_back(newAllObjectsLabel);
+    auto clusteredObjects = coOccurringObjects(objects);
+    auto clusteredObjectsLabel = combineStrings(clusteredObjects);
+    if (clusteredObjects.size() > objects.size() && !idToConfig_.count(clusteredObjectsLabel) && !evictedCandidates_.count(clusteredObjectsLabel)) {
+        addCandidateLayout(clusteredObjectsLabel, clusteredObjects);
+        newLayouts.push_back(clusteredObjectsLabel);
     }
 
-    // Go through historical queries.
-    // If all GOPs affected by a query have been re-tiled, remove these costs from the dictionary.
-    for (auto i = 1u; i < queryIteration_; ++i) {
-        if (!iterationToWorkload_.count(i))
-            continue;
+    // Score the new layouts against the queries that have been made since each GOP was last re-tiled.
+    for (const auto &gopAndSummaries : gopToSummaries_) {
+        for (const auto &objectsAndSummary : gopAndSummaries.second)
+            addRegretForSummary(gopAndSummaries.first, objectsAndSummary.second, newLayouts);
+        pruneDominatedCandidates(gopAndSummaries.first);
+    }
+}
 
-        if (!costsAreForGOPsThatHaveNotBeenRetiled(i, iterationToBaselineCosts_.at(i))) {
-            iterationToWorkload_.erase(i);
-            iterationToBaselineCosts_.erase(i);
-            continue;
+void RegretAccumulator::addCandidateLayout(const std::string &identifier, const std::vector<std::string> &objects) {
+    labels_.push_back(identifier);
+    idToObjects_[identifier] = objects;
+    idToConfig_[identifier] = tileLayoutForObjects(objects);
+}
+
+std::vector<std::string> RegretAccumulator::coOccurringObjects(const std::vector<std::string> &objects) {
+    // Grow the cluster from the queried objects by following pairs of objects that co-occur.
+    std::unordered_set<std::string> cluster(objects.begin(), objects.end());
+    std::vector<std::string> objectsToVisit(objects.begin(), objects.end());
+    while (!objectsToVisit.empty()) {
+        auto object = objectsToVisit.back();
+        objectsToVisit.pop_back();
+        for (const auto &otherObject : singleObjects_) {
+            if (!cluster.count(otherObject) && coOccurrence(object, otherObject) >= CoOccurrenceThreshold) {
+                cluster.insert(otherObject);
+                objectsToVisit.push_back(otherObject);
+            }
         }
+    }
+
+    std::vector<std::string> clusteredObjects(cluster.begin(), cluster.end());
+    std::sort(clusteredObjects.begin(), clusteredObjects.end());
+    return clusteredObjects;
+}
 
-        auto workload = iterationToWorkload_.at(i);
-        addRegretForWorkload(i, workload, iterationToBaselineCosts_.at(i), newLayouts);
+double RegretAccumulator::coOccurrence(const std::string &object, const std::string &otherObject) {
+    auto &bounds = boundsByGOPForObject(object);
+    auto &otherBounds = boundsByGOPForObject(otherObject);
+
+    unsigned int gopsWithBoth = 0;
+    unsigned int gopsWithBothOverlapping = 0;
+    for (const auto &gopAndBounds : bounds) {
+        auto otherBoundsForGOP = otherBounds.find(gopAndBounds.first);
+        if (otherBoundsForGOP == otherBounds.end())
+            continue;
+
+        ++gopsWithBoth;
+        if (gopAndBounds.second.intersects(otherBoundsForGOP->second))
+            ++gopsWithBothOverlapping;
+    }
+
+    auto gopsWithEither = bounds.size() + otherBounds.size() - gopsWithBoth;
+    return gopsWithEither ? static_cast<double>(gopsWithBothOverlapping) / gopsWithEither : 0;
+}
+
+const std::unordered_map<unsigned int, Rectangle> &RegretAccumulator::boundsByGOPForObject(const std::string &object) {
+    auto existingBounds = objectToBoundsByGOP_.find(object);
+    if (existingBounds != objectToBoundsByGOP_.end())
+        return existingBounds->second;
+
+    // Only the region that an object covers within each GOP is kept, which is what layouts are chosen from.
+    auto &boundsByGOP = objectToBoundsByGOP_[object];
+    auto rectangles = semanticIndex_->rectanglesForFrames(metadataIdentifier_, std::make_shared<SingleMetadataSelection>(object), 0, std::numeric_limits<int>::max());
+    for (const auto &rectangle : *rectangles) {
+        auto gop = rectangle.id / gopLength_;
+        auto bounds = boundsByGOP.find(gop);
+        if (bounds == boundsByGOP.end())
+            boundsByGOP.emplace(gop, rectangle);
+        else
+            bounds->second.expand(rectangle);
+    }
+
+    // Approximates the map's nodes and buckets.
+    auto boundsBytes = boundsByGOP.size() * (sizeof(std::pair<const unsigned int, Rectangle>) + 2 * sizeof(void*)) + object.size();
+    objectBoundsBytes_ += boundsBytes;
+    historyBytes_ += boundsBytes;
+    return boundsByGOP;
+}
+
+void RegretAccumulator::clearObjectBounds() {
+    objectToBoundsByGOP_.clear();
+    historyBytes_ -= objectBoundsBytes_;
+    objectBoundsBytes_ = 0;
+}
+
+void RegretAccumulator::invalidateMetadata() {
+    std::scoped_lock lock(mutex_);
+    clearObjectBounds();
+
+    // The candidates' providers hold on to the layouts they already computed.
+    for (auto &identifierAndConfig : idToConfig_)
+        identifierAndConfig.second = tileLayoutForObjects(idToObjects_.at(identifierAndConfig.first));
+
+    // Candidates that were evicted may be worth proposing with the new metadata.
+    evictedCandidates_.clear();
+    evictedCandidateOrder_.clear();
+    hasUnsavedChanges_ = true;
+}
+
+bool RegretAccumulator::isCandidateForGOP(unsigned int gop, const std::string &layoutIdentifier) const {
+    if (!idToConfig_.count(layoutIdentifier))
+        return false;
+
+    auto prunedCandidates = gopToPrunedCandidates_.find(gop);
+    return prunedCandidates == gopToPrunedCandidates_.end() || !prunedCandidates->second.count(layoutIdentifier);
+}
+
+void RegretAccumulator::pruneDominatedCandidates(unsigned int gop) {
+    auto regretForGOP = gopToRegret_.find(gop);
+    if (regretForGOP == gopToRegret_.end() || regretForGOP->second.size() <= maxCandidatesPerGOP_)
+        return;
+
+    std::vector<std::pair<double, std::string>> regretAndLayouts;
+    for (const auto &layoutAndRegret : regretForGOP->second)
+        regretAndLayouts.emplace_back(layoutAndRegret.second, layoutAndRegret.first);
+    std::sort(regretAndLayouts.begin(), regretAndLayouts.end(), std::greater<>());
+
+    std::vector<std::string> evictedLayouts;
+    for (auto it = regretAndLayouts.begin() + maxCandidatesPerGOP_; it != regretAndLayouts.end(); ++it) {
+        auto &layoutIdentifier = it->second;
+        regretForGOP->second.erase(layoutIdentifier);
+        gopToPrunedCandidates_[gop].insert(layoutIdentifier);
+        if (!--candidateToNumberOfGOPs_.at(layoutIdentifier))
+            evictedLayouts.push_back(layoutIdentifier);
+    }
+
+    for (const auto &layoutIdentifier : evictedLayouts)
+        evictCandidate(layoutIdentifier);
+}
+
+void RegretAccumulator::evictCandidate(const std::string &layoutIdentifier) {
+    labels_.erase(std::remove(labels_.begin(), labels_.end(), layoutIdentifier), labels_.end());
+    idToObjects_.erase(layoutIdentifier);
+    idToConfig_.erase(layoutIdentifier);
+    candidateToNumberOfGOPs_.erase(layoutIdentifier);
+    for (auto &gopAndPrunedCandidates : gopToPrunedCandidates_)
+        gopAndPrunedCandidates.second.erase(layoutIdentifier);
+    rememberEvictedCandidate(layoutIdentifier);
+}
+
+void RegretAccumulator::rememberEvictedCandidate(const std::string &layoutIdentifier) {
+    if (!evictedCandidates_.insert(layoutIdentifier).second)
+        return;
+
+    evictedCandidateOrder_.push_back(layoutIdentifier);
+    if (evictedCandidateOrder_.size() > MaxEvictedCandidates) {
+        evictedCandidates_.erase(evictedCandidateOrder_.front());
+        evictedCandidateOrder_.pop_front();
     }
 }
 
 std::shared_ptr<TileLayoutProvider> RegretAccumulator::tileLayoutForObjects(const std::vector<std::string> &objects) {
-    auto metadataSelection = std::make_shared<OrMetadataSelection>(objects);
+    // Sort the objects so that every order of the same objects shares cached layouts.
+    std::vector<std::string> sortedObjects(objects);
+    std::sort(sortedObjects.begin(), sortedObjects.end());
+    auto metadataSelection = std::make_shared<OrMetadataSelection>(sortedObjects);
     auto semanticDataManager = std::make_shared<SemanticDataManager>(semanticIndex_, metadataIdentifier_, metadataSelection);
-    return std::make_shared<FineGrainedTileConfigurationProvider>(
+    return CachedTileConfigurationProvider::fineGrainedLayoutProvider(
             gopLength_,
             semanticDataManager,
             width_,
             height_);
 }
 
-bool RegretAccumulator::costsAreForGOPsThatHaveNotBeenRetiled(unsigned int iteration,
-                                                              std::shared_ptr<std::unordered_map<unsigned int, CostElements>> baselineCosts) {
-    for (auto it = baselineCosts->begin(); it != baselineCosts->end(); ++it) {
-        auto gop = it->first;
-        // If a GOP hasn't been cleared, it's still relevant.
-        if (!gopToClearedIteration_.count(gop))
-            return true;
-
-        // If a GOP was cleared before this query, it's still relevant.
-        if (gopToClearedIteration_.at(gop) < iteration)
-            return true;
-    }
-    return false;
-}
-
-void RegretAccumulator::addRegretForWorkload(unsigned int iteration, std::shared_ptr<Workload> workload,
-                                             std::shared_ptr<std::unordered_map<unsigned int, CostElements>> baselineCosts,
+void RegretAccumulator::addRegretForWorkload(std::shared_ptr<Workload> workload,
+                                             const std::unordered_map<unsigned int, CostElements> &baselineCosts,
                                              const std::vector<std::string> layouts) {
-    static const double pixelCostWeight = 1.608e-06;
-    static const double tileCostWeight = 1.703e-01;
+    auto pixelThreshold = costModel_->pixelThreshold();
 
-    WorkloadCostEstimator noTilesLayoutEstimator(noTilesConfiguration_, workload, gopLength_);
+    WorkloadCostEstimator noTilesLayoutEstimator(noTilesConfiguration_, workload, gopLength_, tileSizeEstimator_);
     auto noTilesCosts = std::make_unique<std::unordered_map<unsigned int, CostElements>>();
     noTilesLayoutEstimator.estimateCostForQuery(0, noTilesCosts.get());
     
-    for (const auto &layoutId : layouts) {
-        WorkloadCostEstimator proposedLayoutEstimator(idToConfig_.at(layoutId), workload, gopLength_);
-        auto proposedCosts = std::make_unique<std::unordered_map<unsigned int, CostElements>>();
-        proposedLayoutEstimator.estimateCostForQuery(0, proposedCosts.get());
-        
-        assert(baselineCosts->size() == proposedCosts->size());
-        
-        for (auto curIt = baselineCosts->begin(); curIt != baselineCosts->end(); ++curIt) {
-            auto gop = curIt->first;
-            if (gopToClearedIteration_.count(gop) && gopToClearedIteration_.at(gop) >= iteration)
+    // Only the candidates that have not been pruned for a GOP are costed for it.
+    WorkloadCostEstimator proposedLayoutEstimator(noTilesConfiguration_, workload, gopLength_, tileSizeEstimator_);
+    for (auto curIt = baselineCosts.begin(); curIt != baselineCosts.end(); ++curIt) {
+        auto gop = curIt->first;
+        auto curCosts = curIt->second;
+        for (const auto &layoutId : layouts) {
+            if (!isCandidateForGOP(gop, layoutId))
                 continue;
-            
-            auto curCosts = curIt->second;
-            auto possibleCosts = proposedCosts->at(gop);
-            double regret = pixelCostWeight *
-                    (long long int)(curCosts.numPixels - possibleCosts.numPixels) +
-                    tileCostWeight * (int)(curCosts.numTiles - possibleCosts.numTiles);
-            if (possibleCosts.numPixels >= 0.8 * noTilesCosts->at(gop).numPixels)
+
+            auto possibleCosts = proposedLayoutEstimator.estimateCostForGOP(gop, *idToConfig_.at(layoutId)->tileLayoutForFrame(gop * gopLength_));
+            double regret = costModel_->estimateCost(curCosts) - costModel_->estimateCost(possibleCosts);
+            if (possibleCosts.numPixels >= pixelThreshold * noTilesCosts->at(gop).numPixels)
                 regret = std::numeric_limits<double>::lowest();
 
             addRegretToGOP(gop, regret, layoutId);
         }
+        pruneDominatedCandidates(gop);
+    }
+}
+
+void RegretAccumulator::addRegretForSummary(unsigned int gop, const GOPQuerySummary &summary, const std::vector<std::string> &layouts) {
+    auto pixelThreshold = costModel_->pixelThreshold();
+    auto keyframe = gop * gopLength_;
+    auto noTilesCosts = summary.estimateCostForLayout(*noTilesConfiguration_->tileLayoutForFrame(keyframe), keyframe, tileSizeEstimator_);
+
+    for (const auto &layoutId : layouts) {
+        if (!isCandidateForGOP(gop, layoutId))
+            continue;
+
+        auto possibleCosts = summary.estimateCostForLayout(*idToConfig_.at(layoutId)->tileLayoutForFrame(keyframe), keyframe, tileSizeEstimator_);
+        double regret = summary.baselineCost() - costModel_->estimateCost(possibleCosts);
+        if (possibleCosts.numPixels >= pixelThreshold * noTilesCosts.numPixels)
+            regret = std::numeric_limits<double>::lowest();
+
+        addRegretToGOP(gop, regret, layoutId);
+    }
+}
+
+void RegretAccumulator::addQueryToSummaries(const std::string &objects, std::shared_ptr<Workload> workload,
+                                            const std::unordered_map<unsigned int, CostElements> &baselineCosts) {
+    auto semanticDataManager = workload->semanticDataManagerForQuery(0);
+    auto &orderedFrames = semanticDataManager->orderedFrames();
+    for (auto frameIt = orderedFrames.begin(); frameIt != orderedFrames.end();) {
+        auto gop = *frameIt / gopLength_;
+        GOPQuerySummary summary(width_, height_);
+        for (; frameIt != orderedFrames.end() && *frameIt / gopLength_ == gop; ++frameIt)
+            summary.addRectangles(*frameIt - gop * gopLength_, semanticDataManager->rectanglesForFrame(*frameIt));
+
+        summary.addQueries(1, costModel_->estimateCost(baselineCosts.at(gop)), queryIteration_);
+        addSummary(gop, objects, summary);
+    }
+}
+
+void RegretAccumulator::addSummary(unsigned int gop, const std::string &objects, const GOPQuerySummary &summary) {
+    auto &summariesForGOP = gopToSummaries_[gop];
+    auto existingSummary = summariesForGOP.find(objects);
+    if (existingSummary != summariesForGOP.end()) {
+        existingSummary->second.merge(summary);
+        return;
+    }
+
+    summariesForGOP.emplace(objects, summary);
+    historyBytes_ += summary.sizeInBytes();
+}
+
+void RegretAccumulator::evictLeastRecentlyQueriedSummaries() {
+    if (historyBytes_ <= maxHistoryBytes_)
+        return;
+
+    clearObjectBounds();
+    if (historyBytes_ <= maxHistoryBytes_)
+        return;
+
+    std::vector<std::tuple<unsigned int, unsigned int, std::string>> iterationGOPAndObjects;
+    for (const auto &gopAndSummaries : gopToSummaries_) {
+        for (const auto &objectsAndSummary : gopAndSummaries.second)
+            iterationGOPAndObjects.emplace_back(objectsAndSummary.second.lastIteration(), gopAndSummaries.first, objectsAndSummary.first);
+    }
+    std::sort(iterationGOPAndObjects.begin(), iterationGOPAndObjects.end());
+
+    for (auto it = iterationGOPAndObjects.begin(); it != iterationGOPAndObjects.end() && historyBytes_ > maxHistoryBytes_; ++it) {
+        auto gop = std::get<1>(*it);
+        auto &summariesForGOP = gopToSummaries_.at(gop);
+        auto summary = summariesForGOP.find(std::get<2>(*it));
+        historyBytes_ -= summary->second.sizeInBytes();
+        summariesForGOP.erase(summary);
+        if (summariesForGOP.empty())
+            gopToSummaries_.erase(gop);
     }
 }
 
 void RegretAccumulator::addRegretToGOP(unsigned int gop, double regret, const std::string &layoutIdentifier) {
-    if (!gopToRegret_[gop].count(layoutIdentifier))
+    if (!gopToRegret_[gop].count(layoutIdentifier)) {
         gopToRegret_[gop][layoutIdentifier] = 0;
+        ++candidateToNumberOfGOPs_[layoutIdentifier];
+    }
 
     gopToRegret_[gop][layoutIdentifier] += regret;
 }
 
+std::experimental::filesystem::path RegretAccumulator::pathForEntry(const std::experimental::filesystem::path &entryPath) {
+    return entryPath / REGRET_STATE_FILENAME;
+}
+
+bool RegretAccumulator::load(const std::experimental::filesystem::path &path) {
+    std::scoped_lock lock(mutex_);
+    if (!std::experimental::filesystem::exists(path))
+        return false;
+
+    lightdb::serialization::RegretState serialized;
+    std::fstream input(path, std::ios::in | std::ios::binary);
+    if (!serialized.ParseFromIstream(&input)) {
+        std::cerr << "Ignoring unreadable regret state " << path << std::endl;
+        return false;
+    }
+
+    if (serialized.version() != REGRET_STATE_VERSION
+            || serialized.metadataidentifier() != metadataIdentifier_
+            || serialized.width() != width_
+            || serialized.height() != height_
+            || serialized.goplength() != gopLength_)
+        return false;
+
+    // Check the summaries before anything is loaded so that a malformed file leaves the state alone.
+    auto numberOfCells = GOPQuerySummary(width_, height_).framesTouched().size();
+    for (const auto &serializedSummary : serialized.summaries()) {
+        if (static_cast<unsigned int>(serializedSummary.framestouched_size()) != numberOfCells) {
+            std::cerr << "Ignoring regret state with a malformed query summary " << path << std::endl;
+            return false;
+        }
+    }
+
+    queryIteration_ = serialized.queryiteration();
+
+    for (const auto &candidate : serialized.candidates()) {
+        std::vector<std::string> objects(candidate.objects().begin(), candidate.objects().end());
+        addCandidateLayout(candidate.identifier(), objects);
+        singleObjects_.insert(objects.begin(), objects.end());
+    }
+    allObjects_.insert(serialized.queriedobjectsets().begin(), serialized.queriedobjectsets().end());
+
+    for (const auto &gopRegret : serialized.gopregrets()) {
+        for (const auto &layoutRegret : gopRegret.regrets())
+            addRegretToGOP(gopRegret.gop(), layoutRegret.regret(), layoutRegret.identifier());
+        if (gopRegret.prunedcandidates_size())
+            gopToPrunedCandidates_[gopRegret.gop()].insert(gopRegret.prunedcandidates().begin(), gopRegret.prunedcandidates().end());
+    }
+    for (const auto &layoutIdentifier : serialized.evictedcandidates())
+        rememberEvictedCandidate(layoutIdentifier);
+    for (const auto &serializedSummary : serialized.summaries()) {
+        GOPQuerySummary summary(width_, height_);
+        summary.setFramesTouched({serializedSummary.framestouched().begin(), serializedSummary.framestouched().end()});
+        summary.addQueries(serializedSummary.numberofqueries(), serializedSummary.baselinecost(), serializedSummary.lastiteration());
+        addSummary(serializedSummary.gop(), serializedSummary.objects(), summary);
+    }
+    return true;
+}
+
+void RegretAccumulator::saveIfDue(const std::experimental::filesystem::path &path, std::chrono::seconds saveInterval) {
+    {
+        std::scoped_lock lock(mutex_);
+        if (!hasUnsavedChanges_ || std::chrono::steady_clock::now() - lastSave_ < saveInterval)
+            return;
+    }
+    save(path);
+}
+
+void RegretAccumulator::saveIfChanged(const std::experimental::filesystem::path &path) {
+    {
+        std::scoped_lock lock(mutex_);
+        if (!hasUnsavedChanges_)
+            return;
+    }
+    save(path);
+}
+
+void RegretAccumulator::save(const std::experimental::filesystem::path &path) const {
+    std::scoped_lock saveLock(saveMutex_);
+    std::unique_lock lock(mutex_);
+    lightdb::serialization::RegretState serialized;
+    serialized.set_version(REGRET_STATE_VERSION);
+    serialized.set_metadataidentifier(metadataIdentifier_);
+    serialized.set_width(width_);
+    serialized.set_height(height_);
+    serialized.set_goplength(gopLength_);
+    serialized.set_queryiteration(queryIteration_);
+
+    // Candidates are saved in the order they were added so that they are evaluated in the same order after loading.
+    for (const auto &identifier : labels_) {
+        auto *candidate = serialized.add_candidates();
+        candidate->set_identifier(identifier);
+        for (const auto &object : idToObjects_.at(identifier))
+            candidate->add_objects(object);
+    }
+    for (const auto &objects : allObjects_)
+        serialized.add_queriedobjectsets(objects);
+
+    for (const auto &gopAndRegrets : gopToRegret_) {
+        auto *gopRegret = serialized.add_gopregrets();
+        gopRegret->set_gop(gopAndRegrets.first);
+        for (const auto &layoutAndRegret : gopAndRegrets.second) {
+            auto *layoutRegret = gopRegret->add_regrets();
+            layoutRegret->set_identifier(layoutAndRegret.first);
+            layoutRegret->set_regret(layoutAndRegret.second);
+        }
+
+        auto prunedCandidates = gopToPrunedCandidates_.find(gopAndRegrets.first);
+        if (prunedCandidates != gopToPrunedCandidates_.end()) {
+            for (const auto &layoutIdentifier : prunedCandidates->second)
+                gopRegret->add_prunedcandidates(layoutIdentifier);
+        }
+    }
+    for (const auto &layoutIdentifier : evictedCandidateOrder_)
+        serialized.add_evictedcandidates(layoutIdentifier);
+    for (const auto &gopAndSummaries : gopToSummaries_) {
+        for (const auto &objectsAndSummary : gopAndSummaries.second) {
+            auto &summary = objectsAndSummary.second;
+            auto *serializedSummary = serialized.add_summaries();
+            serializedSummary->set_gop(gopAndSummaries.first);
+            serializedSummary->set_objects(objectsAndSummary.first);
+            serializedSummary->set_numberofqueries(summary.numberOfQueries());
+            serializedSummary->set_baselinecost(summary.baselineCost());
+            serializedSummary->set_lastiteration(summary.lastIteration());
+            for (auto frameTouched : summary.framesTouched())
+                serializedSummary->add_framestouched(frameTouched);
+        }
+    }
+
+    hasUnsavedChanges_ = false;
+    lastSave_ = std::chrono::steady_clock::now();
+    lock.unlock();
+
+    // Queries keep adding regret while the file is written.
+    try {
+        // Write to a temporary file first so that a crash while saving doesn't lose the previous state.
+        static std::atomic<unsigned int> saveCount(0);
+        auto temporaryPath = path;
+        temporaryPath += ".tmp" + std::to_string(getpid()) + "-" + std::to_string(saveCount++);
+        {
+            std::fstream output(temporaryPath, std::ios::out | std::ios::trunc | std::ios::binary);
+            if (!serialized.SerializeToOstream(&output))
+                throw std::runtime_error("Failed to write regret state to " + temporaryPath.string());
+        }
+        std::experimental::filesystem::rename(temporaryPath, path);
+    } catch (...) {
+        std::scoped_lock failedLock(mutex_);
+        hasUnsavedChanges_ = true;
+        throw;
+    }
+}
+
 } // namespace tasm
@@ -1,24 +1,127 @@
 #include "SmartTileConfigurationProvider.h"
 
+#include "SemanticDataManager.h"
 #include <iostream>
+#include <set>
 
 namespace tasm {
 
 std::shared_ptr<TileLayout> SmartTileConfigurationProviderSingleSelection::tileLayoutForFrame(unsigned int frame) {
     auto gop = fineGrainedWorkloadCostEstimator_->gopForFrame(frame);
-    if (gopToLayout_.count(gop))
-        return gopToLayout_.at(gop);
+    {
+        std::scoped_lock lock(mutex_);
+        if (gopToLayout_.count(gop))
+            return gopToLayout_.at(gop);
+    }
 
-    // Tile if it significantly reduces the number of pixels processed. Otherwise don't tile.
-    // A GOP won't be in fineGrainedLayoutCostByGOP_ if it doesn't have metadata. In that case, we won't tile regardless.
-    bool shouldTile = fineGrainedLayoutCostByGOP_->count(gop)
-            ? fineGrainedLayoutCostByGOP_->at(gop).numPixels <= pixelThreshold_ * untiledCostByGOP_->at(gop).numPixels
-            : false;
+    bool shouldTile = shouldTileGOP(gop);
     if (!shouldTile)
         std::cout << "Not tiling GOP " << gop << std::endl;
     auto layout = shouldTile ? fineGrainedLayoutProvider_->tileLayoutForFrame(frame) : singleTileLayoutProvider_->tileLayoutForFrame(frame);
-    gopToLayout_[gop] = layout;
-    return layout;
+
+    std::scoped_lock lock(mutex_);
+    return gopToLayout_.emplace(gop, layout).first->second;
+}
+
+bool SmartTileConfigurationProviderSingleSelection::shouldTileGOP(unsigned int gop) const {
+    // A GOP won't be in fineGrainedLayoutCostByGOP_ if it doesn't have metadata. In that case, we won't tile regardless.
+    if (!fineGrainedLayoutCostByGOP_->count(gop))
+        return false;
+
+    auto &tiledCosts = fineGrainedLayoutCostByGOP_->at(gop);
+    auto &untiledCosts = untiledCostByGOP_->at(gop);
+
+    // Tile if it significantly reduces the number of pixels processed. Otherwise don't tile.
+    if (tiledCosts.numPixels > costModel_->pixelThreshold() * untiledCosts.numPixels)
+        return false;
+
+    // Reading more files or more bytes can cancel out the savings from decoding fewer pixels.
+    auto additionalReadCost = costModel_->estimateCostToRead(tiledCosts) - costModel_->estimateCostToRead(untiledCosts);
+    auto decodeSavings = costModel_->estimateCostToDecode(untiledCosts) - costModel_->estimateCostToDecode(tiledCosts);
+    return additionalReadCost <= std::max(decodeSavings, 0.0);
+}
+
+SmartTileConfigurationProviderMultipleSelection::SmartTileConfigurationProviderMultipleSelection(
+        unsigned int tileLayoutDuration,
+        std::shared_ptr<SemanticIndex> semanticIndex,
+        const std::string &metadataIdentifier,
+        std::shared_ptr<Workload> workload,
+        unsigned int frameWidth,
+        unsigned int frameHeight,
+        std::shared_ptr<CostModel> costModel,
+        std::shared_ptr<TileSizeEstimator> tileSizeEstimator)
+    : tileLayoutDuration_(tileLayoutDuration),
+    semanticIndex_(semanticIndex),
+    metadataIdentifier_(metadataIdentifier),
+    singleTileLayoutProvider_(new SingleTileConfigurationProvider(frameWidth, frameHeight)),
+    workloadCostEstimator_(new WorkloadCostEstimator(singleTileLayoutProvider_, workload, tileLayoutDuration, tileSizeEstimator)),
+    costModel_(costModel),
+    frameWidth_(frameWidth),
+    frameHeight_(frameHeight) {
+    std::set<std::string> allLabels;
+    for (auto i = 0u; i < workload->numberOfQueries(); ++i) {
+        auto &labels = workload->semanticDataManagerForQuery(i)->labelsInQuery();
+        addCandidateForLabels(labels);
+        allLabels.insert(labels.begin(), labels.end());
+    }
+    addCandidateForLabels({allLabels.begin(), allLabels.end()});
+}
+
+void SmartTileConfigurationProviderMultipleSelection::addCandidateForLabels(const std::vector<std::string> &labels) {
+    std::vector<std::string> sortedLabels(labels);
+    std::sort(sortedLabels.begin(), sortedLabels.end());
+    if (sortedLabels.empty() || std::find(candidateLabels_.begin(), candidateLabels_.end(), sortedLabels) != candidateLabels_.end())
+        return;
+
+    // The candidate is tiled around every object with these labels, not only the ones in the query's temporal range.
+    auto semanticDataManager = std::make_shared<SemanticDataManager>(semanticIndex_, metadataIdentifier_, std::make_shared<OrMetadataSelection>(sortedLabels));
+    candidateLayoutProviders_.push_back(CachedTileConfigurationProvider::fineGrainedLayoutProvider(tileLayoutDuration_, semanticDataManager, frameWidth_, frameHeight_));
+    candidateLabels_.push_back(std::move(sortedLabels));
+}
+
+std::shared_ptr<TileLayout> SmartTileConfigurationProviderMultipleSelection::tileLayoutForFrame(unsigned int frame) {
+    auto gop = workloadCostEstimator_->gopForFrame(frame);
+    {
+        std::scoped_lock lock(mutex_);
+        if (gopToLayout_.count(gop))
+            return gopToLayout_.at(gop);
+    }
+
+    auto layout = layoutForGOP(gop);
+    std::scoped_lock lock(mutex_);
+    return gopToLayout_.emplace(gop, layout).first->second;
+}
+
+std::shared_ptr<TileLayout> SmartTileConfigurationProviderMultipleSelection::layoutForGOP(unsigned int gop) {
+    auto firstFrame = gop * tileLayoutDuration_;
+    auto untiledLayout = singleTileLayoutProvider_->tileLayoutForFrame(firstFrame);
+    auto untiledCosts = workloadCostEstimator_->estimateCostForGOP(gop, *untiledLayout);
+    if (!untiledCosts.numPixels)
+        return untiledLayout;
+
+    auto bestLayout = untiledLayout;
+    auto bestCost = costModel_->estimateCost(untiledCosts);
+    for (auto &candidateProvider : candidateLayoutProviders_) {
+        auto candidateLayout = candidateProvider->tileLayoutForFrame(firstFrame);
+        if (candidateLayout->numberOfTiles() == 1)
+            continue;
+
+        auto candidateCosts = workloadCostEstimator_->estimateCostForGOP(gop, *candidateLayout);
+
+        // As with a single selection, only tile if it significantly reduces the number of pixels processed.
+        if (candidateCosts.numPixels > costModel_->pixelThreshold() * untiledCosts.numPixels)
+            continue;
+
+        auto candidateCost = costModel_->estimateCost(candidateCosts);
+        if (candidateCost < bestCost) {
+            bestCost = candidateCost;
+            bestLayout = candidateLayout;
+        }
+    }
+
+    if (bestLayout == untiledLayout)
+        std::cout << "Not tiling GOP " << gop << std::endl;
+    return bestLayout;
 }
 
-} // namespace tasm
\ No newline at end of file
+} // namespace tasm
@@ -0,0 +1,100 @@
+#include "StabilizedTileConfigurationProvider.h"
+
+#include <numeric>
+
+namespace tasm {
+
+std::shared_ptr<TileLayout> StabilizedTileConfigurationProvider::tileLayoutForFrame(unsigned int frame) {
+    std::scoped_lock lock(mutex_);
+    auto gop = frame / gopLength_;
+    for (; nextGOPToStabilize_ <= gop; ++nextGOPToStabilize_)
+        gopToLayout_[nextGOPToStabilize_] = stabilizedLayoutForGOP(nextGOPToStabilize_);
+
+    return gopToLayout_.at(gop);
+}
+
+std::shared_ptr<TileLayout> StabilizedTileConfigurationProvider::stabilizedLayoutForGOP(unsigned int gop) {
+    auto proposedLayout = baseLayoutProvider_->tileLayoutForFrame(gop * gopLength_);
+    if (!gop || proposedLayout->numberOfTiles() == 1)
+        return proposedLayout;
+
+    auto &previousLayout = gopToLayout_.at(gop - 1);
+    if (*proposedLayout == *previousLayout)
+        return previousLayout;
+
+    auto proposedCost = costModel_->estimateCost(costEstimator_->estimateCostForGOP(gop, *proposedLayout));
+    if (isWithinTolerance(gop, *previousLayout, proposedCost))
+        return previousLayout;
+
+    if (previousLayout->numberOfTiles() == 1)
+        return proposedLayout;
+
+    auto snappedLayout = snapToLayout(*proposedLayout, *previousLayout);
+    if (snappedLayout && *snappedLayout != *proposedLayout && isWithinTolerance(gop, *snappedLayout, proposedCost))
+        return snappedLayout;
+
+    return proposedLayout;
+}
+
+bool StabilizedTileConfigurationProvider::isWithinTolerance(unsigned int gop, const TileLayout &candidate, double proposedCost) {
+    auto candidateCost = costModel_->estimateCost(costEstimator_->estimateCostForGOP(gop, candidate));
+    return candidateCost <= (1 + tolerance_) * proposedCost;
+}
+
+std::shared_ptr<TileLayout> StabilizedTileConfigurationProvider::snapToLayout(const TileLayout &layout, const TileLayout &previousLayout) const {
+    auto widths = snapDimensions(layout.widthsOfColumns(), previousLayout.widthsOfColumns(), FineGrainedTileConfigurationProvider::MinimumTileWidth);
+    auto heights = snapDimensions(layout.heightsOfRows(), previousLayout.heightsOfRows(), FineGrainedTileConfigurationProvider::MinimumTileHeight);
+    if (widths.empty() || heights.empty())
+        return nullptr;
+
+    return std::make_shared<TileLayout>(widths.size(), heights.size(), widths, heights);
+}
+
+std::vector<unsigned int> StabilizedTileConfigurationProvider::snapDimensions(const std::vector<unsigned int> &dimensions,
+                                                                             const std::vector<unsigned int> &previousDimensions,
+                                                                             unsigned int minimumDimension) const {
+    auto toOffsets = [](const std::vector<unsigned int> &dimensions) {
+        std::vector<int> offsets;
+        int offset = 0;
+        for (auto i = 0u; i + 1 < dimensions.size(); ++i) {
+            offset += dimensions[i];
+            offsets.push_back(offset);
+        }
+        return offsets;
+    };
+
+    int totalDimension = std::accumulate(dimensions.begin(), dimensions.end(), 0);
+    auto previousOffsets = toOffsets(previousDimensions);
+    auto offsets = toOffsets(dimensions);
+
+    // Move each cut to the closest cut of the previous layout if it is close enough.
+    // The previous cuts are already aligned, so snapped cuts stay aligned.
+    for (auto &offset : offsets) {
+        auto originalOffset = offset;
+        int closestDistance = snapDistance_ + 1;
+        for (auto previousOffset : previousOffsets) {
+            auto distance = std::abs(originalOffset - previousOffset);
+            if (distance < closestDistance) {
+                closestDistance = distance;
+                offset = previousOffset;
+            }
+        }
+    }
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    std::vector<unsigned int> snappedDimensions;
+    int lastOffset = 0;
+    for (auto offset : offsets) {
+        if (offset - lastOffset < static_cast<int>(minimumDimension))
+            return {};
+        snappedDimensions.push_back(offset - lastOffset);
+        lastOffset = offset;
+    }
+    if (totalDimension - lastOffset < static_cast<int>(minimumDimension))
+        return {};
+    snappedDimensions.push_back(totalDimension - lastOffset);
+
+    return snappedDimensions;
+}
+
+} // namespace tasm
@@ -0,0 +1,134 @@
+#include "TileAccessStatistics.h"
+
+#include "FileLock.h"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+namespace tasm {
+
+constexpr std::chrono::seconds TileAccessStatistics::DefaultFlushInterval;
+
+TileAccessStatistics::~TileAccessStatistics() {
+    try {
+        flush();
+    } catch (const std::exception &e) {
+        std::cout << "Failed to save tile access statistics to " << path_ << ": " << e.what() << std::endl;
+    }
+}
+
+void TileAccessStatistics::recordRead(unsigned int tileVersion, unsigned int tile, unsigned int firstFrame, unsigned long long numberOfBytes) {
+    std::scoped_lock lock(mutex_);
+    auto &counts = unflushedCounts_[{tileVersion, firstFrame / gopLength_, tile}];
+    ++counts.numberOfReads;
+    counts.numberOfBytes += numberOfBytes;
+}
+
+void TileAccessStatistics::flushIfDue() {
+    {
+        std::scoped_lock lock(mutex_);
+        if (std::chrono::steady_clock::now() - lastFlush_ < flushInterval_)
+            return;
+    }
+    flush();
+}
+
+void TileAccessStatistics::flush() {
+    std::scoped_lock flushLock(flushMutex_);
+
+    // Reads keep being recorded while the file is written.
+    TileAccessMap countsToFlush;
+    {
+        std::scoped_lock lock(mutex_);
+        lastFlush_ = std::chrono::steady_clock::now();
+        countsToFlush.swap(unflushedCounts_);
+    }
+    if (countsToFlush.empty())
+        return;
+
+    try {
+        FileLock fileLock(lockPath(path_), FileLock::Mode::Exclusive);
+        auto counts = loadFromPath(path_);
+        addCounts(counts, countsToFlush);
+        save(path_, counts);
+    } catch (...) {
+        std::scoped_lock lock(mutex_);
+        addCounts(unflushedCounts_, countsToFlush);
+        throw;
+    }
+}
+
+void TileAccessStatistics::removeVersions(const std::experimental::filesystem::path &entryPath, const std::unordered_set<unsigned int> &tileVersions) {
+    auto path = entryPath / statistics_filename_;
+    if (tileVersions.empty() || !std::experimental::filesystem::exists(path))
+        return;
+
+    FileLock fileLock(lockPath(path), FileLock::Mode::Exclusive);
+    auto counts = loadFromPath(path);
+    auto numberOfCounts = counts.size();
+    for (auto it = counts.begin(); it != counts.end();) {
+        if (tileVersions.count(it->first.tileVersion))
+            it = counts.erase(it);
+        else
+            ++it;
+    }
+    if (counts.size() != numberOfCounts)
+        save(path, counts);
+}
+
+std::experimental::filesystem::path TileAccessStatistics::lockPath(const std::experimental::filesystem::path &path) {
+    return std::experimental::filesystem::path(path).concat(".lock");
+}
+
+void TileAccessStatistics::save(const std::experimental::filesystem::path &path, const TileAccessMap &counts) {
+    // The file holds one line per tile that has been read, so rewrite it rather than appending to it.
+    static std::atomic<unsigned int> saveCount(0);
+    auto temporaryPath = path;
+    temporaryPath += ".tmp" + std::to_string(getpid()) + "-" + std::to_string(saveCount++);
+    {
+        std::ofstream output(temporaryPath, std::ios::out | std::ios::trunc);
+        for (const auto &accessAndCounts : counts) {
+            auto &access = accessAndCounts.first;
+            output << access.tileVersion << " "
+                   << access.gop << " "
+                   << access.tile << " "
+                   << accessAndCounts.second.numberOfReads << " "
+                   << accessAndCounts.second.numberOfBytes << "\n";
+        }
+        if (!output)
+            throw std::runtime_error("Failed to write tile access statistics to " + temporaryPath.string());
+    }
+    std::experimental::filesystem::rename(temporaryPath, path);
+}
+
+TileAccessMap TileAccessStatistics::accesses() const {
+    std::scoped_lock lock(flushMutex_, mutex_);
+    auto counts = loadFromPath(path_);
+    addCounts(counts, unflushedCounts_);
+    return counts;
+}
+
+TileAccessMap TileAccessStatistics::load(const std::experimental::filesystem::path &entryPath) {
+    return loadFromPath(entryPath / statistics_filename_);
+}
+
+TileAccessMap TileAccessStatistics::loadFromPath(const std::experimental::filesystem::path &path) {
+    TileAccessMap counts;
+    std::ifstream input(path);
+    TileAccess access;
+    TileAccessCounts accessCounts;
+    while (input >> access.tileVersion >> access.gop >> access.tile >> accessCounts.numberOfReads >> accessCounts.numberOfBytes)
+        counts[access] = accessCounts;
+    return counts;
+}
+
+void TileAccessStatistics::addCounts(TileAccessMap &counts, const TileAccessMap &countsToAdd) {
+    for (const auto &accessAndCounts : countsToAdd) {
+        auto &totals = counts[accessAndCounts.first];
+        totals.numberOfReads += accessAndCounts.second.numberOfReads;
+        totals.numberOfBytes += accessAndCounts.second.numberOfBytes;
+    }
+}
+
+} // namespace tasm
@@ -38,7 +38,7 @@ std::vector<unsigned int> FineGrainedTileConfigurationProvider::tileDimensions(c
     };
 
     auto getAlignedOffset = [](int offset, int lastOffset, bool shouldMoveBackwards) {
-        unsigned int alignment = 32;
+        unsigned int alignment = TileAlignment;
         if (!((offset - lastOffset) % alignment))
             return offset;
 
@@ -96,8 +96,11 @@ std::vector<unsigned int> FineGrainedTileConfigurationProvider::tileDimensions(c
 
 std::shared_ptr<TileLayout> FineGrainedTileConfigurationProvider::tileLayoutForFrame(unsigned int frame) {
     unsigned int tileGroupForFrame = frame / tileLayoutDuration_;
-    if (tileGroupToTileLayout_.count(tileGroupForFrame))
-        return tileGroupToTileLayout_.at(tileGroupForFrame);
+    {
+        std::scoped_lock lock(mutex_);
+        if (tileGroupToTileLayout_.count(tileGroupForFrame))
+            return tileGroupToTileLayout_.at(tileGroupForFrame);
+    }
 
     // Get rectangles that are in the tile group.
     auto firstFrameInGroup = tileGroupForFrame * tileLayoutDuration_;
@@ -110,17 +113,18 @@ std::shared_ptr<TileLayout> FineGrainedTileConfigurationProvider::tileLayoutForF
         return interval::Interval<int>(rect.x, rect.x + rect.width);
     });
     std::sort(horizontalIntervals.begin(), horizontalIntervals.end());
-    auto tileWidths = horizontalIntervals.size() ? tileDimensions(horizontalIntervals, 256, frameWidth_) : std::vector<unsigned int>({ frameWidth_ });
+    auto tileWidths = horizontalIntervals.size() ? tileDimensions(horizontalIntervals, MinimumTileWidth, frameWidth_) : std::vector<unsigned int>({ frameWidth_ });
 
     std::vector<interval::Interval<int>> verticalIntervals(rectanglesForGroup->size());
     std::transform(rectanglesForGroup->begin(), rectanglesForGroup->end(), verticalIntervals.begin(), [](Rectangle &rect) {
         return interval::Interval<int>(rect.y, rect.y + rect.height);
     });
     std::sort(verticalIntervals.begin(), verticalIntervals.end());
-    auto tileHeights = verticalIntervals.size() ? tileDimensions(verticalIntervals, 160, frameHeight_) : std::vector<unsigned int>({ frameHeight_ });
+    auto tileHeights = verticalIntervals.size() ? tileDimensions(verticalIntervals, MinimumTileHeight, frameHeight_) : std::vector<unsigned int>({ frameHeight_ });
 
-    tileGroupToTileLayout_[tileGroupForFrame] = std::make_shared<TileLayout>(tileWidths.size(), tileHeights.size(), tileWidths, tileHeights);
-    return tileGroupToTileLayout_.at(tileGroupForFrame);
+    // If another thread computed the same group in the meantime, keep its layout so every caller sees the same pointer.
+    std::scoped_lock lock(mutex_);
+    return tileGroupToTileLayout_.emplace(tileGroupForFrame, std::make_shared<TileLayout>(tileWidths.size(), tileHeights.size(), tileWidths, tileHeights)).first->second;
 }
 
 } // namespace tasm
\ No newline at end of file
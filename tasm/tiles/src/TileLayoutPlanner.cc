@@ -0,0 +1,52 @@
+#include "TileLayoutPlanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <numeric>
+
+namespace tasm {
+
+std::shared_ptr<PrecomputedTileConfigurationProvider> TileLayoutPlanner::planForFrames(std::shared_ptr<TileLayoutProvider> layoutProvider, unsigned int numberOfFrames) const {
+    std::vector<unsigned int> gops((numberOfFrames + gopLength_ - 1) / gopLength_);
+    std::iota(gops.begin(), gops.end(), 0);
+    return planForGOPs(layoutProvider, gops);
+}
+
+std::shared_ptr<PrecomputedTileConfigurationProvider> TileLayoutPlanner::planForGOPs(std::shared_ptr<TileLayoutProvider> layoutProvider, const std::vector<unsigned int> &gops) const {
+    unsigned int maxGOP = gops.empty() ? 0 : *std::max_element(gops.begin(), gops.end());
+    std::vector<std::shared_ptr<TileLayout>> gopToLayout(gops.empty() ? 0 : maxGOP + 1);
+
+    // Each worker takes the next unplanned GOP, so slow GOPs don't hold up the others.
+    // Each worker only writes to its own GOPs' slots, so the results don't need to be locked.
+    std::atomic<unsigned int> nextGOPIndex(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto planGOPs = [&]() {
+        for (auto index = nextGOPIndex++; index < gops.size(); index = nextGOPIndex++) {
+            try {
+                gopToLayout[gops[index]] = layoutProvider->tileLayoutForFrame(gops[index] * gopLength_);
+            } catch (...) {
+                std::scoped_lock lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    auto numberOfWorkers = std::min<unsigned int>(numberOfThreads_, gops.size());
+    std::vector<std::thread> workers;
+    for (auto i = 1u; i < numberOfWorkers; ++i)
+        workers.emplace_back(planGOPs);
+    planGOPs();
+    for (auto &worker : workers)
+        worker.join();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    return std::make_shared<PrecomputedTileConfigurationProvider>(layoutProvider, gopLength_, std::move(gopToLayout));
+}
+
+} // namespace tasm
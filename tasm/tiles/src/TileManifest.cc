@@ -0,0 +1,190 @@
+#include "TileManifest.h"
+
+#include "Gpac.h"
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace tasm {
+
+static auto constexpr COMMIT_RECORD = "commit";
+static auto constexpr REMOVAL_RECORD = "remove";
+
+static std::string commitRecord(const TileDirectoryRecord &directory) {
+    std::stringstream record;
+    auto &layout = directory.layout;
+    record << COMMIT_RECORD << " " << directory.firstFrame << " " << directory.lastFrame << " " << directory.tileVersion
+           << " " << layout.numberOfColumns() << " " << layout.numberOfRows();
+    for (auto width : layout.widthsOfColumns())
+        record << " " << width;
+    for (auto height : layout.heightsOfRows())
+        record << " " << height;
+    record << "\n";
+    return record.str();
+}
+
+std::unique_ptr<FileLock> TileManifest::lock(FileLock::Mode mode) const {
+    return std::make_unique<FileLock>(TileFiles::tileManifestLockFilename(entryPath_), mode);
+}
+
+void TileManifest::recordCommit(unsigned int firstFrame, unsigned int lastFrame, unsigned int tileVersion, const TileLayout &layout) {
+    recordCommit(firstFrame, lastFrame, tileVersion, layout, *lock(FileLock::Mode::Exclusive));
+}
+
+void TileManifest::recordCommit(unsigned int firstFrame, unsigned int lastFrame, unsigned int tileVersion, const TileLayout &layout, const FileLock &exclusiveLock) {
+    // Entries stored before manifests existed get one that lists their earlier directories too.
+    if (!std::experimental::filesystem::exists(path_)) {
+        rebuild(exclusiveLock);
+        return;
+    }
+
+    append(commitRecord({firstFrame, lastFrame, tileVersion, layout}), exclusiveLock);
+}
+
+void TileManifest::recordRemoval(unsigned int tileVersion) {
+    append(std::string(REMOVAL_RECORD) + " " + std::to_string(tileVersion) + "\n", *lock(FileLock::Mode::Exclusive));
+}
+
+void TileManifest::append(const std::string &record, const FileLock &exclusiveLock) {
+    assert(exclusiveLock.mode() == FileLock::Mode::Exclusive);
+
+    // Write each record with a single call so that a crash can only leave the last line incomplete.
+    std::ofstream output(path_, std::ios::out | std::ios::app);
+    output.write(record.data(), record.size());
+    output.flush();
+    if (!output)
+        throw std::runtime_error("Failed to append to tile manifest " + path_.string());
+}
+
+std::optional<std::vector<TileDirectoryRecord>> TileManifest::load() const {
+    return load(*lock(FileLock::Mode::Shared));
+}
+
+std::optional<std::vector<TileDirectoryRecord>> TileManifest::load(const FileLock &) const {
+    std::ifstream input(path_);
+    if (!input)
+        return {};
+
+    std::stringstream contents;
+    contents << input.rdbuf();
+    auto manifest = contents.str();
+
+    // An incomplete last record means the manifest can't be trusted.
+    if (!manifest.empty() && manifest.back() != '\n')
+        return {};
+
+    std::map<unsigned int, TileDirectoryRecord> versionToDirectory;
+    std::istringstream lines(manifest);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream record(line);
+        std::string type;
+        record >> type;
+        if (type == COMMIT_RECORD) {
+            unsigned int firstFrame, lastFrame, tileVersion, numberOfColumns, numberOfRows;
+            if (!(record >> firstFrame >> lastFrame >> tileVersion >> numberOfColumns >> numberOfRows))
+                return {};
+
+            std::vector<unsigned int> widths(numberOfColumns);
+            std::vector<unsigned int> heights(numberOfRows);
+            for (auto &width : widths)
+                record >> width;
+            for (auto &height : heights)
+                record >> height;
+            if (!record)
+                return {};
+
+            versionToDirectory.erase(tileVersion);
+            versionToDirectory.emplace(tileVersion, TileDirectoryRecord{firstFrame, lastFrame, tileVersion, TileLayout(numberOfColumns, numberOfRows, widths, heights)});
+        } else if (type == REMOVAL_RECORD) {
+            unsigned int tileVersion;
+            if (!(record >> tileVersion))
+                return {};
+            versionToDirectory.erase(tileVersion);
+        } else
+            return {};
+    }
+
+    std::vector<TileDirectoryRecord> directories;
+    directories.reserve(versionToDirectory.size());
+    for (auto &versionAndDirectory : versionToDirectory)
+        directories.push_back(std::move(versionAndDirectory.second));
+    return directories;
+}
+
+std::vector<TileDirectoryRecord> TileManifest::rebuild() {
+    return rebuild(*lock(FileLock::Mode::Exclusive));
+}
+
+std::vector<TileDirectoryRecord> TileManifest::rebuild(const FileLock &exclusiveLock) {
+    std::map<unsigned int, TileDirectoryRecord> versionToDirectory;
+    for (auto &dir : std::experimental::filesystem::directory_iterator(entryPath_)) {
+        if (!std::experimental::filesystem::is_directory(dir.status()))
+            continue;
+
+        // Directories without metadata were never committed.
+        auto tileDirectoryPath = dir.path();
+        auto metadataPath = TileFiles::tileMetadataFilename(tileDirectoryPath);
+        if (!std::experimental::filesystem::exists(metadataPath))
+            continue;
+
+        auto firstAndLastFrame = TileFiles::firstAndLastFramesFromPath(tileDirectoryPath);
+        auto tileVersion = TileFiles::tileVersionFromPath(tileDirectoryPath);
+        versionToDirectory.erase(tileVersion);
+        versionToDirectory.emplace(tileVersion, TileDirectoryRecord{firstAndLastFrame.first, firstAndLastFrame.second, tileVersion, gpac::load_tile_configuration(metadataPath)});
+    }
+
+    std::vector<TileDirectoryRecord> directories;
+    directories.reserve(versionToDirectory.size());
+    for (auto &versionAndDirectory : versionToDirectory)
+        directories.push_back(std::move(versionAndDirectory.second));
+
+    write(directories, exclusiveLock);
+    return directories;
+}
+
+std::vector<TileDirectoryRecord> TileManifest::loadOrRebuild() {
+    return snapshot().directories;
+}
+
+TileManifestSnapshot TileManifest::snapshot() {
+    {
+        auto sharedLock = lock(FileLock::Mode::Shared);
+        if (auto directories = load(*sharedLock))
+            return stamp(std::move(*directories));
+    }
+
+    // Another process may have rebuilt the manifest while waiting for the exclusive lock.
+    auto exclusiveLock = lock(FileLock::Mode::Exclusive);
+    if (auto directories = load(*exclusiveLock))
+        return stamp(std::move(*directories));
+
+    std::cout << "Rebuilding tile manifest " << path_ << std::endl;
+    return stamp(rebuild(*exclusiveLock));
+}
+
+TileManifestSnapshot TileManifest::stamp(std::vector<TileDirectoryRecord> directories) const {
+    // Only called while the lock is held, so nothing has changed the manifest since the directories were read.
+    std::error_code error;
+    auto size = std::experimental::filesystem::file_size(path_, error);
+    auto writeTime = std::experimental::filesystem::last_write_time(path_, error);
+    return {std::move(directories), error ? 0 : size, writeTime};
+}
+
+void TileManifest::write(const std::vector<TileDirectoryRecord> &directories, const FileLock &exclusiveLock) {
+    assert(exclusiveLock.mode() == FileLock::Mode::Exclusive);
+    auto temporaryPath = path_;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::out | std::ios::trunc);
+        for (const auto &directory : directories)
+            output << commitRecord(directory);
+        if (!output)
+            throw std::runtime_error("Failed to write tile manifest " + temporaryPath.string());
+    }
+    std::experimental::filesystem::rename(temporaryPath, path_);
+}
+
+} // namespace tasm
@@ -0,0 +1,17 @@
+#include "TileReaderLease.h"
+
+#include "Files.h"
+
+namespace tasm {
+
+TileReaderLease::TileReaderLease(const std::experimental::filesystem::path &entryPath)
+    : lock_(std::make_unique<FileLock>(TileFiles::tileReadersLockFilename(entryPath), FileLock::Mode::Shared)) {}
+
+std::unique_ptr<TileReaderLease> TileReaderLease::tryAcquireExclusive(const std::experimental::filesystem::path &entryPath) {
+    auto lock = FileLock::tryLock(TileFiles::tileReadersLockFilename(entryPath), FileLock::Mode::Exclusive);
+    if (!lock)
+        return nullptr;
+    return std::unique_ptr<TileReaderLease>(new TileReaderLease(std::move(lock)));
+}
+
+} // namespace tasm
@@ -0,0 +1,58 @@
+#include "TileSizeEstimator.h"
+
+#include "Files.h"
+#include "MP4Reader.h"
+#include "TiledVideoManager.h"
+
+namespace tasm {
+
+unsigned long long TileSizeEstimator::estimateBytesForRegion(const Rectangle &region, unsigned int firstFrame, unsigned int lastFrameInclusive) {
+    std::scoped_lock lock(mutex_);
+
+    double totalBytes = 0;
+    for (auto frame = firstFrame; frame <= lastFrameInclusive; ++frame) {
+        auto &storedLayout = storedLayoutForFrame(frame);
+        for (auto tile = 0u; tile < storedLayout.layout->numberOfTiles(); ++tile) {
+            auto tileRectangle = storedLayout.layout->rectangleForTile(tile);
+            if (!tileRectangle.intersects(region) || !tileRectangle.area())
+                continue;
+
+            auto &sampleSizes = sampleSizesForTile(locationOfTile(storedLayout, tile));
+            auto sampleIndex = frame - storedLayout.firstFrame;
+            if (sampleIndex >= sampleSizes.size())
+                continue;
+
+            double overlap = static_cast<double>(tileRectangle.overlappingRectangle(region).area()) / tileRectangle.area();
+            totalBytes += std::min(overlap, 1.0) * sampleSizes[sampleIndex];
+        }
+    }
+    return static_cast<unsigned long long>(totalBytes);
+}
+
+const TileSizeEstimator::StoredLayout &TileSizeEstimator::storedLayoutForFrame(unsigned int frame) {
+    auto cached = frameToStoredLayout_.find(frame);
+    if (cached != frameToStoredLayout_.end())
+        return cached->second;
+
+    if (!tiledVideoManager_)
+        return frameToStoredLayout_[frame] = {-1, untiledLayout_, 0};
+
+    auto layoutId = tiledVideoManager_->tileLayoutIdForFrame(frame);
+    auto firstFrameInDirectory = TileFiles::firstAndLastFramesFromPath(tiledVideoManager_->locationOfTileForId(0, layoutId).parent_path()).first;
+    return frameToStoredLayout_[frame] = {layoutId, tiledVideoManager_->tileLayoutForId(layoutId), firstFrameInDirectory};
+}
+
+std::experimental::filesystem::path TileSizeEstimator::locationOfTile(const StoredLayout &storedLayout, unsigned int tile) const {
+    return tiledVideoManager_ ? tiledVideoManager_->locationOfTileForId(tile, storedLayout.id) : untiledVideo_;
+}
+
+const std::vector<unsigned int> &TileSizeEstimator::sampleSizesForTile(const std::experimental::filesystem::path &tilePath) {
+    auto key = tilePath.string();
+    auto cached = tilePathToSampleSizes_.find(key);
+    if (cached != tilePathToSampleSizes_.end())
+        return cached->second;
+
+    return tilePathToSampleSizes_[key] = MP4Reader(tilePath).sampleSizes();
+}
+
+} // namespace tasm
@@ -1,43 +1,32 @@
 #include "TiledVideoManager.h"
 
 #include "Files.h"
-#include "Gpac.h"
+#include "TileManifest.h"
+#include <numeric>
 
 namespace tasm {
 
 void TiledVideoManager::loadAllTileConfigurations() {
     std::scoped_lock lock(mutex_);
 
-    // Get directory path from entry_.
-    auto &catalogEntryPath = entry_->path();
+    // The manifest lists every committed directory with its layout, so the directories themselves aren't read.
+    // The snapshot is read under the manifest's lock, so it contains whole commits only, and the manager keeps using it
+    // even as later commits are published.
+    auto snapshot = TileManifest(entry_->path()).snapshot();
+    manifestSize_ = snapshot.size;
+    manifestWriteTime_ = snapshot.writeTime;
+    auto &directories = snapshot.directories;
 
-    // Read all directory names.
-    int globalDirId = 0;
     std::vector<IntervalEntry<unsigned int>> directoryIntervals;
-    unsigned int lowerBound = INT32_MAX;
-    unsigned int upperBound = 0;
 
-    for (auto &dir : std::experimental::filesystem::directory_iterator(catalogEntryPath)) {
-//        if (!dir.is_directory())
-        if (!std::experimental::filesystem::is_directory(dir.status()))
-            continue;
+    for (auto &directory : directories) {
+        // Each commit has its own version, so the version identifies the directory.
+        int dirId = directory.tileVersion;
+        directoryIntervals.emplace_back(directory.firstFrame, directory.lastFrame, dirId);
+        if (directory.lastFrame > maximumFrame_)
+            maximumFrame_ = directory.lastFrame;
 
-        auto dirId = globalDirId++;
-        auto tileDirectoryPath = dir.path();
-        // Parse frame range from path.
-        auto firstAndLastFrame = TileFiles::firstAndLastFramesFromPath(tileDirectoryPath);
-        auto tileVersion = TileFiles::tileVersionFromPath(tileDirectoryPath);
-        dirId = tileVersion;
-
-        directoryIntervals.emplace_back(firstAndLastFrame.first, firstAndLastFrame.second, dirId);
-        if (firstAndLastFrame.second > maximumFrame_)
-            maximumFrame_ = firstAndLastFrame.second;
-
-        lowerBound = std::min(lowerBound, firstAndLastFrame.first);
-        upperBound = std::max(upperBound, firstAndLastFrame.second);
-
-        // Find the tile-metadata file in this directory, and load the tile layout from it.
-        TileLayout tileLayout = gpac::load_tile_configuration(TileFiles::tileMetadataFilename(tileDirectoryPath));
+        auto &tileLayout = directory.layout;
 
         // All of the layouts should have the same total width and total height.
         if (!totalWidth_) {
@@ -52,26 +41,60 @@ void TiledVideoManager::loadAllTileConfigurations() {
             tileLayoutReferences_[tileLayout] = std::make_shared<TileLayout>(tileLayout);
 
         directoryIdToTileLayout_[dirId] = tileLayoutReferences_.at(tileLayout);
-        directoryIdToTileDirectory_[dirId] = tileDirectoryPath;
+        directoryIdToTileDirectory_[dirId] = TileFiles::directoryForTilesInFrames(entry_->path(), directory.firstFrame, directory.lastFrame, directory.tileVersion);
     }
 
-    intervalTree_ = IntervalTree<unsigned int>(lowerBound, upperBound, directoryIntervals);
+    layoutIndex_ = LatestIntervalIndex<unsigned int>(directoryIntervals);
+    buildFrameLocations();
 }
 
-std::vector<int> TiledVideoManager::tileLayoutIdsForFrame(unsigned int frameNumber) const {
-    std::scoped_lock lock(mutex_);
+void TiledVideoManager::buildFrameLocations() {
+    std::unordered_map<int, unsigned int> idToDirectoryIndex;
+    directories_.reserve(directoryIdToTileDirectory_.size());
+    for (const auto &idAndDirectory : directoryIdToTileDirectory_) {
+        auto id = idAndDirectory.first;
+        auto layout = directoryIdToTileLayout_.at(id);
+        TileDirectory directory{id, layout, idAndDirectory.second, {}};
+        directory.tilePaths.reserve(layout->numberOfTiles());
+        for (auto tile = 0u; tile < layout->numberOfTiles(); ++tile)
+            directory.tilePaths.push_back(TileFiles::tileFilename(directory.path, tile));
+
+        idToDirectoryIndex[id] = directories_.size();
+        directories_.push_back(std::move(directory));
+    }
+
+    // Use the largest granularity that every run's boundaries are aligned to.
+    auto &runs = layoutIndex_.segments();
+    unsigned int granularity = 0;
+    for (const auto &run : runs)
+        granularity = std::gcd(granularity, std::gcd(run.first, run.last + 1));
+    framesPerLocation_ = std::max(granularity, 1u);
+
+    frameLocations_.assign(runs.empty() ? 0 : runs.back().last / framesPerLocation_ + 1, {nullptr, 0});
+    for (const auto &run : runs) {
+        const TileDirectory *directory = &directories_[idToDirectoryIndex.at(run.id)];
+        for (auto i = run.first / framesPerLocation_; i <= run.last / framesPerLocation_; ++i)
+            frameLocations_[i] = {directory, run.last};
+    }
+}
+
+bool TiledVideoManager::isCurrent() const {
+    std::error_code sizeError;
+    std::error_code timeError;
+    auto manifestPath = TileFiles::tileManifestFilename(entry_->path());
+    auto size = std::experimental::filesystem::file_size(manifestPath, sizeError);
+    auto writeTime = std::experimental::filesystem::last_write_time(manifestPath, timeError);
 
-    // Find the intervals that contain the frame number, and splice their lists together.
-    std::vector<IntervalEntry<unsigned int>> overlappingIntervals;
-    intervalTree_.query(frameNumber, overlappingIntervals);
+    std::scoped_lock lock(mutex_);
+    return !sizeError && !timeError && size == manifestSize_ && writeTime == manifestWriteTime_;
+}
 
-    std::vector<int> layoutIds(overlappingIntervals.size());
-    std::transform(overlappingIntervals.begin(), overlappingIntervals.end(), layoutIds.begin(), [](const auto &intervalEntry) {
-        return intervalEntry.id();
-    });
+int TiledVideoManager::tileLayoutIdForFrame(unsigned int frameNumber) const {
+    return locationForFrame(frameNumber).directory->id;
+}
 
-    assert(!layoutIds.empty());
-    return layoutIds;
+std::vector<TiledVideoManager::TileLayoutRun> TiledVideoManager::tileLayoutRunsForFrames(unsigned int firstFrame, unsigned int lastFrameExclusive) const {
+    return layoutIndex_.segmentsInRange(firstFrame, lastFrameExclusive);
 }
 
 std::experimental::filesystem::path TiledVideoManager::locationOfTileForId(unsigned int tileNumber, int id) const {
@@ -79,4 +102,18 @@ std::experimental::filesystem::path TiledVideoManager::locationOfTileForId(unsig
     return TileFiles::tileFilename(directoryIdToTileDirectory_.at(id), tileNumber);
 }
 
+std::experimental::filesystem::path TiledVideoManager::directoryForId(int id) const {
+    std::scoped_lock lock(mutex_);
+    return directoryIdToTileDirectory_.at(id);
+}
+
+std::vector<int> TiledVideoManager::tileLayoutIds() const {
+    std::scoped_lock lock(mutex_);
+    std::vector<int> ids;
+    ids.reserve(directoryIdToTileDirectory_.size());
+    for (const auto &idAndDirectory : directoryIdToTileDirectory_)
+        ids.push_back(idAndDirectory.first);
+    return ids;
+}
+
 } // namespace tasm
\ No newline at end of file
@@ -6,7 +6,7 @@ namespace tasm {
 
 
 std::ostream &operator<<(std::ostream &ostr, const CostElements &c) {
-    ostr << "num_pixels: " << c.numPixels << ", num_tiles: " << c.numTiles << "\n";
+    ostr << "num_pixels: " << c.numPixels << ", num_tiles: " << c.numTiles << ", num_bytes: " << c.numBytes << ", num_files: " << c.numFiles << "\n";
     return ostr;
 }
 
@@ -15,20 +15,20 @@ CostElements WorkloadCostEstimator::estimateCostForQuery(unsigned int queryNum,
     auto start = semanticDataManager->orderedFrames().begin();
     auto end = semanticDataManager->orderedFrames().end();
 
-    unsigned long long totalNumberOfPixels = 0;
-    unsigned long long totalNumberOfTiles = 0;
-
+    CostElements totalCosts(0, 0);
     while (start != end) {
         auto costElements = estimateCostForNextGOP(start, end, semanticDataManager);
-        totalNumberOfPixels += costElements.second.numPixels;
-        totalNumberOfTiles += costElements.second.numTiles;
+        totalCosts.add(costElements.second);
 
         if (costByGOP)
             costByGOP->emplace(costElements);
     }
 
     auto multiplier = workload_->numberOfTimesQueryIsExecuted(queryNum);
-    return CostElements(multiplier * totalNumberOfPixels, multiplier * totalNumberOfTiles);
+    return CostElements(multiplier * totalCosts.numPixels,
+                        multiplier * totalCosts.numTiles,
+                        multiplier * totalCosts.numBytes,
+                        multiplier * totalCosts.numFiles);
 }
 
 CostElements WorkloadCostEstimator::estimateCostForWorkload() {
@@ -47,8 +47,33 @@ std::pair<int, CostElements> WorkloadCostEstimator::estimateCostForNextGOP(std::
         return std::make_pair(-1, CostElements(0, 0));
 
     auto gopNum = gopForFrame(*currentFrame);
-    auto keyframe = keyframeForFrame(*currentFrame);
     auto layoutForGOP = tileLayoutProvider_->tileLayoutForFrame(*currentFrame);
+    return std::make_pair(gopNum, estimateCostForFramesInGOP(currentFrame, end, *layoutForGOP, metadataManager));
+}
+
+CostElements WorkloadCostEstimator::estimateCostForGOP(unsigned int gop, const TileLayout &layout) {
+    CostElements results(0, 0);
+    for (auto i = 0u; i < workload_->numberOfQueries(); ++i) {
+        auto semanticDataManager = workload_->semanticDataManagerForQuery(i);
+        auto &orderedFrames = semanticDataManager->orderedFrames();
+        std::vector<int>::const_iterator start = std::lower_bound(orderedFrames.begin(), orderedFrames.end(), static_cast<int>(gop * gopLength_));
+        if (start == orderedFrames.end() || gopForFrame(*start) != gop)
+            continue;
+
+        auto costs = estimateCostForFramesInGOP(start, orderedFrames.end(), layout, semanticDataManager);
+        auto multiplier = workload_->numberOfTimesQueryIsExecuted(i);
+        results.add(CostElements(multiplier * costs.numPixels, multiplier * costs.numTiles, multiplier * costs.numBytes, multiplier * costs.numFiles));
+    }
+    return results;
+}
+
+CostElements WorkloadCostEstimator::estimateCostForFramesInGOP(std::vector<int>::const_iterator &currentFrame,
+                                                               std::vector<int>::const_iterator end,
+                                                               const TileLayout &layout,
+                                                               std::shared_ptr<SemanticDataManager> metadataManager) {
+    auto gopNum = gopForFrame(*currentFrame);
+    auto keyframe = keyframeForFrame(*currentFrame);
+    auto *layoutForGOP = &layout;
 
     // Find the frames that have an object overlapping the tiles.
     auto numberOfTiles = layoutForGOP->numberOfTiles();
@@ -68,6 +93,8 @@ std::pair<int, CostElements> WorkloadCostEstimator::estimateCostForNextGOP(std::
 
     unsigned int totalNumPixels = 0;
     unsigned int totalNumTiles = 0;
+    unsigned long long totalNumBytes = 0;
+    unsigned int totalNumFiles = 0;
     for (auto i = 0u; i < numberOfTiles; ++i) {
         if (maxFrameOverlappingTile[i] < 0)
             continue;
@@ -75,8 +102,13 @@ std::pair<int, CostElements> WorkloadCostEstimator::estimateCostForNextGOP(std::
         unsigned int numTiles = maxFrameOverlappingTile[i] - keyframe + 1;
         totalNumTiles += numTiles;
         totalNumPixels += layoutForGOP->rectangleForTile(i).area() * numTiles;
+
+        // Each tile is stored in its own file, and decoding it requires reading from the keyframe onwards.
+        ++totalNumFiles;
+        if (tileSizeEstimator_)
+            totalNumBytes += tileSizeEstimator_->estimateBytesForRegion(layoutForGOP->rectangleForTile(i), keyframe, maxFrameOverlappingTile[i]);
     }
-    return std::make_pair(gopNum, CostElements(totalNumPixels, totalNumTiles));
+    return CostElements(totalNumPixels, totalNumTiles, totalNumBytes, totalNumFiles);
 }
 
 } // namespace tasm
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef TASM_FILELOCK_H
+#define TASM_FILELOCK_H
+
+#include <experimental/filesystem>
+#include <memory>
+
+namespace tasm {
+
+// An advisory lock on a file, held until the lock is destroyed. The file is created if it doesn't exist.
+// Each lock opens the file itself, so locks exclude each other across threads of one process as well as across processes.
+class FileLock {
+public:
+    enum class Mode {
+        Shared,
+        Exclusive,
+    };
+
+    // Waits until the lock can be taken.
+    FileLock(const std::experimental::filesystem::path &path, Mode mode);
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock &operator=(const FileLock&) = delete;
+
+    Mode mode() const { return mode_; }
+
+    // Returns nullptr instead of waiting if the lock is held in a conflicting mode.
+    static std::unique_ptr<FileLock> tryLock(const std::experimental::filesystem::path &path, Mode mode);
+
+private:
+    FileLock(int fileDescriptor, Mode mode)
+        : fileDescriptor_(fileDescriptor),
+        mode_(mode) {}
+
+    static int openLockFile(const std::experimental::filesystem::path &path);
+    static int operation(Mode mode);
+
+    int fileDescriptor_;
+    Mode mode_;
+};
+
+} // namespace tasm
+
+#endif //TASM_FILELOCK_H
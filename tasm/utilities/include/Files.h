@@ -7,6 +7,10 @@ namespace tasm {
 
 class TileFiles {
 public:
+    // The version of the first directory a video is stored into. Re-tiling decodes frames from it, so it is never
+    // removed, merged or packed.
+    static constexpr unsigned int OriginalTileVersion = 0;
+
     static std::experimental::filesystem::path tileVersionFilename(const std::experimental::filesystem::path &path) {
         return path / tile_version_filename_;
     }
@@ -15,29 +19,60 @@ public:
         return path / tile_metadata_filename_;
     }
 
-    static std::experimental::filesystem::path directoryForTilesInFrames(const TiledEntry &entry, unsigned int firstFrame,
-                                                           unsigned int lastFrame) {
-        return entry.path()  / (std::to_string(firstFrame) + separating_string_ + std::to_string(lastFrame) + separating_string_ + std::to_string(entry.tile_version()));
+    static std::experimental::filesystem::path gopLengthFilename(const std::experimental::filesystem::path &path) {
+        return path / gop_length_filename_;
+    }
+
+    static std::experimental::filesystem::path tileManifestFilename(const std::experimental::filesystem::path &path) {
+        return path / tile_manifest_filename_;
+    }
+
+    static std::experimental::filesystem::path tileVersionLockFilename(const std::experimental::filesystem::path &path) {
+        return path / tile_version_lock_filename_;
+    }
+
+    static std::experimental::filesystem::path tileManifestLockFilename(const std::experimental::filesystem::path &path) {
+        return path / tile_manifest_lock_filename_;
+    }
+
+    static std::experimental::filesystem::path tileReadersLockFilename(const std::experimental::filesystem::path &path) {
+        return path / tile_readers_lock_filename_;
+    }
+
+    static std::experimental::filesystem::path tileWritersLockFilename(const std::experimental::filesystem::path &path) {
+        return path / tile_writers_lock_filename_;
     }
 
-    static std::experimental::filesystem::path temporaryTileFilename(const TiledEntry &entry, unsigned int tileNumber,
-                                                       unsigned int firstFrame,
-                                                       unsigned int lastFrame) {
-        auto tempName = directoryForTilesInFrames(entry, firstFrame, lastFrame) / (baseTileFilename(tileNumber) +
-                                                                          temporaryFilenameExtension());
-        return tempName;
+    static std::experimental::filesystem::path directoryForTilesInFrames(const std::experimental::filesystem::path &entryPath,
+                                                           unsigned int firstFrame,
+                                                           unsigned int lastFrame,
+                                                           unsigned int tileVersion) {
+        return entryPath / (std::to_string(firstFrame) + separating_string_ + std::to_string(lastFrame) + separating_string_ + std::to_string(tileVersion));
+    }
+
+    // Where a transaction writes its tiles until it knows the last frame they hold.
+    static std::experimental::filesystem::path pendingDirectoryForTiles(const std::experimental::filesystem::path &entryPath,
+                                                           unsigned int firstFrame,
+                                                           unsigned int tileVersion) {
+        return entryPath / (std::to_string(firstFrame) + separating_string_ + pending_string_ + separating_string_ + std::to_string(tileVersion));
     }
 
     static std::experimental::filesystem::path tileFilename(const std::experimental::filesystem::path &directoryPath, unsigned int tileNumber) {
         return directoryPath / (baseTileFilename(tileNumber) + muxedFilenameExtension());
     }
 
-    static std::string muxedFilenameExtension() {
-        return ".mp4";
+    // Held by the transaction writing the directory until it commits or aborts. A directory without metadata whose lock
+    // is free was left behind by a transaction that is gone.
+    static std::experimental::filesystem::path transactionLockFilename(const std::experimental::filesystem::path &directoryPath) {
+        return directoryPath / transaction_lock_filename_;
+    }
+
+    static std::experimental::filesystem::path tilePackFilename(const std::experimental::filesystem::path &directoryPath) {
+        return directoryPath / tile_pack_filename_;
     }
 
-    static std::experimental::filesystem::path tileMetadataFilename(const TiledEntry &entry, unsigned int firstFrame, unsigned lastFrame) {
-        return directoryForTilesInFrames(entry, firstFrame, lastFrame) / tile_metadata_filename_;
+    static std::string muxedFilenameExtension() {
+        return ".mp4";
     }
 
     static std::pair<unsigned int, unsigned int> firstAndLastFramesFromPath(const std::experimental::filesystem::path &directoryPath) {
@@ -63,18 +98,29 @@ public:
         return std::stoul(directoryName.substr(lastSeparator+1));
     }
 
-private:
-    static std::string temporaryFilenameExtension() {
-        return ".hevc";
+    static unsigned int tileNumberFromPath(const std::experimental::filesystem::path &tilePath) {
+        std::string tileName = tilePath.stem();
+        auto lastSeparator = tileName.rfind(separating_string_);
+        return std::stoul(tileName.substr(lastSeparator+1));
     }
 
+private:
     static std::string baseTileFilename(unsigned int tileNumber) {
         return "orig-tile-" + std::to_string(tileNumber);
     }
 
     static constexpr auto tile_version_filename_ = "tile-version";
     static constexpr auto tile_metadata_filename_ = "tile-metadata.bin";
+    static constexpr auto tile_pack_filename_ = "tiles.pack";
+    static constexpr auto gop_length_filename_ = "gop-length";
+    static constexpr auto tile_manifest_filename_ = "tile-manifest";
+    static constexpr auto tile_version_lock_filename_ = "tile-version.lock";
+    static constexpr auto tile_manifest_lock_filename_ = "tile-manifest.lock";
+    static constexpr auto tile_readers_lock_filename_ = "tile-readers.lock";
+    static constexpr auto tile_writers_lock_filename_ = "tile-writers.lock";
+    static constexpr auto transaction_lock_filename_ = "transaction.lock";
     static constexpr auto separating_string_ = "-";
+    static constexpr auto pending_string_ = "pending";
 };
 
 } // namespace tasm
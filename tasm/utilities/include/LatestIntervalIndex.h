@@ -0,0 +1,127 @@
+#ifndef TASM_LATESTINTERVALINDEX_H
+#define TASM_LATESTINTERVALINDEX_H
+
+#include <algorithm>
+#include <cassert>
+#include <set>
+#include <vector>
+
+namespace tasm {
+
+template <typename T>
+class IntervalEntry {
+public:
+    IntervalEntry() {}
+    IntervalEntry(T l, T r, int id)
+            : l_(l), r_(r), id_(id) {}
+
+    const T &l() const { return l_; }
+    const T &r() const { return r_; }
+    const int &id() const { return id_; }
+private:
+    T l_;
+    T r_;
+    int id_;
+};
+
+// For each point, the id of the latest (largest id) interval that covers it.
+// The intervals are resolved once into sorted, non-overlapping segments, so a point lookup is a binary search
+// and a range lookup is a binary search followed by a scan over the segments it covers.
+// Intervals include both of their end points, like IntervalEntry.
+template <typename T>
+class LatestIntervalIndex {
+public:
+    struct Segment {
+        T first;
+        T last;
+        int id;
+
+        bool operator==(const Segment &other) const {
+            return first == other.first && last == other.last && id == other.id;
+        }
+    };
+
+    LatestIntervalIndex() {}
+
+    explicit LatestIntervalIndex(const std::vector<IntervalEntry<T>> &intervals) {
+        // Sweep over the interval boundaries, keeping the ids of the intervals that cover the current point.
+        struct Boundary {
+            T point;
+            bool isStart;
+            int id;
+        };
+        std::vector<Boundary> boundaries;
+        boundaries.reserve(2 * intervals.size());
+        for (const auto &interval : intervals) {
+            assert(interval.l() <= interval.r());
+            boundaries.push_back({interval.l(), true, interval.id()});
+            boundaries.push_back({interval.r() + 1, false, interval.id()});
+        }
+        std::sort(boundaries.begin(), boundaries.end(), [](const Boundary &a, const Boundary &b) {
+            return a.point < b.point;
+        });
+
+        std::multiset<int> coveringIds;
+        for (auto it = boundaries.begin(); it != boundaries.end();) {
+            auto point = it->point;
+            for (; it != boundaries.end() && it->point == point; ++it) {
+                if (it->isStart)
+                    coveringIds.insert(it->id);
+                else
+                    coveringIds.erase(coveringIds.find(it->id));
+            }
+
+            if (coveringIds.empty() || it == boundaries.end())
+                continue;
+
+            auto id = *coveringIds.rbegin();
+            T last = it->point - 1;
+            if (!segments_.empty() && segments_.back().id == id && segments_.back().last + 1 == point)
+                segments_.back().last = last;
+            else
+                segments_.push_back({point, last, id});
+        }
+    }
+
+    // Returns false if no interval covers the point.
+    bool idForPoint(T point, int &id) const {
+        auto segment = segmentContaining(point);
+        if (segment == segments_.end())
+            return false;
+
+        id = segment->id;
+        return true;
+    }
+
+    // The segments that cover points in [first, lastExclusive), clipped to the range, in order.
+    std::vector<Segment> segmentsInRange(T first, T lastExclusive) const {
+        std::vector<Segment> segments;
+        auto it = std::upper_bound(segments_.begin(), segments_.end(), first, [](T point, const Segment &segment) {
+            return point < segment.first;
+        });
+        if (it != segments_.begin() && std::prev(it)->last >= first)
+            --it;
+
+        for (; it != segments_.end() && it->first < lastExclusive; ++it)
+            segments.push_back({std::max(it->first, first), std::min<T>(it->last, lastExclusive - 1), it->id});
+        return segments;
+    }
+
+    const std::vector<Segment> &segments() const { return segments_; }
+
+private:
+    typename std::vector<Segment>::const_iterator segmentContaining(T point) const {
+        auto it = std::upper_bound(segments_.begin(), segments_.end(), point, [](T point, const Segment &segment) {
+            return point < segment.first;
+        });
+        if (it == segments_.begin() || std::prev(it)->last < point)
+            return segments_.end();
+        return std::prev(it);
+    }
+
+    std::vector<Segment> segments_;
+};
+
+} // namespace tasm
+
+#endif //TASM_LATESTINTERVALINDEX_H
@@ -1,7 +1,9 @@
 #ifndef TASM_TRANSACTION_H
 #define TASM_TRANSACTION_H
 
+#include "FileLock.h"
 #include "Files.h"
+#include "MP4Writer.h"
 #include "TileLayout.h"
 #include "Video.h"
 #include <mutex>
@@ -11,20 +13,23 @@ class OutputStream {
 public:
     OutputStream(const Transaction &transaction,
                  const tasm::TiledEntry &entry,
+                 const std::experimental::filesystem::path &directory,
                  unsigned int tileNumber,
-                 unsigned int firstFrame,
-                 unsigned int lastFrame)
+                 unsigned int frameRate)
             : transaction_(transaction),
             entry_(entry),
-              filename_(tasm::TileFiles::temporaryTileFilename(entry, tileNumber, firstFrame, lastFrame)),
+              filename_(tasm::TileFiles::tileFilename(directory, tileNumber)),
               codec_(Codec::HEVC),
-              stream_(filename_)
+              writer_(filename_, frameRate)
     { }
 
     OutputStream(const OutputStream&) = delete;
-    OutputStream(OutputStream&&) = default;
 
-    std::ofstream& stream() { return stream_; }
+    // Encoded data is muxed into the tile's mp4 as it is written.
+    void write(const char *data, size_t size) { writer_.write(data, size); }
+    void close() { writer_.close(); }
+    void abandon() { writer_.abandon(); }
+
     const std::experimental::filesystem::path &filename() const { return filename_; }
     const auto &codec() const { return codec_; }
 
@@ -33,7 +38,7 @@ protected:
     const tasm::TiledEntry &entry_;
     const std::experimental::filesystem::path filename_;
     const Codec codec_;
-    std::ofstream stream_;
+    tasm::MP4Writer writer_;
 };
 
 class Transaction {
@@ -72,30 +77,42 @@ private:
 
 class TileCrackingTransaction: public Transaction {
 public:
-    TileCrackingTransaction(std::shared_ptr<tasm::TiledEntry> entry, const tasm::TileLayout &tileLayout, int firstFrame = -1, int lastFrame = -1)
+    // Transactions hold the entry's writers lock shared from before they reserve their version until they complete.
+    // A caller that already holds it exclusively passes its lock instead.
+    TileCrackingTransaction(std::shared_ptr<tasm::TiledEntry> entry, const tasm::TileLayout &tileLayout, unsigned int frameRate,
+                            int firstFrame = -1, int lastFrame = -1, std::shared_ptr<tasm::FileLock> writersLock = nullptr)
             : Transaction(0u),
               entry_(entry),
               tileLayout_(tileLayout),
+              frameRate_(frameRate),
               firstFrame_(firstFrame),
               lastFrame_(lastFrame),
+              writersLock_(writersLock
+                      ? writersLock
+                      : std::make_shared<tasm::FileLock>(tasm::TileFiles::tileWritersLockFilename(entry->path()), tasm::FileLock::Mode::Shared)),
+              tileVersion_(entry->reserveTileVersion()),
+              directory_(lastFrame >= 0
+                      ? tasm::TileFiles::directoryForTilesInFrames(entry->path(), firstFrame, lastFrame, tileVersion_)
+                      : tasm::TileFiles::pendingDirectoryForTiles(entry->path(), firstFrame, tileVersion_)),
               complete_(false)
     {
         prepareTileDirectory();
     }
 
-    ~TileCrackingTransaction() override {
-        if (!complete_)
-            commit();
-    }
+    ~TileCrackingTransaction() override;
 
     virtual OutputStream& write(unsigned int tileNumber) {
         return outputs_.emplace_back(*this,
                                      *entry_,
+                                     directory_,
                                      tileNumber,
-                                     firstFrame_,
-                                     lastFrame_);
+                                     frameRate_);
     }
 
+    // Transactions that start before their last frame is known write to a pending directory. It is renamed for the
+    // frames it holds when the transaction commits, so the last frame must be set by then.
+    void setLastFrame(int lastFrame) { lastFrame_ = lastFrame; }
+
     void commit() override;
 
     void abort() override;
@@ -106,10 +123,20 @@ private:
 
     std::shared_ptr<tasm::TiledEntry> entry_;
     const tasm::TileLayout tileLayout_;
+    const unsigned int frameRate_;
 
     int firstFrame_;
     int lastFrame_;
 
+    // Lets compaction wait for transactions that reserved older versions than its own to commit.
+    std::shared_ptr<tasm::FileLock> writersLock_;
+
+    // Reserved when the transaction starts, so that the directory is never shared with a concurrent transaction.
+    const unsigned int tileVersion_;
+    std::experimental::filesystem::path directory_;
+    // Lets garbage collection tell this directory apart from one whose transaction is gone.
+    std::unique_ptr<tasm::FileLock> directoryLock_;
+
     bool complete_;
 };
 
@@ -0,0 +1,47 @@
+#include "FileLock.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace tasm {
+
+FileLock::FileLock(const std::experimental::filesystem::path &path, Mode mode)
+    : fileDescriptor_(openLockFile(path)),
+    mode_(mode) {
+    if (flock(fileDescriptor_, operation(mode))) {
+        auto error = errno;
+        close(fileDescriptor_);
+        throw std::runtime_error("Failed to lock " + path.string() + ": " + std::strerror(error));
+    }
+}
+
+FileLock::~FileLock() {
+    // Closing the file releases the lock.
+    close(fileDescriptor_);
+}
+
+std::unique_ptr<FileLock> FileLock::tryLock(const std::experimental::filesystem::path &path, Mode mode) {
+    std::unique_ptr<FileLock> lock(new FileLock(openLockFile(path), mode));
+    if (flock(lock->fileDescriptor_, operation(mode) | LOCK_NB)) {
+        if (errno == EWOULDBLOCK)
+            return nullptr;
+        throw std::runtime_error("Failed to lock " + path.string() + ": " + std::strerror(errno));
+    }
+    return lock;
+}
+
+int FileLock::openLockFile(const std::experimental::filesystem::path &path) {
+    auto fileDescriptor = open(path.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fileDescriptor < 0)
+        throw std::runtime_error("Failed to open " + path.string() + ": " + std::strerror(errno));
+    return fileDescriptor;
+}
+
+int FileLock::operation(Mode mode) {
+    return mode == Mode::Shared ? LOCK_SH : LOCK_EX;
+}
+
+} // namespace tasm
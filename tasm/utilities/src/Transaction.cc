@@ -1,39 +1,84 @@
 #include "Transaction.h"
 
 #include "Gpac.h"
+#include "TileManifest.h"
+#include <cassert>
 #include <iostream>
 
+TileCrackingTransaction::~TileCrackingTransaction() {
+    if (complete_)
+        return;
+
+    try {
+        if (lastFrame_ >= 0)
+            commit();
+        else
+            abort();
+    } catch (const std::exception &e) {
+        // The directory is left without metadata, so garbage collection reclaims it once this transaction is gone.
+        std::cerr << "Failed to complete the transaction for " << directory_ << ": " << e.what() << std::endl;
+    }
+}
+
 void TileCrackingTransaction::prepareTileDirectory() {
-    auto directory = tasm::TileFiles::directoryForTilesInFrames(*entry_, firstFrame_, lastFrame_);
     std::error_code error;
-    if (!std::experimental::filesystem::create_directory(directory, error))
+    if (!std::experimental::filesystem::create_directory(directory_, error)) {
         std::cerr << "Failed to create tile directory: " << error.message() << std::endl;
+        return;
+    }
+    directoryLock_ = std::make_unique<tasm::FileLock>(tasm::TileFiles::transactionLockFilename(directory_), tasm::FileLock::Mode::Exclusive);
 }
 
 void TileCrackingTransaction::abort() {
     complete_ = true;
-    for(const auto &output: outputs())
-        std::experimental::filesystem::remove(output.filename());
+    for (auto &output : outputs())
+        output.abandon();
+
+    // Nothing else is ever written to a pending directory.
+    if (lastFrame_ < 0) {
+        std::error_code error;
+        std::experimental::filesystem::remove_all(directory_, error);
+    }
+    directoryLock_.reset();
+    writersLock_.reset();
 }
 
 void TileCrackingTransaction::commit() {
     complete_ = true;
 
-    for (auto &output : outputs()) {
-        output.stream().close();
+    try {
+        // Each tile's samples are already in its mp4, so closing only writes the last sample and the moov.
+        for (auto &output : outputs())
+            output.close();
 
-        // Mux the outputs to mp4.
-        auto muxedFile = output.filename();
-        muxedFile.replace_extension(tasm::TileFiles::muxedFilenameExtension());
-        tasm::gpac::mux_media(output.filename(), muxedFile);
+        assert(lastFrame_ >= 0);
+        auto directory = tasm::TileFiles::directoryForTilesInFrames(entry_->path(), firstFrame_, lastFrame_, tileVersion_);
+        if (directory != directory_) {
+            std::experimental::filesystem::rename(directory_, directory);
+            directory_ = directory;
+        }
+    } catch (...) {
+        // The version was reserved for this transaction only, so nothing else uses its directory.
+        std::error_code error;
+        std::experimental::filesystem::remove_all(directory_, error);
+        directoryLock_.reset();
+        throw;
     }
 
+    // The directory only becomes visible to readers once it is in the manifest.
+    // Write its metadata under the same lock so that rebuilds and garbage collection never see one without the other.
+    tasm::TileManifest manifest(entry_->path());
+    auto lock = manifest.lock(tasm::FileLock::Mode::Exclusive);
     writeTileMetadata();
+    manifest.recordCommit(firstFrame_, lastFrame_, tileVersion_, tileLayout_, *lock);
 
-    entry_->incrementTileVersion();
+    // Committed directories hold only tiles and metadata.
+    std::error_code error;
+    std::experimental::filesystem::remove(tasm::TileFiles::transactionLockFilename(directory_), error);
+    directoryLock_.reset();
+    writersLock_.reset();
 }
 
 void TileCrackingTransaction::writeTileMetadata() {
-    auto metadataFilename = tasm::TileFiles::tileMetadataFilename(*entry_, firstFrame_, lastFrame_);
-    tasm::gpac::write_tile_configuration(metadataFilename, tileLayout_);
+    tasm::gpac::write_tile_configuration(tasm::TileFiles::tileMetadataFilename(directory_), tileLayout_);
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef TASM_COSTMODELCALIBRATION_H
+#define TASM_COSTMODELCALIBRATION_H
+
+#include "CostModel.h"
+#include "GPUContext.h"
+#include "VideoLock.h"
+#include "WorkloadCostEstimator.h"
+#include <experimental/filesystem>
+#include <vector>
+
+namespace tasm {
+class SemanticIndex;
+class Video;
+class VideoManager;
+
+// Benchmarks decoding, encoding, and reading from the catalog on this machine and fits the coefficients of the cost model.
+// Each calibration video is stored with uniform layouts of increasing size, and the tiles are then read back
+// with selections that touch either every tile or a single tile, so the fit sees a range of pixel and tile counts.
+// The temporary catalog entries are removed once their timings are taken.
+class CostModelCalibrator {
+public:
+    CostModelCalibrator(VideoManager &videoManager,
+            std::shared_ptr<GPUContext> context,
+            std::shared_ptr<VideoLock> lock,
+            unsigned int maxTilesPerDimension = 4)
+        : videoManager_(videoManager),
+        gpuContext_(context),
+        lock_(lock),
+        maxTilesPerDimension_(maxTilesPerDimension) {
+        assert(maxTilesPerDimension_ >= 2);
+    }
+
+    CostCoefficients calibrate(const std::vector<std::experimental::filesystem::path> &videos);
+
+private:
+    struct TimedSample {
+        double seconds;
+        CostElements costs;
+    };
+
+    struct EncodeSample {
+        long long int gopSizeInPixels;
+        double secondsPerGOP;
+    };
+
+    void benchmarkVideo(const std::experimental::filesystem::path &path, unsigned int videoIndex);
+    unsigned int decodeAllFrames(std::shared_ptr<Video> video);
+    void benchmarkReads(const std::string &storedName);
+    void benchmarkSelection(const std::string &storedName, const std::string &label, std::shared_ptr<SemanticIndex> semanticIndex, unsigned int gopLength);
+
+    CostCoefficients fitCoefficients() const;
+
+    VideoManager &videoManager_;
+    std::shared_ptr<GPUContext> gpuContext_;
+    std::shared_ptr<VideoLock> lock_;
+    unsigned int maxTilesPerDimension_;
+
+    std::vector<TimedSample> readSamples_;
+    std::vector<TimedSample> decodeSamples_;
+    std::vector<EncodeSample> encodeSamples_;
+    std::vector<long long int> frameSizesInPixels_;
+};
+
+} // namespace tasm
+
+#endif //TASM_COSTMODELCALIBRATION_H
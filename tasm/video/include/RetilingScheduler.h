@@ -0,0 +1,99 @@
+#ifndef TASM_RETILINGSCHEDULER_H
+#define TASM_RETILINGSCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tasm {
+class VideoManager;
+
+// Tracks foreground queries so that background work can stay out of their way.
+// Must be owned by a shared_ptr, which each token keeps alive so tokens may outlive the VideoManager.
+class ForegroundActivity : public std::enable_shared_from_this<ForegroundActivity> {
+public:
+    ForegroundActivity()
+        : numberOfActiveQueries_(0),
+        lastActivity_(std::chrono::steady_clock::now()) {}
+
+    // The query counts as active until the returned token is destroyed.
+    std::shared_ptr<void> begin();
+
+    // True when no query is active and none has ended within the quiet period.
+    bool isIdle(std::chrono::milliseconds quietPeriod) const;
+
+private:
+    void end();
+
+    mutable std::mutex mutex_;
+    unsigned int numberOfActiveQueries_;
+    std::chrono::steady_clock::time_point lastActivity_;
+};
+
+struct RetilingBudget {
+    // Fraction of wall-clock time that re-tiling may spend encoding, e.g. 0.25 for a quarter of one encoder.
+    double encodeTimeFraction = 0.25;
+
+    // Longest burst of encoding time that can be saved up while there is nothing to re-tile.
+    double maxBurstSeconds = 60;
+
+    unsigned int maxConcurrentRetiles = 1;
+
+    // Each re-tile covers at most this many GOPs so that a query never waits long for one to finish.
+    unsigned int maxGOPsPerRetile = 4;
+
+    std::chrono::milliseconds pollInterval{500};
+    std::chrono::milliseconds foregroundQuietPeriod{1000};
+};
+
+// Continuously re-tiles the GOPs of every video with regret-based tiling activated.
+// GOPs are picked in order of regret per unit of modeled encode cost. Encoding time is rationed with a token bucket
+// that refills at budget.encodeTimeFraction seconds per second, and re-tiling only starts while no queries are running.
+// At most one re-tile runs per video at a time.
+class RetilingScheduler {
+public:
+    RetilingScheduler(VideoManager &videoManager, std::shared_ptr<ForegroundActivity> foregroundActivity, const RetilingBudget &budget);
+    ~RetilingScheduler();
+
+    RetilingScheduler(const RetilingScheduler&) = delete;
+    RetilingScheduler &operator=(const RetilingScheduler&) = delete;
+
+    // One entry per running re-tile.
+    std::vector<std::string> videosBeingRetiled();
+
+private:
+    struct RetileJob {
+        std::string video;
+        std::thread thread;
+        std::atomic<bool> isDone{false};
+    };
+
+    void run();
+    void refillBudget();
+    void reapFinishedJobs();
+    bool startNextRetile();
+    void retile(RetileJob &job, std::vector<unsigned int> gops, double modeledSeconds);
+
+    VideoManager &videoManager_;
+    std::shared_ptr<ForegroundActivity> foregroundActivity_;
+    const RetilingBudget budget_;
+
+    std::mutex mutex_;
+    std::condition_variable stopCondition_;
+    bool stopRequested_;
+    double availableSeconds_;
+    std::chrono::steady_clock::time_point lastRefill_;
+    std::list<RetileJob> jobs_;
+
+    std::thread thread_;
+};
+
+} // namespace tasm
+
+#endif //TASM_RETILINGSCHEDULER_H
@@ -0,0 +1,50 @@
+#ifndef TASM_TILEDVIDEOCOMPACTOR_H
+#define TASM_TILEDVIDEOCOMPACTOR_H
+
+#include "FileLock.h"
+#include "TileLayout.h"
+#include "Video.h"
+#include <experimental/filesystem>
+
+namespace tasm {
+class TiledVideoManager;
+
+// Merges runs of adjacent tile directories that have the same layout into a single directory.
+// A single store already writes contiguous frames with the same layout into one directory, but re-tiling
+// individual GOPs leaves behind one directory per GOP even when neighbouring GOPs end up with the same layout.
+// Only directories that are not partially shadowed by a newer version are merged. The tiles' samples are
+// concatenated without re-encoding, so this is cheap compared to re-tiling.
+// The directory the video was first stored into is never merged.
+// Compaction holds the entry's writers lock exclusively, so no transaction that reserved an older version than the merged
+// directory's can commit after it and be shadowed by it.
+class TiledVideoCompactor {
+public:
+    explicit TiledVideoCompactor(const std::string &name)
+        : TiledVideoCompactor(name, files::PathForVideo(name)) {}
+
+    TiledVideoCompactor(const std::string &name, const std::experimental::filesystem::path &entryPath)
+        : name_(name),
+        entryPath_(entryPath) {}
+
+    // Returns the number of directories that were removed. Their files are deleted once no query holds a lease on them.
+    unsigned int compact();
+
+private:
+    struct TileDirectory {
+        int id;
+        std::experimental::filesystem::path path;
+        unsigned int firstFrame;
+        unsigned int lastFrame;
+        std::shared_ptr<TileLayout> layout;
+    };
+
+    std::vector<std::vector<TileDirectory>> findRunsToMerge(const TiledVideoManager &tiledVideoManager) const;
+    void mergeRun(const std::vector<TileDirectory> &run, std::shared_ptr<FileLock> writersLock);
+
+    const std::string name_;
+    const std::experimental::filesystem::path entryPath_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEDVIDEOCOMPACTOR_H
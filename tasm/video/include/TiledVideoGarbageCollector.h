@@ -0,0 +1,51 @@
+#ifndef TASM_TILEDVIDEOGARBAGECOLLECTOR_H
+#define TASM_TILEDVIDEOGARBAGECOLLECTOR_H
+
+#include "Video.h"
+#include <experimental/filesystem>
+#include <string>
+#include <vector>
+
+namespace tasm {
+
+struct GarbageCollectionResult {
+    // Directories that were removed from the manifest by this collection.
+    unsigned int numberOfDirectoriesRetired = 0;
+    unsigned int numberOfDirectoriesDeleted = 0;
+    unsigned long long numberOfBytesReclaimed = 0;
+    // Removed directories that could not be deleted yet because a reader held a lease on the entry.
+    unsigned int numberOfDirectoriesPending = 0;
+};
+
+// Reclaims the storage of tile directories that are never read anymore because newer versions cover all of their frames.
+// Shadowed directories are first removed from the entry's manifest so that newly loaded tiled video managers skip them.
+// They are deleted, along with directories removed by compaction, once no reader holds a TileReaderLease on the entry.
+// Until then they are left for the next collection. Directories that a transaction started but never committed, because it
+// failed or its process exited, are deleted the same way once no transaction holds their lock.
+// The saved tile access statistics of deleted versions are dropped.
+class TiledVideoGarbageCollector {
+public:
+    explicit TiledVideoGarbageCollector(const std::string &name)
+        : TiledVideoGarbageCollector(name, files::PathForVideo(name)) {}
+
+    TiledVideoGarbageCollector(const std::string &name, const std::experimental::filesystem::path &entryPath)
+        : name_(name),
+        entryPath_(entryPath) {}
+
+    GarbageCollectionResult collect();
+
+    // Deletes directories that have been removed from the manifest, if no reader holds a lease.
+    GarbageCollectionResult deleteRemovedDirectories();
+
+private:
+    unsigned int retireShadowedDirectories();
+    std::vector<std::experimental::filesystem::path> removedDirectories() const;
+    bool isAbandoned(const std::experimental::filesystem::path &directory) const;
+
+    const std::string name_;
+    const std::experimental::filesystem::path entryPath_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEDVIDEOGARBAGECOLLECTOR_H
@@ -0,0 +1,41 @@
+#ifndef TASM_TILEDVIDEOPACKER_H
+#define TASM_TILEDVIDEOPACKER_H
+
+#include "Video.h"
+#include <experimental/filesystem>
+#include <string>
+
+namespace tasm {
+
+// Moves the tiles of each tile directory into a single tile pack, so a query that reads several tiles of a directory
+// opens one file instead of one mp4 per tile. MP4Reader reads packed tiles through the same tile filenames,
+// so nothing that reads tiles needs to know whether a directory is packed.
+// Each tile's mp4 is removed once no reader holds a lease on the entry; until then, readers keep using the mp4s.
+class TiledVideoPacker {
+public:
+    explicit TiledVideoPacker(const std::string &name)
+        : TiledVideoPacker(name, files::PathForVideo(name)) {}
+
+    TiledVideoPacker(const std::string &name, const std::experimental::filesystem::path &entryPath)
+        : name_(name),
+        entryPath_(entryPath) {}
+
+    // Returns the number of directories that were packed.
+    unsigned int pack();
+
+    // Recreates the mp4s of every packed tile, and removes the packs once no reader holds a lease.
+    // Returns the number of directories that were unpacked.
+    unsigned int unpack();
+
+private:
+    void packDirectory(const std::experimental::filesystem::path &directory, unsigned int numberOfTiles);
+    // Removes either the packs or the mp4s of packed directories, depending on which was last written.
+    void removeFilesOfPackedDirectories(bool shouldRemovePacks);
+
+    const std::string name_;
+    const std::experimental::filesystem::path entryPath_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEDVIDEOPACKER_H
@@ -7,6 +7,7 @@
 #include <experimental/filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 
 namespace tasm {
 
@@ -31,9 +32,18 @@ public:
     const Configuration &configuration() const { return *configuration_; }
     const std::experimental::filesystem::path &path() const { return path_; }
 
+    // Reads the container, or the whole stream when the container doesn't record its length.
+    // The count is only computed the first time it is needed.
+    unsigned int numberOfFrames() const {
+        std::call_once(numberOfFramesFlag_, [this] { numberOfFrames_ = video::GetNumberOfFrames(path_); });
+        return numberOfFrames_;
+    }
+
 private:
     std::experimental::filesystem::path path_;
     std::unique_ptr<const Configuration> configuration_;
+    mutable std::once_flag numberOfFramesFlag_;
+    mutable unsigned int numberOfFrames_ = 0;
 };
 
 class TiledEntry {
@@ -46,7 +56,8 @@ public:
         : name_(name),
         metadataIdentifier_(metadataIdentifier.length() ? metadataIdentifier : name),
         path_(path),
-        version_(loadVersion())
+        version_(loadVersion()),
+        gopLength_(loadGOPLength())
     {
         if (!std::experimental::filesystem::exists(path_))
             std::experimental::filesystem::create_directory(path_);
@@ -57,7 +68,13 @@ public:
     const std::string &name() const { return name_; }
     const std::string &metadataIdentifier() const { return metadataIdentifier_; }
 
-    void incrementTileVersion();
+    // Reserves the next tile version for a new directory. Concurrent transactions, in this or another process, never
+    // reserve the same version.
+    unsigned int reserveTileVersion();
+
+    // The number of frames between keyframes that the video was stored with, or 0 if it was not recorded.
+    unsigned int gopLength() const { return gopLength_; }
+    void setGOPLength(unsigned int gopLength);
 
 private:
     unsigned int loadVersion() {
@@ -71,10 +88,22 @@ private:
             return 0u;
     }
 
+    unsigned int loadGOPLength() {
+        auto gopLengthPath = path_ / "gop-length";
+
+        if (std::experimental::filesystem::exists(gopLengthPath)) {
+            std::ifstream f(gopLengthPath);
+            return static_cast<unsigned int>(stoul(std::string(std::istreambuf_iterator<char>(f),
+                                                               std::istreambuf_iterator<char>())));
+        } else
+            return 0u;
+    }
+
     const std::string name_;
     const std::string metadataIdentifier_;
     const std::experimental::filesystem::path path_;
     unsigned int version_;
+    unsigned int gopLength_;
 };
 
 } // namespace tasm
@@ -7,8 +7,12 @@
 
 namespace tasm::video {
 
+// A tile whose directory has been packed gets the configuration that was stored in the pack.
 std::unique_ptr<Configuration> GetConfiguration(const std::experimental::filesystem::path &path);
 
+// Uses the frame count recorded in the container when there is one, and otherwise counts the video's packets.
+unsigned int GetNumberOfFrames(const std::experimental::filesystem::path &path);
+
 } // namespace tasm::video
 
 #endif //TASM_VIDEOCONFIGURATION_H
@@ -1,17 +1,27 @@
 #ifndef TASM_VIDEOMANAGER_H
 #define TASM_VIDEOMANAGER_H
 
+#include "CostFeedback.h"
+#include "CostModel.h"
 #include "GPUContext.h"
 #include "ImageUtilities.h"
 #include "RegretAccumulator.h"
+#include "RetilingScheduler.h"
+#include "TileAccessStatistics.h"
+#include "TiledVideoGarbageCollector.h"
 #include "VideoLock.h"
+#include <atomic>
 #include <experimental/filesystem>
+#include <optional>
+#include <unordered_set>
 #include <TileConfigurationProvider.h>
 
 namespace tasm {
 class SemanticIndex;
 class MetadataSelection;
+class TiledVideoManager;
 class TemporalSelection;
+class TiledEntry;
 class Video;
 
 enum class SelectStrategy{
@@ -24,10 +34,16 @@ class VideoManager {
 public:
     VideoManager()
         : gpuContext_(new GPUContext(0)),
-        lock_(new VideoLock(gpuContext_)) {
+        lock_(new VideoLock(gpuContext_)),
+        gopLength_(0),
+        foregroundActivity_(new ForegroundActivity()) {
         createCatalogIfNecessary();
+        costModel_ = CostModel::loadFromCatalog();
+        costFeedback_ = std::make_shared<CostFeedback>(costModel_, CostModel::pathInCatalog());
     }
 
+    ~VideoManager();
+
     void store(const std::experimental::filesystem::path &path, const std::string &name);
     void storeWithUniformLayout(const std::experimental::filesystem::path &path, const std::string &name, unsigned int numRows, unsigned int numColumns);
     void storeWithNonUniformLayout(const std::experimental::filesystem::path &path,
@@ -37,6 +53,14 @@ public:
                                     std::shared_ptr<SemanticIndex> semanticIndex,
                                     bool force);
 
+    // Tiles each GOP to minimize the expected cost of the queries, weighted by how often each one is executed.
+    void storeWithWorkloadLayout(const std::experimental::filesystem::path &path,
+                                    const std::string &storedName,
+                                    const std::string &metadataIdentifier,
+                                    const std::vector<std::shared_ptr<MetadataSelection>> &metadataSelections,
+                                    const std::vector<unsigned int> &queryCounts,
+                                    std::shared_ptr<SemanticIndex> semanticIndex);
+
     std::unique_ptr<ImageIterator> select(const std::string &video,
                                           const std::string &metadataIdentifier,
                                           std::shared_ptr<MetadataSelection> metadataSelection,
@@ -46,20 +70,108 @@ public:
 
     void retileVideoBasedOnRegret(const std::string &video);
 
+    // Drops cached layouts and regret state derived from the identifier's metadata.
+    void invalidateMetadata(const std::string &metadataIdentifier);
+
+    // Must be called after metadata is added for the identifier. It only records the change, which is cheap enough to
+    // do for every row, and invalidateMetadata runs before the next store, query, or re-tile.
+    void metadataChanged(const std::string &metadataIdentifier);
+
+    // Merges adjacent tile directories with the same layout. Returns the number of directories removed.
+    unsigned int compactTiledVideo(const std::string &video);
+
+    // Removes tile directories that newer versions fully shadow. Their files are deleted once no query is reading them.
+    GarbageCollectionResult collectGarbage(const std::string &video);
+
+    // Moves the tiles of each tile directory into a single file. Returns the number of directories packed.
+    unsigned int packTiledVideo(const std::string &video);
+
+    // Recreates each packed tile's mp4. Returns the number of directories unpacked.
+    unsigned int unpackTiledVideo(const std::string &video);
+
+    // Re-tiles GOPs with enough regret in the background, within the budget, while no queries are running.
+    void startBackgroundRetiling(const RetilingBudget &budget = RetilingBudget());
+    void stopBackgroundRetiling();
+
+    // All GOPs of activated videos that have accumulated enough regret to be re-tiled.
+    std::vector<std::pair<std::string, RetileCandidate>> gopsWorthRetiling();
+
+    // Re-tiles the specified GOPs that still have enough regret. Returns the number of GOPs that were re-tiled.
+    unsigned int retileGOPsBasedOnRegret(const std::string &video, const std::vector<unsigned int> &gops);
+
     void activateRegretBasedRetilingForVideo(const std::string &video, const std::string &metadataIdentifier, std::shared_ptr<SemanticIndex> semanticIndex, double threshold = 1.0);
     void deactivateRegretBasedRetilingForVideo(const std::string &video);
 
+    // Benchmarks this machine using the specified videos, then saves the fitted coefficients to the catalog.
+    void calibrateCostModel(const std::vector<std::experimental::filesystem::path> &videos);
+    std::shared_ptr<CostModel> costModel() const { return costModel_; }
+
+    // Opts in to stabilizing non-uniform layouts: a GOP reuses or snaps to the previous GOP's layout when the modeled cost
+    // increases by at most this fraction. A tolerance of 0 only reuses layouts that are no more expensive.
+    // Stabilization is off by default and with std::nullopt, and forced stores never stabilize.
+    void setLayoutStabilityTolerance(std::optional<double> tolerance) { layoutStabilityTolerance_ = tolerance; }
+
+    // Videos stored from now on are encoded with a keyframe every gopLength frames, and their layouts can change at
+    // each keyframe. The GOP length is recorded with the stored video so that re-tiling keeps it.
+    // A GOP length of 0, the default, uses the frame rate of each video, i.e. one-second GOPs.
+    void setGOPLength(unsigned int gopLength) { gopLength_ = gopLength; }
+    unsigned int gopLength() const { return gopLength_; }
+    unsigned int gopLengthForVideo(const Video &video) const;
+
+    // Recommends a GOP length for storing the video at path given the queries it is expected to serve.
+    unsigned int recommendGOPLength(const std::experimental::filesystem::path &path, const QueryMix &queryMix) const;
+
+    // How many times each tile of each GOP of the video has been read by queries, and how many bytes were read.
+    TileAccessMap tileAccessStatistics(const std::string &video);
+
 private:
     void createCatalogIfNecessary();
+    void invalidateChangedMetadata();
+    // Layouts that depend on the video's contents are expensive, so plan them ahead of encoding. Uniform layouts aren't,
+    // and storing them doesn't need to count the video's frames.
+    std::shared_ptr<TileLayoutProvider> planLayouts(std::shared_ptr<Video> video, std::shared_ptr<TileLayoutProvider> layoutProvider);
     void storeTiledVideo(std::shared_ptr<Video>, std::shared_ptr<TileLayoutProvider>, const std::string &savedName);
+    static unsigned int gopLengthForEntry(const TiledEntry &entry, const Configuration &tileConfiguration);
+    std::shared_ptr<TileAccessStatistics> tileAccessStatisticsForEntry(const TiledEntry &entry, unsigned int gopLength);
+    // Garbage collection drops the saved counts of the versions it deletes, so counts are flushed before it runs.
+    void flushTileAccessStatistics(const std::string &video);
+
+    // Loaded tiled videos are shared by queries until a directory is committed to or removed from the entry.
+    std::shared_ptr<TiledVideoManager> tiledVideoManagerForVideo(const std::string &video);
+    void invalidateTiledVideoManager(const std::string &video);
+    std::shared_ptr<TileLayoutProvider> stabilizeLayouts(std::shared_ptr<Video> video,
+                                                         std::shared_ptr<TileLayoutProvider> layoutProvider,
+                                                         std::shared_ptr<Workload> workload,
+                                                         std::shared_ptr<TileSizeEstimator> tileSizeEstimator);
     void setUpRegretBasedRetiling(const std::string &video, std::shared_ptr<SemanticDataManager> selection, std::shared_ptr<TileLayoutProvider> currentLayout);
-    void accumulateRegret(const std::string &video, std::shared_ptr<SemanticDataManager> selection, std::shared_ptr<TileLayoutProvider> currentLayout);
-    void retileVideo(std::shared_ptr<Video> video, std::shared_ptr<std::vector<int>> framesToRead, std::shared_ptr<TileLayoutProvider> newLayoutProvider, const std::string &savedName);
+    std::shared_ptr<RegretAccumulator> regretAccumulatorForVideo(const std::string &video);
+    void retileGOPs(const std::string &videoName,
+                    std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<TileLayoutProvider>>> gopToLayouts);
+    void accumulateRegret(std::shared_ptr<RegretAccumulator> regretAccumulator, const std::string &video, std::shared_ptr<SemanticDataManager> selection, std::shared_ptr<TileLayoutProvider> currentLayout, std::shared_ptr<const TiledVideoManager> tiledVideoManager);
+    void retileVideo(std::shared_ptr<Video> video, std::shared_ptr<std::vector<int>> framesToRead, std::shared_ptr<TileLayoutProvider> newLayoutProvider, const std::string &savedName, unsigned int gopLength);
 
     std::shared_ptr<GPUContext> gpuContext_;
     std::shared_ptr<VideoLock> lock_;
+    std::shared_ptr<CostModel> costModel_;
+    std::shared_ptr<CostFeedback> costFeedback_;
+    std::optional<double> layoutStabilityTolerance_;
+    unsigned int gopLength_;
+
+    std::mutex changedMetadataMutex_;
+    std::atomic<bool> hasChangedMetadata_{false};
+    std::unordered_set<std::string> changedMetadataIdentifiers_;
 
+    std::mutex regretMutex_;
     std::unordered_map<std::string, std::shared_ptr<RegretAccumulator>> videoToRegretAccumulator_;
+
+    std::mutex tiledVideoManagerMutex_;
+    std::unordered_map<std::string, std::shared_ptr<TiledVideoManager>> videoToTiledVideoManager_;
+
+    std::mutex tileAccessMutex_;
+    std::unordered_map<std::string, std::shared_ptr<TileAccessStatistics>> videoToTileAccessStatistics_;
+
+    std::shared_ptr<ForegroundActivity> foregroundActivity_;
+    std::unique_ptr<RetilingScheduler> retilingScheduler_;
 };
 
 } // namespace tasm
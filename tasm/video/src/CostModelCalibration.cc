@@ -0,0 +1,244 @@
+#include "CostModelCalibration.h"
+
+#include "DecodeOperators.h"
+#include "Files.h"
+#include "ScanOperators.h"
+#include "SemanticDataManager.h"
+#include "SemanticIndex.h"
+#include "TileLocationProvider.h"
+#include "TiledVideoManager.h"
+#include "Video.h"
+#include "VideoManager.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace tasm {
+
+static const std::string FullFrameLabel = "calibration-full-frame";
+static const std::string CornerLabel = "calibration-corner";
+
+// Sets the manager's GOP length for a scope, and restores it even if the scope throws.
+class GOPLengthOverride {
+public:
+    GOPLengthOverride(VideoManager &videoManager, unsigned int gopLength)
+        : videoManager_(videoManager),
+        previousGOPLength_(videoManager.gopLength()) {
+        videoManager_.setGOPLength(gopLength);
+    }
+
+    ~GOPLengthOverride() {
+        videoManager_.setGOPLength(previousGOPLength_);
+    }
+
+private:
+    VideoManager &videoManager_;
+    const unsigned int previousGOPLength_;
+};
+
+// When choosing the pixel threshold, assume a tiled layout splits the frame into this many tiles.
+static const unsigned int TypicalNumberOfTilesInLayout = 4;
+
+template <typename F>
+static double secondsToRun(F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Least squares fit of seconds = firstWeight * first(costs) + secondWeight * second(costs).
+// Returns false if the samples can't separate the two weights.
+template <typename Sample, typename First, typename Second>
+static bool fitTwoWeights(const std::vector<Sample> &samples, First first, Second second, double &firstWeight, double &secondWeight) {
+    double aa = 0, ab = 0, bb = 0, ay = 0, by = 0;
+    for (const auto &sample : samples) {
+        double a = first(sample.costs);
+        double b = second(sample.costs);
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        ay += a * sample.seconds;
+        by += b * sample.seconds;
+    }
+    double determinant = aa * bb - ab * ab;
+    if (samples.empty() || std::abs(determinant) <= std::numeric_limits<double>::epsilon() * aa * bb)
+        return false;
+
+    firstWeight = std::max((ay * bb - by * ab) / determinant, 0.0);
+    secondWeight = std::max((by * aa - ay * ab) / determinant, 0.0);
+    return true;
+}
+
+CostCoefficients CostModelCalibrator::calibrate(const std::vector<std::experimental::filesystem::path> &videos) {
+    readSamples_.clear();
+    decodeSamples_.clear();
+    encodeSamples_.clear();
+    frameSizesInPixels_.clear();
+
+    for (auto i = 0u; i < videos.size(); ++i)
+        benchmarkVideo(videos[i], i);
+
+    return fitCoefficients();
+}
+
+void CostModelCalibrator::benchmarkVideo(const std::experimental::filesystem::path &path, unsigned int videoIndex) {
+    auto video = std::make_shared<Video>(path);
+    auto width = video->configuration().displayWidth;
+    auto height = video->configuration().displayHeight;
+    auto gopLength = videoManager_.gopLengthForVideo(*video);
+    frameSizesInPixels_.push_back(static_cast<long long int>(width) * height);
+
+    // Storing a video decodes it as well as encodes it, so time a decode on its own to separate the two.
+    unsigned int numberOfFrames = 0;
+    auto decodeTime = secondsToRun([&]() { numberOfFrames = decodeAllFrames(video); });
+    std::cout << "Calibration: decoded " << numberOfFrames << " frames of " << path << " in " << decodeTime << "s" << std::endl;
+
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+    for (auto tilesPerDimension = 1u; tilesPerDimension <= maxTilesPerDimension_; ++tilesPerDimension) {
+        // Alternate between two GOP lengths so that the encode fit sees more than one GOP size, even with a single video.
+        auto storedGOPLength = tilesPerDimension % 2 ? gopLength : 2 * gopLength;
+        auto numberOfGOPs = (numberOfFrames + storedGOPLength - 1) / storedGOPLength;
+
+        auto storedName = "calibration-" + std::to_string(videoIndex) + "-" + std::to_string(tilesPerDimension);
+        auto storeTime = secondsToRun([&]() {
+            GOPLengthOverride gopLengthOverride(videoManager_, storedGOPLength);
+            videoManager_.storeWithUniformLayout(path, storedName, tilesPerDimension, tilesPerDimension);
+        });
+        encodeSamples_.push_back({static_cast<long long int>(width) * height * storedGOPLength,
+                                  std::max(storeTime - decodeTime, 0.0) / numberOfGOPs});
+        benchmarkReads(storedName);
+
+        // An object covering the whole frame reads every tile; an object in the corner reads a single tile.
+        std::vector<MetadataInfo> metadata;
+        metadata.reserve(2 * numberOfFrames);
+        for (auto frame = 0u; frame < numberOfFrames; ++frame) {
+            metadata.emplace_back(storedName, FullFrameLabel, frame, 0, 0, width, height);
+            metadata.emplace_back(storedName, CornerLabel, frame, 0, 0, width / 8, height / 8);
+        }
+        semanticIndex->addBulkMetadata(metadata);
+
+        benchmarkSelection(storedName, FullFrameLabel, semanticIndex, storedGOPLength);
+        benchmarkSelection(storedName, CornerLabel, semanticIndex, storedGOPLength);
+
+        std::experimental::filesystem::remove_all(files::PathForVideo(storedName));
+    }
+}
+
+void CostModelCalibrator::benchmarkReads(const std::string &storedName) {
+    // The tiles were just written, so unless the catalog is on a network mount this mostly measures reads from the page cache.
+    unsigned long long numBytes = 0;
+    unsigned long long numFiles = 0;
+    std::vector<char> buffer(1 << 20);
+    auto seconds = secondsToRun([&]() {
+        for (auto &file : std::experimental::filesystem::recursive_directory_iterator(files::PathForVideo(storedName))) {
+            if (file.path().extension() != TileFiles::muxedFilenameExtension())
+                continue;
+
+            std::ifstream input(file.path(), std::ios::in | std::ios::binary);
+            while (input.read(buffer.data(), buffer.size()) || input.gcount())
+                numBytes += input.gcount();
+            ++numFiles;
+        }
+    });
+    readSamples_.push_back({seconds, CostElements(0, 0, numBytes, numFiles)});
+}
+
+unsigned int CostModelCalibrator::decodeAllFrames(std::shared_ptr<Video> video) {
+    auto scan = std::make_shared<ScanFileDecodeReader>(video);
+    GPUDecodeFromCPU decode(scan, video->configuration(), gpuContext_, lock_);
+
+    unsigned int numberOfFrames = 0;
+    while (!decode.isComplete()) {
+        auto decoded = decode.next();
+        if (decoded.has_value())
+            numberOfFrames += decoded->frames().size();
+    }
+    return numberOfFrames;
+}
+
+void CostModelCalibrator::benchmarkSelection(const std::string &storedName, const std::string &label,
+                                             std::shared_ptr<SemanticIndex> semanticIndex, unsigned int gopLength) {
+    auto metadataSelection = std::make_shared<SingleMetadataSelection>(label);
+    auto seconds = secondsToRun([&]() {
+        auto images = videoManager_.select(storedName, storedName, metadataSelection, std::shared_ptr<TemporalSelection>(), semanticIndex, SelectStrategy::Tiles);
+        while (images->next()) {}
+    });
+
+    // Estimate the same cost elements the regret accumulator would for this selection.
+    auto entry = std::make_shared<TiledEntry>(storedName);
+    auto tiledVideoManager = std::make_shared<TiledVideoManager>(entry);
+    auto tileLocationProvider = std::make_shared<SingleTileLocationProvider>(tiledVideoManager);
+    auto semanticDataManager = std::make_shared<SemanticDataManager>(semanticIndex, storedName, metadataSelection);
+    WorkloadCostEstimator costEstimator(tileLocationProvider, std::make_shared<Workload>(semanticDataManager), gopLength,
+                                        std::make_shared<TileSizeEstimator>(tiledVideoManager));
+
+    decodeSamples_.push_back({seconds, costEstimator.estimateCostForQuery(0)});
+}
+
+CostCoefficients CostModelCalibrator::fitCoefficients() const {
+    auto coefficients = CostModel::DefaultCoefficients;
+
+    // Fit the cost of reading first so that it can be separated from the cost of decoding.
+    if (!fitTwoWeights(readSamples_,
+                       [](const CostElements &costs) { return costs.numBytes; },
+                       [](const CostElements &costs) { return costs.numFiles; },
+                       coefficients.byteCostWeight, coefficients.fileCostWeight))
+        std::cerr << "Calibration: read samples are degenerate; ignoring I/O costs" << std::endl;
+
+    std::vector<TimedSample> decodeOnlySamples;
+    for (const auto &sample : decodeSamples_) {
+        auto readSeconds = coefficients.byteCostWeight * sample.costs.numBytes + coefficients.fileCostWeight * sample.costs.numFiles;
+        decodeOnlySamples.push_back({std::max(sample.seconds - readSeconds, 0.0), sample.costs});
+    }
+    if (!fitTwoWeights(decodeOnlySamples,
+                       [](const CostElements &costs) { return costs.numPixels; },
+                       [](const CostElements &costs) { return costs.numTiles; },
+                       coefficients.pixelCostWeight, coefficients.tileCostWeight))
+        std::cerr << "Calibration: decode samples are degenerate; keeping default decode weights" << std::endl;
+
+    // Fit secondsPerGOP = encodePixelCoefficient * gopSizeInPixels + encodePixelIntercept.
+    // A single GOP size has no slope, so the encode weights are only fit when the samples have at least two.
+    if (!encodeSamples_.empty()) {
+        double n = encodeSamples_.size();
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (const auto &sample : encodeSamples_) {
+            double x = sample.gopSizeInPixels;
+            sx += x;
+            sy += sample.secondsPerGOP;
+            sxx += x * x;
+            sxy += x * sample.secondsPerGOP;
+        }
+        double variance = n * sxx - sx * sx;
+        if (variance > std::numeric_limits<double>::epsilon() * n * sxx) {
+            coefficients.encodePixelCoefficient = std::max((n * sxy - sx * sy) / variance, 0.0);
+            coefficients.encodePixelIntercept = std::max((sy - coefficients.encodePixelCoefficient * sx) / n, 0.0);
+        } else {
+            std::cerr << "Calibration: encode samples have a single GOP size; keeping default encode weights" << std::endl;
+        }
+    }
+
+    // Tiling pays off when the decoded pixels it saves outweigh the cost of reading the extra tiles:
+    //   pixelCostWeight * f * P + tileCostWeight * k <= pixelCostWeight * P + tileCostWeight
+    //   f <= 1 - tileCostWeight * (k - 1) / (pixelCostWeight * P)
+    if (!frameSizesInPixels_.empty() && coefficients.pixelCostWeight > 0) {
+        double averageFrameSize = 0;
+        for (auto size : frameSizesInPixels_)
+            averageFrameSize += size;
+        averageFrameSize /= frameSizesInPixels_.size();
+
+        auto threshold = 1 - coefficients.tileCostWeight * (TypicalNumberOfTilesInLayout - 1) / (coefficients.pixelCostWeight * averageFrameSize);
+        coefficients.pixelThreshold = std::clamp(threshold, 0.1, 1.0);
+    }
+
+    std::cout << "Calibration: pixelCostWeight=" << coefficients.pixelCostWeight
+              << ", tileCostWeight=" << coefficients.tileCostWeight
+              << ", encodePixelCoefficient=" << coefficients.encodePixelCoefficient
+              << ", encodePixelIntercept=" << coefficients.encodePixelIntercept
+              << ", pixelThreshold=" << coefficients.pixelThreshold
+              << ", byteCostWeight=" << coefficients.byteCostWeight
+              << ", fileCostWeight=" << coefficients.fileCostWeight << std::endl;
+    return coefficients;
+}
+
+} // namespace tasm
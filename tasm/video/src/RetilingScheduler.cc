@@ -0,0 +1,164 @@
+#include "RetilingScheduler.h"
+
+#include "VideoManager.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace tasm {
+
+std::shared_ptr<void> ForegroundActivity::begin() {
+    {
+        std::scoped_lock lock(mutex_);
+        ++numberOfActiveQueries_;
+    }
+    return std::shared_ptr<void>(nullptr, [activity = shared_from_this()](void*) { activity->end(); });
+}
+
+void ForegroundActivity::end() {
+    std::scoped_lock lock(mutex_);
+    assert(numberOfActiveQueries_);
+    --numberOfActiveQueries_;
+    lastActivity_ = std::chrono::steady_clock::now();
+}
+
+bool ForegroundActivity::isIdle(std::chrono::milliseconds quietPeriod) const {
+    std::scoped_lock lock(mutex_);
+    return !numberOfActiveQueries_ && std::chrono::steady_clock::now() - lastActivity_ >= quietPeriod;
+}
+
+RetilingScheduler::RetilingScheduler(VideoManager &videoManager, std::shared_ptr<ForegroundActivity> foregroundActivity, const RetilingBudget &budget)
+    : videoManager_(videoManager),
+    foregroundActivity_(foregroundActivity),
+    budget_(budget),
+    stopRequested_(false),
+    availableSeconds_(0),
+    lastRefill_(std::chrono::steady_clock::now()) {
+    assert(budget_.encodeTimeFraction > 0);
+    assert(budget_.maxConcurrentRetiles > 0);
+    assert(budget_.maxGOPsPerRetile > 0);
+    thread_ = std::thread(&RetilingScheduler::run, this);
+}
+
+RetilingScheduler::~RetilingScheduler() {
+    {
+        std::scoped_lock lock(mutex_);
+        stopRequested_ = true;
+    }
+    stopCondition_.notify_all();
+    thread_.join();
+
+    // Let running re-tiles finish so that no tile directory is left half-written.
+    for (auto &job : jobs_)
+        job.thread.join();
+}
+
+std::vector<std::string> RetilingScheduler::videosBeingRetiled() {
+    std::scoped_lock lock(mutex_);
+    std::vector<std::string> videos;
+    for (const auto &job : jobs_) {
+        if (!job.isDone)
+            videos.push_back(job.video);
+    }
+    return videos;
+}
+
+void RetilingScheduler::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopCondition_.wait_for(lock, budget_.pollInterval, [this] { return stopRequested_; })) {
+        refillBudget();
+        reapFinishedJobs();
+
+        if (jobs_.size() >= budget_.maxConcurrentRetiles || !foregroundActivity_->isIdle(budget_.foregroundQuietPeriod))
+            continue;
+
+        // Finding candidates takes the accumulators' locks, so don't hold the scheduler's lock meanwhile.
+        lock.unlock();
+        startNextRetile();
+        lock.lock();
+    }
+}
+
+void RetilingScheduler::refillBudget() {
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - lastRefill_;
+    lastRefill_ = now;
+    availableSeconds_ = std::min(availableSeconds_ + budget_.encodeTimeFraction * elapsed.count(), budget_.maxBurstSeconds);
+}
+
+void RetilingScheduler::reapFinishedJobs() {
+    for (auto it = jobs_.begin(); it != jobs_.end();) {
+        if (it->isDone) {
+            it->thread.join();
+            it = jobs_.erase(it);
+        } else
+            ++it;
+    }
+}
+
+bool RetilingScheduler::startNextRetile() {
+    auto candidates = videoManager_.gopsWorthRetiling();
+
+    std::scoped_lock lock(mutex_);
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const auto &videoAndCandidate) {
+        return std::any_of(jobs_.begin(), jobs_.end(), [&](const RetileJob &job) { return job.video == videoAndCandidate.first; });
+    }), candidates.end());
+    if (candidates.empty())
+        return false;
+
+    std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+        return a.second.regret / a.second.encodeCost > b.second.regret / b.second.encodeCost;
+    });
+
+    // Re-tile the video with the most valuable GOP, picking its GOPs in order of value while the budget allows.
+    auto &video = candidates.front().first;
+    std::vector<unsigned int> gops;
+    double modeledSeconds = 0;
+    for (const auto &videoAndCandidate : candidates) {
+        if (videoAndCandidate.first != video)
+            continue;
+
+        // A GOP that costs more than the largest burst can still be re-tiled once the budget is full.
+        auto &candidate = videoAndCandidate.second;
+        bool budgetIsFull = availableSeconds_ >= budget_.maxBurstSeconds;
+        if (modeledSeconds + candidate.encodeCost > availableSeconds_ && !(gops.empty() && budgetIsFull))
+            break;
+
+        gops.push_back(candidate.gop);
+        modeledSeconds += candidate.encodeCost;
+        if (gops.size() == budget_.maxGOPsPerRetile)
+            break;
+    }
+    if (gops.empty())
+        return false;
+
+    availableSeconds_ -= modeledSeconds;
+    jobs_.emplace_back();
+    auto &job = jobs_.back();
+    job.video = video;
+    job.thread = std::thread(&RetilingScheduler::retile, this, std::ref(job), std::move(gops), modeledSeconds);
+    return true;
+}
+
+void RetilingScheduler::retile(RetileJob &job, std::vector<unsigned int> gops, double modeledSeconds) {
+    auto start = std::chrono::steady_clock::now();
+    try {
+        videoManager_.retileGOPsBasedOnRegret(job.video, gops);
+
+        // Re-tiling can shadow whole directories, so reclaim them while still in the background.
+        videoManager_.collectGarbage(job.video);
+    } catch (const std::exception &e) {
+        // The GOPs keep their regret, so they are picked again once the budget allows.
+        std::cerr << "Background re-tiling of " << job.video << " failed: " << e.what() << std::endl;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    {
+        // Charge the time the re-tile actually took rather than the modeled time.
+        std::scoped_lock lock(mutex_);
+        availableSeconds_ += modeledSeconds - elapsed.count();
+    }
+    job.isDone = true;
+}
+
+} // namespace tasm
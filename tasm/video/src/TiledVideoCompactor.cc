@@ -0,0 +1,106 @@
+#include "TiledVideoCompactor.h"
+
+#include "Files.h"
+#include "MP4Reader.h"
+#include "TileManifest.h"
+#include "TileReaderLease.h"
+#include "TiledVideoGarbageCollector.h"
+#include "TiledVideoManager.h"
+#include "Transaction.h"
+#include "VideoConfiguration.h"
+
+namespace tasm {
+
+unsigned int TiledVideoCompactor::compact() {
+    unsigned int numberOfDirectoriesRemoved = 0;
+    {
+        // Compaction reads the directories it merges, so they must not be deleted meanwhile.
+        TileReaderLease lease(entryPath_);
+
+        // Wait for transactions in flight to commit, and keep new ones from starting, so the merged directories' versions
+        // are newer than every directory that is committed before or after them.
+        auto writersLock = std::make_shared<FileLock>(TileFiles::tileWritersLockFilename(entryPath_), FileLock::Mode::Exclusive);
+        auto runs = findRunsToMerge(TiledVideoManager(std::make_shared<TiledEntry>(name_, entryPath_)));
+
+        for (const auto &run : runs) {
+            std::cout << "Compacting " << run.size() << " directories spanning frames " << run.front().firstFrame
+                      << "-" << run.back().lastFrame << std::endl;
+            mergeRun(run, writersLock);
+            numberOfDirectoriesRemoved += run.size() - 1;
+        }
+    }
+
+    // Queries may still be reading the merged directories, so only delete them once no reader holds a lease.
+    if (numberOfDirectoriesRemoved)
+        TiledVideoGarbageCollector(name_, entryPath_).deleteRemovedDirectories();
+    return numberOfDirectoriesRemoved;
+}
+
+std::vector<std::vector<TiledVideoCompactor::TileDirectory>> TiledVideoCompactor::findRunsToMerge(const TiledVideoManager &tiledVideoManager) const {
+    std::vector<TileDirectory> directories;
+    for (auto id : tiledVideoManager.tileLayoutIds()) {
+        auto path = tiledVideoManager.directoryForId(id);
+        auto firstAndLastFrame = TileFiles::firstAndLastFramesFromPath(path);
+        directories.push_back({id, path, firstAndLastFrame.first, firstAndLastFrame.second, tiledVideoManager.tileLayoutForId(id)});
+    }
+
+    // A directory is visible for a frame when no newer directory also contains the frame.
+    // Only merge directories that are visible for every frame they contain.
+    std::vector<TileDirectory> visibleDirectories;
+    for (const auto &directory : directories) {
+        bool isShadowed = std::any_of(directories.begin(), directories.end(), [&](const TileDirectory &other) {
+            return other.id > directory.id && other.firstFrame <= directory.lastFrame && other.lastFrame >= directory.firstFrame;
+        });
+        auto isOriginal = TileFiles::tileVersionFromPath(directory.path) == TileFiles::OriginalTileVersion;
+        if (!isShadowed && !isOriginal && directory.layout->numberOfTiles())
+            visibleDirectories.push_back(directory);
+    }
+    std::sort(visibleDirectories.begin(), visibleDirectories.end(), [](const TileDirectory &a, const TileDirectory &b) {
+        return a.firstFrame < b.firstFrame;
+    });
+
+    std::vector<std::vector<TileDirectory>> runs;
+    std::vector<TileDirectory> currentRun;
+    for (const auto &directory : visibleDirectories) {
+        if (!currentRun.empty()
+                && (directory.firstFrame != currentRun.back().lastFrame + 1 || *directory.layout != *currentRun.back().layout)) {
+            if (currentRun.size() > 1)
+                runs.push_back(std::move(currentRun));
+            currentRun.clear();
+        }
+        currentRun.push_back(directory);
+    }
+    if (currentRun.size() > 1)
+        runs.push_back(std::move(currentRun));
+
+    return runs;
+}
+
+void TiledVideoCompactor::mergeRun(const std::vector<TileDirectory> &run, std::shared_ptr<FileLock> writersLock) {
+    auto entry = std::make_shared<TiledEntry>(name_, entryPath_);
+    auto &layout = *run.front().layout;
+
+    {
+        // The new directory gets a newer version than every directory in the run, so it shadows them once it is committed.
+        auto frameRate = video::GetConfiguration(TileFiles::tileFilename(run.front().path, 0))->frameRate;
+        TileCrackingTransaction transaction(entry, layout, frameRate, run.front().firstFrame, run.back().lastFrame, writersLock);
+        for (auto tile = 0u; tile < layout.numberOfTiles(); ++tile) {
+            auto &output = transaction.write(tile);
+
+            // Every directory starts with a keyframe, and the samples are extracted with in-band parameter sets,
+            // so the concatenated streams decode as a single stream.
+            for (const auto &directory : run) {
+                MP4Reader reader(TileFiles::tileFilename(directory.path, tile));
+                auto data = reader.dataForSamples(1, reader.numberOfSamples());
+                output.write(data->data(), data->size());
+            }
+        }
+        transaction.commit();
+    }
+
+    TileManifest manifest(entry->path());
+    for (const auto &directory : run)
+        manifest.recordRemoval(directory.id);
+}
+
+} // namespace tasm
@@ -0,0 +1,121 @@
+#include "TiledVideoGarbageCollector.h"
+
+#include "FileLock.h"
+#include "Files.h"
+#include "LatestIntervalIndex.h"
+#include "TileAccessStatistics.h"
+#include "TileManifest.h"
+#include "TileReaderLease.h"
+#include <iostream>
+#include <unordered_set>
+
+namespace tasm {
+
+GarbageCollectionResult TiledVideoGarbageCollector::collect() {
+    auto numberOfDirectoriesRetired = retireShadowedDirectories();
+    auto result = deleteRemovedDirectories();
+    result.numberOfDirectoriesRetired = numberOfDirectoriesRetired;
+    return result;
+}
+
+unsigned int TiledVideoGarbageCollector::retireShadowedDirectories() {
+    TileManifest manifest(entryPath_);
+    auto directories = manifest.loadOrRebuild();
+
+    std::vector<IntervalEntry<unsigned int>> directoryIntervals;
+    directoryIntervals.reserve(directories.size());
+    for (const auto &directory : directories)
+        directoryIntervals.emplace_back(directory.firstFrame, directory.lastFrame, directory.tileVersion);
+
+    // A directory is still read if it is the newest one for at least one frame.
+    LatestIntervalIndex<unsigned int> latestDirectories(directoryIntervals);
+    std::unordered_set<unsigned int> visibleVersions;
+    for (const auto &segment : latestDirectories.segments())
+        visibleVersions.insert(segment.id);
+
+    unsigned int numberOfDirectoriesRetired = 0;
+    for (const auto &directory : directories) {
+        if (visibleVersions.count(directory.tileVersion) || directory.tileVersion == TileFiles::OriginalTileVersion)
+            continue;
+
+        manifest.recordRemoval(directory.tileVersion);
+        ++numberOfDirectoriesRetired;
+    }
+    return numberOfDirectoriesRetired;
+}
+
+GarbageCollectionResult TiledVideoGarbageCollector::deleteRemovedDirectories() {
+    GarbageCollectionResult result;
+    auto lease = TileReaderLease::tryAcquireExclusive(entryPath_);
+    auto directoriesToDelete = removedDirectories();
+    if (!lease) {
+        result.numberOfDirectoriesPending = directoriesToDelete.size();
+        return result;
+    }
+
+    std::unordered_set<unsigned int> deletedVersions;
+    for (const auto &directory : directoriesToDelete) {
+        for (auto &file : std::experimental::filesystem::recursive_directory_iterator(directory)) {
+            if (std::experimental::filesystem::is_regular_file(file.status()))
+                result.numberOfBytesReclaimed += std::experimental::filesystem::file_size(file.path());
+        }
+        std::experimental::filesystem::remove_all(directory);
+        deletedVersions.insert(TileFiles::tileVersionFromPath(directory));
+        ++result.numberOfDirectoriesDeleted;
+    }
+
+    // No tile of a deleted version will be read again.
+    TileAccessStatistics::removeVersions(entryPath_, deletedVersions);
+
+    if (result.numberOfDirectoriesDeleted)
+        std::cout << "Deleted " << result.numberOfDirectoriesDeleted << " tile directories of " << name_
+                  << ", reclaiming " << result.numberOfBytesReclaimed << " bytes" << std::endl;
+    return result;
+}
+
+std::vector<std::experimental::filesystem::path> TiledVideoGarbageCollector::removedDirectories() const {
+    // Transactions write a directory's metadata and record its commit under the manifest's lock, so while it is held
+    // a directory with metadata that the manifest doesn't list has been removed rather than not committed yet.
+    TileManifest manifest(entryPath_);
+    auto lock = manifest.lock(FileLock::Mode::Shared);
+    auto committedDirectories = manifest.load(*lock);
+    if (!committedDirectories)
+        return {};
+
+    std::unordered_set<unsigned int> committedVersions;
+    for (const auto &directory : *committedDirectories)
+        committedVersions.insert(directory.tileVersion);
+
+    std::vector<std::experimental::filesystem::path> directories;
+    for (auto &dir : std::experimental::filesystem::directory_iterator(entryPath_)) {
+        if (!std::experimental::filesystem::is_directory(dir.status()))
+            continue;
+
+        if (committedVersions.count(TileFiles::tileVersionFromPath(dir.path())))
+            continue;
+
+        if (std::experimental::filesystem::exists(TileFiles::tileMetadataFilename(dir.path()))
+                || isAbandoned(dir.path()))
+            directories.push_back(dir.path());
+    }
+    return directories;
+}
+
+bool TiledVideoGarbageCollector::isAbandoned(const std::experimental::filesystem::path &directory) const {
+    // The transaction writing the directory holds its lock until it commits or aborts.
+    auto lockPath = TileFiles::transactionLockFilename(directory);
+    if (std::experimental::filesystem::exists(lockPath)) {
+        try {
+            return FileLock::tryLock(lockPath, FileLock::Mode::Exclusive) != nullptr;
+        } catch (const std::exception &) {
+            // The directory was renamed or deleted while it was being checked.
+            return false;
+        }
+    }
+
+    // The transaction may not have locked its directory yet. It holds the writers lock from before it reserved its
+    // version, so if no transaction holds that, the directory's transaction is gone.
+    return FileLock::tryLock(TileFiles::tileWritersLockFilename(entryPath_), FileLock::Mode::Exclusive) != nullptr;
+}
+
+} // namespace tasm
@@ -0,0 +1,118 @@
+#include "TiledVideoPacker.h"
+
+#include "Files.h"
+#include "MP4Reader.h"
+#include "TileManifest.h"
+#include "TilePack.h"
+#include "TileReaderLease.h"
+#include "VideoConfiguration.h"
+#include <iostream>
+
+namespace tasm {
+
+unsigned int TiledVideoPacker::pack() {
+    unsigned int numberOfDirectoriesPacked = 0;
+    {
+        // Packing reads each directory's tiles, so they must not be deleted meanwhile.
+        TileReaderLease lease(entryPath_);
+        for (const auto &directory : TileManifest(entryPath_).loadOrRebuild()) {
+            if (directory.tileVersion == TileFiles::OriginalTileVersion || !directory.layout.numberOfTiles())
+                continue;
+
+            auto path = TileFiles::directoryForTilesInFrames(entryPath_, directory.firstFrame, directory.lastFrame, directory.tileVersion);
+            if (std::experimental::filesystem::exists(TileFiles::tilePackFilename(path)))
+                continue;
+
+            packDirectory(path, directory.layout.numberOfTiles());
+            ++numberOfDirectoriesPacked;
+        }
+    }
+
+    if (numberOfDirectoriesPacked)
+        std::cout << "Packed " << numberOfDirectoriesPacked << " tile directories of " << name_ << std::endl;
+
+    removeFilesOfPackedDirectories(false);
+    return numberOfDirectoriesPacked;
+}
+
+void TiledVideoPacker::packDirectory(const std::experimental::filesystem::path &directory, unsigned int numberOfTiles) {
+    // Queries read each tile's configuration from the pack once the mp4s are gone.
+    std::vector<Configuration> configurations;
+    for (auto tile = 0u; tile < numberOfTiles; ++tile)
+        configurations.push_back(*video::GetConfiguration(TileFiles::tileFilename(directory, tile)));
+
+    TilePackWriter writer(TileFiles::tilePackFilename(directory), configurations);
+    for (auto tile = 0u; tile < numberOfTiles; ++tile) {
+        MP4Reader reader(TileFiles::tileFilename(directory, tile));
+        auto keyframe = reader.keyframeNumbers().begin();
+        for (auto frame = 0u; frame < reader.numberOfSamples(); ++frame) {
+            bool isKeyframe = reader.allFramesAreKeyframes();
+            if (keyframe != reader.keyframeNumbers().end() && *keyframe == static_cast<int>(frame)) {
+                isKeyframe = true;
+                ++keyframe;
+            }
+
+            auto sampleNumber = MP4Reader::frameNumberToSampleNumber(frame);
+            writer.writeSample(tile, *reader.dataForSamples(sampleNumber, sampleNumber), isKeyframe);
+        }
+    }
+    writer.commit();
+}
+
+unsigned int TiledVideoPacker::unpack() {
+    unsigned int numberOfDirectoriesUnpacked = 0;
+    {
+        TileReaderLease lease(entryPath_);
+        for (const auto &directory : TileManifest(entryPath_).loadOrRebuild()) {
+            auto path = TileFiles::directoryForTilesInFrames(entryPath_, directory.firstFrame, directory.lastFrame, directory.tileVersion);
+            auto tilePackFilename = TileFiles::tilePackFilename(path);
+            if (!std::experimental::filesystem::exists(tilePackFilename))
+                continue;
+
+            TilePack tilePack(tilePackFilename);
+            for (auto tile = 0u; tile < tilePack.numberOfTiles(); ++tile) {
+                auto tileFilename = TileFiles::tileFilename(path, tile);
+                if (std::experimental::filesystem::exists(tileFilename))
+                    continue;
+
+                // Readers use the mp4 as soon as it exists, so it is only moved into place once it is complete.
+                auto exportedFilename = std::experimental::filesystem::path(tileFilename).concat(".tmp");
+                tilePack.exportTile(tile, exportedFilename);
+                std::experimental::filesystem::rename(exportedFilename, tileFilename);
+            }
+            ++numberOfDirectoriesUnpacked;
+        }
+    }
+
+    removeFilesOfPackedDirectories(true);
+    return numberOfDirectoriesUnpacked;
+}
+
+void TiledVideoPacker::removeFilesOfPackedDirectories(bool shouldRemovePacks) {
+    // Readers that already opened a tile's mp4 or pack may reopen it by name, so neither is removed while a reader holds a lease.
+    // Whatever is left is removed by the next pack or unpack.
+    auto lease = TileReaderLease::tryAcquireExclusive(entryPath_);
+    if (!lease)
+        return;
+
+    for (auto &dir : std::experimental::filesystem::directory_iterator(entryPath_)) {
+        auto tilePackFilename = TileFiles::tilePackFilename(dir.path());
+        if (!std::experimental::filesystem::is_directory(dir.status()) || !std::experimental::filesystem::exists(tilePackFilename))
+            continue;
+
+        if (shouldRemovePacks) {
+            std::experimental::filesystem::remove(tilePackFilename);
+            continue;
+        }
+
+        std::vector<std::experimental::filesystem::path> tileFilenames;
+        for (auto &file : std::experimental::filesystem::directory_iterator(dir.path())) {
+            if (file.path().extension() == TileFiles::muxedFilenameExtension())
+                tileFilenames.push_back(file.path());
+        }
+        for (const auto &tileFilename : tileFilenames)
+            std::experimental::filesystem::remove(tileFilename);
+    }
+}
+
+} // namespace tasm
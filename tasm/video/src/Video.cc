@@ -1,14 +1,36 @@
 #include "Video.h"
 
+#include "FileLock.h"
 #include "Files.h"
 
 namespace tasm {
 
-void TiledEntry::incrementTileVersion() {
-    std::ofstream output(TileFiles::tileVersionFilename(path_));
+unsigned int TiledEntry::reserveTileVersion() {
+    FileLock lock(TileFiles::tileVersionLockFilename(path_), FileLock::Mode::Exclusive);
 
-    ++version_;
-    auto newVersionAsString = std::to_string( version_);
-    std::copy(newVersionAsString.begin(), newVersionAsString.end(), std::ostreambuf_iterator<char>(output));
+    // Another entry for the same video may have reserved versions since this one loaded.
+    auto reservedVersion = loadVersion();
+    version_ = reservedVersion + 1;
+
+    // Replace the file rather than truncating it so that entries loading meanwhile never read an empty version.
+    auto versionPath = TileFiles::tileVersionFilename(path_);
+    auto temporaryPath = versionPath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::out | std::ios::trunc);
+        output << version_;
+        if (!output)
+            throw std::runtime_error("Failed to write tile version to " + temporaryPath.string());
+    }
+    std::experimental::filesystem::rename(temporaryPath, versionPath);
+    return reservedVersion;
+}
+
+void TiledEntry::setGOPLength(unsigned int gopLength) {
+    std::ofstream output(TileFiles::gopLengthFilename(path_));
+
+    gopLength_ = gopLength;
+    auto gopLengthAsString = std::to_string(gopLength_);
+    std::copy(gopLengthAsString.begin(), gopLengthAsString.end(), std::ostreambuf_iterator<char>(output));
 }
 } // namespace tasm
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "VideoConfiguration.h"
 
+#include "Files.h"
+#include "TilePack.h"
 #include <cassert>
 #include <iostream>
 #include <stdexcept>
@@ -21,6 +23,13 @@ Codec CodecFromAVCodec(AVCodecID codecId) {
 }
 
 std::unique_ptr<Configuration> GetConfiguration(const std::experimental::filesystem::path &path) {
+    // Packed tiles no longer have an mp4, so their configuration was recorded in the pack.
+    if (!std::experimental::filesystem::exists(path)) {
+        auto tilePackFilename = TileFiles::tilePackFilename(path.parent_path());
+        if (std::experimental::filesystem::exists(tilePackFilename))
+            return std::make_unique<Configuration>(TilePack::open(tilePackFilename)->configuration(TileFiles::tileNumberFromPath(path)));
+    }
+
     int result;
     char error[AV_ERROR_MAX_STRING_SIZE];
     auto context = avformat_alloc_context();
@@ -65,4 +74,43 @@ std::unique_ptr<Configuration> GetConfiguration(const std::experimental::filesys
     return configuration;
 }
 
+unsigned int GetNumberOfFrames(const std::experimental::filesystem::path &path) {
+    int result;
+    char error[AV_ERROR_MAX_STRING_SIZE];
+    AVFormatContext *context = nullptr;
+    if ((result = avformat_open_input(&context, path.c_str(), nullptr, nullptr)) < 0)
+        throw std::runtime_error(av_make_error_string(error, AV_ERROR_MAX_STRING_SIZE, result));
+
+    unsigned int numberOfFrames = 0;
+    if ((result = avformat_find_stream_info(context, nullptr)) < 0) {
+        avformat_close_input(&context);
+        throw std::runtime_error(av_make_error_string(error, AV_ERROR_MAX_STRING_SIZE, result));
+    }
+
+    if (context->nb_streams != 1) {
+        auto numberOfStreams = context->nb_streams;
+        avformat_close_input(&context);
+        throw std::runtime_error("Expected one stream in " + path.string() + " but found " + std::to_string(numberOfStreams));
+    }
+
+    if (context->streams[0]->nb_frames > 0) {
+        numberOfFrames = static_cast<unsigned int>(context->streams[0]->nb_frames);
+    } else {
+        // Elementary streams don't record their length, so demux them. Nothing is decoded.
+        AVPacket *packet = av_packet_alloc();
+        if (!packet) {
+            avformat_close_input(&context);
+            throw std::runtime_error("Failed to allocate a packet to count the frames of " + path.string());
+        }
+        while (av_read_frame(context, packet) >= 0) {
+            ++numberOfFrames;
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+    }
+
+    avformat_close_input(&context);
+    return numberOfFrames;
+}
+
 } // tasm::video
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "VideoManager.h"
 
+#include "CostModelCalibration.h"
 #include "ImageUtilities.h"
+#include "LayoutCache.h"
+#include "MP4Reader.h"
 #include "MergeTiles.h"
 #include "TileLocationProvider.h"
 #include "TiledVideoManager.h"
@@ -10,8 +13,13 @@
 #include "SemanticIndex.h"
 #include "SemanticSelection.h"
 #include "SmartTileConfigurationProvider.h"
+#include "StabilizedTileConfigurationProvider.h"
 #include "TemporalSelection.h"
+#include "TileLayoutPlanner.h"
 #include "TileOperators.h"
+#include "TileReaderLease.h"
+#include "TiledVideoCompactor.h"
+#include "TiledVideoPacker.h"
 #include "TransformToImage.h"
 #include "Video.h"
 #include "VideoConfiguration.h"
@@ -20,6 +28,19 @@
 
 namespace tasm {
 
+VideoManager::~VideoManager() {
+    // Stop re-tiling before the rest of the manager goes away.
+    stopBackgroundRetiling();
+
+    for (auto &videoAndRegretAccumulator : videoToRegretAccumulator_) {
+        try {
+            videoAndRegretAccumulator.second->saveIfChanged(RegretAccumulator::pathForEntry(files::PathForVideo(videoAndRegretAccumulator.first)));
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to save regret state for " << videoAndRegretAccumulator.first << ": " << e.what() << std::endl;
+        }
+    }
+}
+
 void VideoManager::createCatalogIfNecessary() {
     if (!std::experimental::filesystem::exists(CatalogConfiguration::CatalogPath()))
         std::experimental::filesystem::create_directory(CatalogConfiguration::CatalogPath());
@@ -44,16 +65,18 @@ void VideoManager::storeWithNonUniformLayout(const std::experimental::filesystem
                                                 const std::string &metadataIdentifier,
                                                 std::shared_ptr<MetadataSelection> metadataSelection,
                                                 std::shared_ptr<SemanticIndex> semanticIndex, bool force) {
+    invalidateChangedMetadata();
     std::shared_ptr<Video> video(new Video(path));
     auto semanticDataManager = std::make_shared<SemanticDataManager>(semanticIndex, metadataIdentifier, metadataSelection, std::shared_ptr<TemporalSelection>());
     std::shared_ptr<TileLayoutProvider> layoutProvider;
 
-    auto layoutDuration = video->configuration().frameRate;
+    auto layoutDuration = gopLengthForVideo(*video);
     auto width = video->configuration().displayWidth;
     auto height = video->configuration().displayHeight;
 
+    auto tileSizeEstimator = costModel_->usesByteCosts() ? std::make_shared<TileSizeEstimator>(video->path(), width, height) : nullptr;
     if (force) {
-        layoutProvider = std::make_shared<FineGrainedTileConfigurationProvider>(
+        layoutProvider = CachedTileConfigurationProvider::fineGrainedLayoutProvider(
                 layoutDuration,
                 semanticDataManager,
                 width,
@@ -63,30 +86,218 @@ void VideoManager::storeWithNonUniformLayout(const std::experimental::filesystem
                 layoutDuration,
                 semanticDataManager,
                 width,
-                height);
+                height,
+                costModel_,
+                tileSizeEstimator);
     }
-    storeTiledVideo(video, layoutProvider, storedName);
+
+    // A forced store asked for exactly the fine-grained layouts.
+    if (!force)
+        layoutProvider = stabilizeLayouts(video, layoutProvider, std::make_shared<Workload>(semanticDataManager), tileSizeEstimator);
+    storeTiledVideo(video, planLayouts(video, layoutProvider), storedName);
+}
+
+void VideoManager::storeWithWorkloadLayout(const std::experimental::filesystem::path &path,
+                                            const std::string &storedName,
+                                            const std::string &metadataIdentifier,
+                                            const std::vector<std::shared_ptr<MetadataSelection>> &metadataSelections,
+                                            const std::vector<unsigned int> &queryCounts,
+                                            std::shared_ptr<SemanticIndex> semanticIndex) {
+    invalidateChangedMetadata();
+    std::shared_ptr<Video> video(new Video(path));
+    std::vector<std::shared_ptr<SemanticDataManager>> semanticDataManagers(metadataSelections.size());
+    std::transform(metadataSelections.begin(), metadataSelections.end(), semanticDataManagers.begin(), [&](auto metadataSelection) {
+        return std::make_shared<SemanticDataManager>(semanticIndex, metadataIdentifier, metadataSelection);
+    });
+    auto workload = std::make_shared<Workload>(semanticDataManagers, queryCounts);
+
+    auto layoutDuration = gopLengthForVideo(*video);
+    auto width = video->configuration().displayWidth;
+    auto height = video->configuration().displayHeight;
+    auto tileSizeEstimator = costModel_->usesByteCosts() ? std::make_shared<TileSizeEstimator>(video->path(), width, height) : nullptr;
+
+    auto layoutProvider = std::make_shared<SmartTileConfigurationProviderMultipleSelection>(
+            layoutDuration,
+            semanticIndex,
+            metadataIdentifier,
+            workload,
+            width,
+            height,
+            costModel_,
+            tileSizeEstimator);
+    storeTiledVideo(video, planLayouts(video, stabilizeLayouts(video, layoutProvider, workload, tileSizeEstimator)), storedName);
+}
+
+std::shared_ptr<TileLayoutProvider> VideoManager::stabilizeLayouts(std::shared_ptr<Video> video,
+                                                                   std::shared_ptr<TileLayoutProvider> layoutProvider,
+                                                                   std::shared_ptr<Workload> workload,
+                                                                   std::shared_ptr<TileSizeEstimator> tileSizeEstimator) {
+    if (!layoutStabilityTolerance_)
+        return layoutProvider;
+
+    // Stabilization has to go through the GOPs in order, but the layouts it starts from can be computed in parallel.
+    // It is cheap once they are, so it runs on one thread and the result is not planned again by planLayouts.
+    auto gopLength = gopLengthForVideo(*video);
+    auto numberOfFrames = video->numberOfFrames();
+    auto stabilizedLayoutProvider = std::make_shared<StabilizedTileConfigurationProvider>(
+            TileLayoutPlanner(gopLength).planForFrames(layoutProvider, numberOfFrames),
+            workload,
+            gopLength,
+            *layoutStabilityTolerance_,
+            costModel_,
+            tileSizeEstimator);
+    return TileLayoutPlanner(gopLength, 1).planForFrames(stabilizedLayoutProvider, numberOfFrames);
+}
+
+std::shared_ptr<TileLayoutProvider> VideoManager::planLayouts(std::shared_ptr<Video> video, std::shared_ptr<TileLayoutProvider> layoutProvider) {
+    // Compute every GOP's layout before encoding so that TileOperator doesn't wait on the layout provider.
+    // Frames beyond the planned ones still get a layout, just not ahead of time.
+    if (std::dynamic_pointer_cast<PrecomputedTileConfigurationProvider>(layoutProvider))
+        return layoutProvider;
+    return TileLayoutPlanner(gopLengthForVideo(*video)).planForFrames(layoutProvider, video->numberOfFrames());
 }
 
 void VideoManager::storeTiledVideo(std::shared_ptr<Video> video, std::shared_ptr<TileLayoutProvider> tileLayoutProvider, const std::string &savedName) {
+    auto gopLength = gopLengthForVideo(*video);
     std::shared_ptr<ScanFileDecodeReader> scan(new ScanFileDecodeReader(video));
     std::shared_ptr<GPUDecodeFromCPU> decode(new GPUDecodeFromCPU(scan, video->configuration(), gpuContext_, lock_));
 
-    TileOperator tile(video, decode, tileLayoutProvider, savedName, video->configuration().frameRate, gpuContext_, lock_);
+    TileOperator tile(video, decode, tileLayoutProvider, savedName, gopLength, gpuContext_, lock_);
     while (!tile.isComplete()) {
         tile.next();
     }
+    TiledEntry(savedName).setGOPLength(gopLength);
+    invalidateTiledVideoManager(savedName);
+}
+
+unsigned int VideoManager::gopLengthForVideo(const Video &video) const {
+    return gopLength_ ? gopLength_ : video.configuration().frameRate;
+}
+
+unsigned int VideoManager::gopLengthForEntry(const TiledEntry &entry, const Configuration &tileConfiguration) {
+    // Videos stored before GOP lengths were recorded always used one-second GOPs.
+    return entry.gopLength() ? entry.gopLength() : tileConfiguration.frameRate;
+}
+
+unsigned int VideoManager::recommendGOPLength(const std::experimental::filesystem::path &path, const QueryMix &queryMix) const {
+    auto video = std::make_shared<Video>(path);
+    auto numberOfFrames = video->numberOfFrames();
+
+    // Split the size of the video between its keyframes and the frames between them.
+    double bytesPerInterframe = 0;
+    if (numberOfFrames) {
+        // Only mp4s index their keyframes. Otherwise assume the video has one keyframe per second.
+        unsigned int numberOfKeyframes;
+        if (path.extension() == ".mp4") {
+            MP4Reader reader(path);
+            numberOfKeyframes = reader.allFramesAreKeyframes() ? numberOfFrames : reader.keyframeNumbers().size();
+        } else {
+            auto frameRate = std::max(video->configuration().frameRate, 1u);
+            numberOfKeyframes = (numberOfFrames + frameRate - 1) / frameRate;
+        }
+        bytesPerInterframe = std::experimental::filesystem::file_size(path) / (numberOfFrames + numberOfKeyframes * (CostModel::DefaultKeyframeSizeRatio - 1));
+    }
+    return costModel_->recommendGOPLength(queryMix,
+            video->configuration().displayWidth,
+            video->configuration().displayHeight,
+            numberOfFrames,
+            bytesPerInterframe);
 }
 
 void VideoManager::retileVideoBasedOnRegret(const std::string &videoName) {
-    assert(videoToRegretAccumulator_.count(videoName));
+    invalidateChangedMetadata();
+    auto regretAccumulator = regretAccumulatorForVideo(videoName);
+    assert(regretAccumulator);
+
+    retileGOPs(videoName, regretAccumulator->getNewGOPLayouts());
+    regretAccumulator->save(RegretAccumulator::pathForEntry(files::PathForVideo(videoName)));
+}
+
+void VideoManager::metadataChanged(const std::string &metadataIdentifier) {
+    std::scoped_lock lock(changedMetadataMutex_);
+    changedMetadataIdentifiers_.insert(metadataIdentifier);
+    hasChangedMetadata_ = true;
+}
+
+void VideoManager::invalidateChangedMetadata() {
+    if (!hasChangedMetadata_)
+        return;
+
+    std::unordered_set<std::string> metadataIdentifiers;
+    {
+        std::scoped_lock lock(changedMetadataMutex_);
+        metadataIdentifiers.swap(changedMetadataIdentifiers_);
+        hasChangedMetadata_ = false;
+    }
+    for (const auto &metadataIdentifier : metadataIdentifiers)
+        invalidateMetadata(metadataIdentifier);
+}
+
+void VideoManager::invalidateMetadata(const std::string &metadataIdentifier) {
+    PersistentLayoutCache::invalidate(metadataIdentifier);
+
+    std::scoped_lock lock(regretMutex_);
+    for (const auto &videoAndAccumulator : videoToRegretAccumulator_) {
+        if (videoAndAccumulator.second->metadataIdentifier() == metadataIdentifier)
+            videoAndAccumulator.second->invalidateMetadata();
+    }
+}
+
+std::vector<std::pair<std::string, RetileCandidate>> VideoManager::gopsWorthRetiling() {
+    invalidateChangedMetadata();
+    std::vector<std::pair<std::string, std::shared_ptr<RegretAccumulator>>> regretAccumulators;
+    {
+        std::scoped_lock lock(regretMutex_);
+        regretAccumulators.assign(videoToRegretAccumulator_.begin(), videoToRegretAccumulator_.end());
+    }
+
+    std::vector<std::pair<std::string, RetileCandidate>> candidates;
+    for (const auto &videoAndAccumulator : regretAccumulators) {
+        for (const auto &candidate : videoAndAccumulator.second->gopsWorthRetiling())
+            candidates.emplace_back(videoAndAccumulator.first, candidate);
+    }
+    return candidates;
+}
+
+unsigned int VideoManager::retileGOPsBasedOnRegret(const std::string &videoName, const std::vector<unsigned int> &gops) {
+    invalidateChangedMetadata();
+    auto regretAccumulator = regretAccumulatorForVideo(videoName);
+    if (!regretAccumulator)
+        return 0;
+
+    std::vector<unsigned int> gopsToRetile;
+    auto gopToLayouts = std::make_unique<std::unordered_map<unsigned int, std::shared_ptr<TileLayoutProvider>>>();
+    for (auto gop : gops) {
+        if (auto layout = regretAccumulator->layoutToRetileGOP(gop)) {
+            gopToLayouts->emplace(gop, layout);
+            gopsToRetile.push_back(gop);
+        }
+    }
+    if (gopsToRetile.empty())
+        return 0;
+
+    // If re-tiling throws, the GOPs keep their regret so that they are re-tiled again later.
+    retileGOPs(videoName, std::move(gopToLayouts));
+    for (auto gop : gopsToRetile)
+        regretAccumulator->resetRegretForRetiledGOP(gop);
+    regretAccumulator->save(RegretAccumulator::pathForEntry(files::PathForVideo(videoName)));
+    return gopsToRetile.size();
+}
 
-    auto tiledEntry = std::make_shared<TiledEntry>(videoName);
-    auto tiledVideoManager = std::make_shared<TiledVideoManager>(tiledEntry);
+std::shared_ptr<RegretAccumulator> VideoManager::regretAccumulatorForVideo(const std::string &video) {
+    std::scoped_lock lock(regretMutex_);
+    auto regretAccumulator = videoToRegretAccumulator_.find(video);
+    return regretAccumulator != videoToRegretAccumulator_.end() ? regretAccumulator->second : nullptr;
+}
+
+void VideoManager::retileGOPs(const std::string &videoName,
+                              std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<TileLayoutProvider>>> gopToLayouts) {
+    TileReaderLease tileReaderLease(files::PathForVideo(videoName));
+    auto tiledVideoManager = tiledVideoManagerForVideo(videoName);
+    auto tiledEntry = tiledVideoManager->entry();
     auto video = std::make_shared<Video>(tiledVideoManager->locationOfTileForId(0, 0));
-    auto gopLength = video->configuration().frameRate;
+    auto gopLength = gopLengthForEntry(*tiledEntry, video->configuration());
 
-    auto gopToLayouts = videoToRegretAccumulator_.at(videoName)->getNewGOPLayouts();
     // Because we re-tile the entire GOP, we only need to specify the first frame for each GOP.
     auto frames = std::make_shared<std::vector<int>>();
     for (auto it = gopToLayouts->begin(); it != gopToLayouts->end(); ++it)
@@ -96,18 +307,62 @@ void VideoManager::retileVideoBasedOnRegret(const std::string &videoName) {
     // That should probably get more flexible, but for now sorting is easy.
     std::sort(frames->begin(), frames->end());
 
-    retileVideo(video, frames, std::make_shared<ConglomerationTileConfigurationProvider>(std::move(gopToLayouts), gopLength), videoName);
+    retileVideo(video, frames, std::make_shared<ConglomerationTileConfigurationProvider>(std::move(gopToLayouts), gopLength), videoName, gopLength);
+}
+
+unsigned int VideoManager::compactTiledVideo(const std::string &video) {
+    flushTileAccessStatistics(video);
+    auto numberOfDirectoriesRemoved = TiledVideoCompactor(video).compact();
+    invalidateTiledVideoManager(video);
+    return numberOfDirectoriesRemoved;
+}
+
+GarbageCollectionResult VideoManager::collectGarbage(const std::string &video) {
+    flushTileAccessStatistics(video);
+    auto result = TiledVideoGarbageCollector(video).collect();
+    invalidateTiledVideoManager(video);
+    return result;
+}
+
+unsigned int VideoManager::packTiledVideo(const std::string &video) {
+    // Packed tiles are read through the same filenames, so loaded tiled video managers stay valid.
+    return TiledVideoPacker(video).pack();
+}
+
+unsigned int VideoManager::unpackTiledVideo(const std::string &video) {
+    return TiledVideoPacker(video).unpack();
+}
+
+std::shared_ptr<TiledVideoManager> VideoManager::tiledVideoManagerForVideo(const std::string &video) {
+    std::scoped_lock lock(tiledVideoManagerMutex_);
+    auto &tiledVideoManager = videoToTiledVideoManager_[video];
+
+    // Other processes can also commit to the entry, so check its manifest rather than relying on invalidation alone.
+    if (!tiledVideoManager || !tiledVideoManager->isCurrent())
+        tiledVideoManager = std::make_shared<TiledVideoManager>(std::make_shared<TiledEntry>(video));
+    return tiledVideoManager;
 }
 
-void VideoManager::retileVideo(std::shared_ptr<Video> video, std::shared_ptr<std::vector<int>> framesToRead, std::shared_ptr<TileLayoutProvider> newLayoutProvider, const std::string &savedName) {
+void VideoManager::invalidateTiledVideoManager(const std::string &video) {
+    std::scoped_lock lock(tiledVideoManagerMutex_);
+    videoToTiledVideoManager_.erase(video);
+}
+
+void VideoManager::retileVideo(std::shared_ptr<Video> video, std::shared_ptr<std::vector<int>> framesToRead, std::shared_ptr<TileLayoutProvider> newLayoutProvider, const std::string &savedName, unsigned int gopLength) {
+    std::vector<unsigned int> gopsToRetile(framesToRead->size());
+    std::transform(framesToRead->begin(), framesToRead->end(), gopsToRetile.begin(), [&](int frame) { return frame / gopLength; });
+    gopsToRetile.erase(std::unique(gopsToRetile.begin(), gopsToRetile.end()), gopsToRetile.end());
+    auto plannedLayoutProvider = TileLayoutPlanner(gopLength).planForGOPs(newLayoutProvider, gopsToRetile);
+
     // Set up scan of original video using specified frames. Re-tile entire GOPs, even if not every frame is specified.
     auto scan = std::make_shared<ScanFramesFromFileDecodeReader>(video, framesToRead, true);
     auto decode = std::make_shared<GPUDecodeFromCPU>(scan, video->configuration(), gpuContext_, lock_);
 
-    TileOperator tile(video, decode, newLayoutProvider, savedName, video->configuration().frameRate, gpuContext_, lock_);
+    TileOperator tile(video, decode, plannedLayoutProvider, savedName, gopLength, gpuContext_, lock_);
     while (!tile.isComplete()) {
         tile.next();
     }
+    invalidateTiledVideoManager(savedName);
 }
 
 std::unique_ptr<ImageIterator> VideoManager::select(const std::string &video,
@@ -116,14 +371,17 @@ std::unique_ptr<ImageIterator> VideoManager::select(const std::string &video,
                                                     std::shared_ptr<TemporalSelection> temporalSelection,
                                                     std::shared_ptr<SemanticIndex> semanticIndex,
                                                     SelectStrategy selectStrategy) {
-    std::shared_ptr<TiledEntry> entry(new TiledEntry(video, metadataIdentifier));
-
+    invalidateChangedMetadata();
     // Set up scan of a tiled video.
-    std::shared_ptr<TiledVideoManager> tiledVideoManager(new TiledVideoManager(entry));
-    auto tileLocationProvider = std::make_shared<SingleTileLocationProvider>(tiledVideoManager);
+    // The lease is held until the query's iterator is destroyed, and must be taken before the directories are loaded.
+    auto tileReaderLease = std::make_shared<TileReaderLease>(files::PathForVideo(video));
+    auto tiledVideoManager = tiledVideoManagerForVideo(video);
+    auto entry = tiledVideoManager->entry();
+    auto tileLocationProvider = std::make_shared<SingleTileLocationProvider>(tiledVideoManager, tileReaderLease);
     auto semanticDataManager = std::make_shared<SemanticDataManager>(semanticIndex, metadataIdentifier, metadataSelection, temporalSelection, tiledVideoManager->totalWidth(), tiledVideoManager->totalHeight());
 
     std::shared_ptr<Operator<CPUEncodedFrameDataPtr>> scan;
+    std::shared_ptr<ScanTiledVideoOperator> scanTiles;
     std::shared_ptr<TileLayoutProvider> tileLayoutProvider = tileLocationProvider;
 
     // Set up default configuration info.
@@ -154,10 +412,14 @@ std::unique_ptr<ImageIterator> VideoManager::select(const std::string &video,
         maxWidth = configuration.maxWidth;
         maxHeight = configuration.maxHeight;
     } else {
-        scan = std::make_shared<ScanTiledVideoOperator>(entry, semanticDataManager, tileLocationProvider);
+        auto tileAccessStatistics = tileAccessStatisticsForEntry(*entry, gopLengthForEntry(*entry, configuration));
+        scanTiles = std::make_shared<ScanTiledVideoOperator>(entry, semanticDataManager, tileLocationProvider, false, costFeedback_, tileAccessStatistics);
+        scan = scanTiles;
     }
 
     std::shared_ptr<GPUDecodeFromCPU> decode(new GPUDecodeFromCPU(scan, configuration, gpuContext_, lock_, maxWidth, maxHeight));
+    if (scanTiles)
+        decode->setCompletionHandler([scanTiles](double decodeSeconds) { scanTiles->recordExecutionStatistics(decodeSeconds); });
     auto toRGB = std::make_shared<TransformToRGB>(decode);
 
     // Transform tiles to pixel blobs.
@@ -174,38 +436,101 @@ std::unique_ptr<ImageIterator> VideoManager::select(const std::string &video,
     std::shared_ptr<TransformToImage> transform(new TransformToImage(mergeOperator, maxWidth, maxHeight));
 
     // Accumulate regret for this query.
-    if (videoToRegretAccumulator_.count(video))
-        accumulateRegret(video, semanticDataManager, tileLocationProvider);
+    if (auto regretAccumulator = regretAccumulatorForVideo(video))
+        accumulateRegret(regretAccumulator, video, semanticDataManager, tileLocationProvider, tiledVideoManager);
+
+    return std::make_unique<ImageIterator>(transform, foregroundActivity_->begin());
+}
 
-    return std::make_unique<ImageIterator>(transform);
+std::shared_ptr<TileAccessStatistics> VideoManager::tileAccessStatisticsForEntry(const TiledEntry &entry, unsigned int gopLength) {
+    std::scoped_lock lock(tileAccessMutex_);
+    // A video that was stored again with a different GOP length starts new statistics. The old ones are flushed.
+    auto &statistics = videoToTileAccessStatistics_[entry.name()];
+    if (!statistics || statistics->gopLength() != gopLength)
+        statistics = std::make_shared<TileAccessStatistics>(entry.path(), gopLength);
+    return statistics;
 }
 
-void VideoManager::accumulateRegret(const std::string &video, std::shared_ptr<SemanticDataManager> selection, std::shared_ptr<TileLayoutProvider> currentLayout) {
-    auto regretAccumulator = videoToRegretAccumulator_.at(video);
+void VideoManager::flushTileAccessStatistics(const std::string &video) {
+    std::shared_ptr<TileAccessStatistics> statistics;
+    {
+        std::scoped_lock lock(tileAccessMutex_);
+        auto videoAndStatistics = videoToTileAccessStatistics_.find(video);
+        if (videoAndStatistics == videoToTileAccessStatistics_.end())
+            return;
+        statistics = videoAndStatistics->second;
+    }
+    statistics->flush();
+}
+
+TileAccessMap VideoManager::tileAccessStatistics(const std::string &video) {
+    {
+        std::scoped_lock lock(tileAccessMutex_);
+        auto statistics = videoToTileAccessStatistics_.find(video);
+        if (statistics != videoToTileAccessStatistics_.end())
+            return statistics->second->accesses();
+    }
+    return TileAccessStatistics::load(files::PathForVideo(video));
+}
 
+void VideoManager::accumulateRegret(std::shared_ptr<RegretAccumulator> regretAccumulator, const std::string &video, std::shared_ptr<SemanticDataManager> selection, std::shared_ptr<TileLayoutProvider> currentLayout, std::shared_ptr<const TiledVideoManager> tiledVideoManager) {
     // Create a workload.
     auto workload = std::make_shared<Workload>(selection);
 
     // Add regret for this query and get GOPs that have accumulated enough regret to be re-tiled.
-    regretAccumulator->addRegretForQuery(workload, currentLayout);
+    regretAccumulator->addRegretForQuery(workload, currentLayout,
+            costModel_->usesByteCosts() ? std::make_shared<TileSizeEstimator>(tiledVideoManager) : nullptr);
+    regretAccumulator->saveIfDue(RegretAccumulator::pathForEntry(files::PathForVideo(video)));
 }
 
 void VideoManager::activateRegretBasedRetilingForVideo(const std::string &video, const std::string &metadataIdentifier, std::shared_ptr<SemanticIndex> semanticIndex, double threshold) {
-    std::shared_ptr<TiledEntry> entry(new TiledEntry(video, metadataIdentifier));
-    std::shared_ptr<TiledVideoManager> tiledVideoManager(new TiledVideoManager(entry));
+    invalidateChangedMetadata();
+    TileReaderLease tileReaderLease(files::PathForVideo(video));
+    auto tiledVideoManager = tiledVideoManagerForVideo(video);
+    auto entry = tiledVideoManager->entry();
     Video originalVideo(tiledVideoManager->locationOfTileForId(0, 0));
 
-    videoToRegretAccumulator_[video] = std::make_shared<RegretAccumulator>(
+    auto regretAccumulator = std::make_shared<RegretAccumulator>(
             semanticIndex,
             metadataIdentifier,
             tiledVideoManager->totalWidth(),
             tiledVideoManager->totalHeight(),
-            originalVideo.configuration().frameRate,
-            threshold);
+            gopLengthForEntry(*entry, originalVideo.configuration()),
+            threshold,
+            costModel_);
+
+    // Resume from the regret accumulated by earlier processes.
+    if (regretAccumulator->load(RegretAccumulator::pathForEntry(entry->path())))
+        std::cout << "Loaded regret state for " << video << std::endl;
+
+    std::scoped_lock lock(regretMutex_);
+    videoToRegretAccumulator_[video] = regretAccumulator;
 }
 
 void VideoManager::deactivateRegretBasedRetilingForVideo(const std::string &video) {
+    auto regretAccumulator = regretAccumulatorForVideo(video);
+    if (!regretAccumulator)
+        return;
+
+    regretAccumulator->saveIfChanged(RegretAccumulator::pathForEntry(files::PathForVideo(video)));
+    std::scoped_lock lock(regretMutex_);
     videoToRegretAccumulator_.erase(video);
 }
 
+void VideoManager::startBackgroundRetiling(const RetilingBudget &budget) {
+    stopBackgroundRetiling();
+    retilingScheduler_ = std::make_unique<RetilingScheduler>(*this, foregroundActivity_, budget);
+}
+
+void VideoManager::stopBackgroundRetiling() {
+    retilingScheduler_.reset();
+}
+
+void VideoManager::calibrateCostModel(const std::vector<std::experimental::filesystem::path> &videos) {
+    CostModelCalibrator calibrator(*this, gpuContext_, lock_);
+    costModel_->setCoefficients(calibrator.calibrate(videos));
+    costModel_->save(CostModel::pathInCatalog());
+    costFeedback_->reset();
+}
+
 } // namespace tasm
\ No newline at end of file